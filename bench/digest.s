@@ -0,0 +1,21 @@
+; Digests a 400-byte string 100000 times with each of buf crc, xxh and sha
+; (40 MB per digest). Throughput of the whole instruction, interpreter
+; included, measured on an AVX2 machine with SSE4.2 and the SHA extensions:
+;
+;   digest   default      --simd scalar (portable C)
+;   crc      ~890 MB/s    ~330 MB/s
+;   xxh      ~1080 MB/s   ~1080 MB/s
+;   sha      ~560 MB/s    ~170 MB/s
+;
+; The kernels alone, on 64 KB buffers: crc 7.0 GB/s and 0.3 GB/s, xxh
+; 5.8 GB/s, sha 0.85 GB/s and 0.16 GB/s.
+_start:
+    char msg, "abcdefghijklmnopqrstuvwxyz0123456789abcdefghijklmnopqrstuvwxyz0123456789abcdefghijklmnopqrstuvwxyz0123456789abcdefghijklmnopqrstuvwxyz0123456789abcdefghijklmnopqrstuvwxyz0123456789abcdefghijklmnopqrstuvwxyz0123456789abcdefghijklmnopqrstuvwxyz0123456789abcdefghijklmnopqrstuvwxyz0123456789abcdefghijklmnopqrstuvwxyz0123456789abcdefghijklmnopqrstuvwxyz0123456789abcdefghijklmnopqrstuvwxyz0123456789abcd"
+    for mov idx, 1, 100000, exec:
+        buf crc, crc, msg
+        buf xxh, xxh, msg
+        buf sha, sha, msg
+    end
+    vga crc
+    vga xxh
+    vga sha
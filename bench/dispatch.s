@@ -0,0 +1,15 @@
+_start:
+    mov tot, 0
+    mov odd, 0
+    for mov idx, 1, 2000000, exec:
+        addr tot, tot + idx
+        mul sqr, idx * 3
+        mod rem, sqr % 7
+        cond rem == 0, exec:
+            subr tot, tot - 1
+        else
+            addr odd, odd + 1
+        end
+    end
+    vga tot
+    vga odd
@@ -0,0 +1,21 @@
+#!/bin/bash
+# Time each bench/*.s script under one or more interpreter builds.
+# Usage: bench/run.bash <interp> [interp...]
+
+RUNS=${RUNS:-5}
+BENCH_DIR="$(cd "$(dirname "$0")" && pwd)"
+
+for script in "$BENCH_DIR"/*.s; do
+    echo "$(basename "$script"):"
+    for interp in "$@"; do
+        best=""
+        for ((i = 0; i < RUNS; i++)); do
+            t0=$(date +%s%N)
+            "$interp" "$script" > /dev/null
+            t1=$(date +%s%N)
+            ms=$(( (t1 - t0) / 1000000 ))
+            if [ -z "$best" ] || [ "$ms" -lt "$best" ]; then best=$ms; fi
+        done
+        printf "  %-32s %6d ms (best of %d)\n" "$(basename "$interp")" "$best" "$RUNS"
+    done
+done
@@ -0,0 +1,111 @@
+#include "bytecode.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define ALIGN8(n) (((n) + 7) & ~7LL)
+
+static int writeSection(FILE *f, long long *offset, const void *data, size_t size) {
+    static const char padding[8] = {0};
+    long long aligned = ALIGN8(*offset);
+    if (aligned > *offset && fwrite(padding, 1, aligned - *offset, f) != (size_t)(aligned - *offset)) return -1;
+    if (size > 0 && fwrite(data, 1, size, f) != size) return -1;
+    *offset = aligned + size;
+    return 0;
+}
+
+int writeModule(const Program *prog, int start, const char *path) {
+    ModuleHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MODULE_MAGIC, sizeof(MODULE_MAGIC));
+    header.version = MODULE_VERSION;
+    header.instrSize = sizeof(Instr);
+    header.operandSize = sizeof(Operand);
+    header.start = start;
+    header.codeCount = prog->codeCount;
+    header.operandCount = prog->operandCount;
+    header.nameCount = prog->nameCount;
+    header.poolSize = prog->poolSize;
+    header.maxDepth = prog->maxDepth;
+
+    size_t codeSize = (size_t)prog->codeCount * sizeof(Instr);
+    size_t operandSize = (size_t)prog->operandCount * sizeof(Operand);
+    size_t nameSize = (size_t)prog->nameCount * sizeof(int);
+    header.codeOffset = ALIGN8((long long)sizeof(header));
+    header.operandOffset = ALIGN8(header.codeOffset + (long long)codeSize);
+    header.nameOffset = ALIGN8(header.operandOffset + (long long)operandSize);
+    header.poolOffset = ALIGN8(header.nameOffset + (long long)nameSize);
+
+    FILE *f = fopen(path, "wb");
+    if (!f) return -1;
+
+    long long offset = 0;
+    int failed = writeSection(f, &offset, &header, sizeof(header))
+              || writeSection(f, &offset, prog->code, codeSize)
+              || writeSection(f, &offset, prog->operands, operandSize)
+              || writeSection(f, &offset, prog->names, nameSize)
+              || writeSection(f, &offset, prog->pool, prog->poolSize);
+    if (fclose(f) != 0) failed = 1;
+    return failed ? -1 : 0;
+}
+
+// Check that a section lies inside the file
+static int sectionFits(long long offset, long long count, size_t size, long long fileSize) {
+    return offset >= (long long)sizeof(ModuleHeader) && (offset & 7) == 0 && count >= 0
+        && offset + count * (long long)size <= fileSize;
+}
+
+int loadModule(Program *prog, int *start, const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return 0;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(ModuleHeader)) {
+        close(fd);
+        return 0;
+    }
+
+    void *image = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (image == MAP_FAILED) return 0;
+
+    const ModuleHeader *header = image;
+    if (memcmp(header->magic, MODULE_MAGIC, sizeof(MODULE_MAGIC)) != 0) {
+        munmap(image, st.st_size);
+        return 0;
+    }
+
+    long long size = st.st_size;
+    if (header->version != MODULE_VERSION
+        || header->instrSize != sizeof(Instr)
+        || header->operandSize != sizeof(Operand)
+        || !sectionFits(header->codeOffset, header->codeCount, sizeof(Instr), size)
+        || !sectionFits(header->operandOffset, header->operandCount, sizeof(Operand), size)
+        || !sectionFits(header->nameOffset, header->nameCount, sizeof(int), size)
+        || !sectionFits(header->poolOffset, header->poolSize, 1, size)
+        || header->start < 0 || header->start > header->codeCount) {
+        fprintf(stderr, "Error: '%s' is not a module this interpreter can run (version %u)\n",
+                path, header->version);
+        munmap(image, st.st_size);
+        return -1;
+    }
+
+    // The mapping stays alive for the rest of the run
+    char *base = image;
+    initProgram(prog);
+    prog->code = (Instr *)(base + header->codeOffset);
+    prog->codeCount = header->codeCount;
+    prog->operands = (Operand *)(base + header->operandOffset);
+    prog->operandCount = header->operandCount;
+    prog->names = (int *)(base + header->nameOffset);
+    prog->nameCount = header->nameCount;
+    prog->pool = base + header->poolOffset;
+    prog->poolSize = header->poolSize;
+    prog->maxDepth = header->maxDepth;
+    *start = header->start;
+    return 1;
+}
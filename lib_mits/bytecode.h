@@ -0,0 +1,44 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include "decode.h"
+
+// Binary module written by mits-compiler and mapped by mits-interp. The
+// file is a header followed by the program arrays exactly as they sit in
+// memory, each section starting on an 8-byte boundary:
+//
+//   ModuleHeader | Instr[codeCount] | Operand[operandCount]
+//                | int names[nameCount] | char pool[poolSize]
+//
+// Block links (target/alt/depth) are stored already resolved inside each
+// Instr, so a loaded module runs without decoding or resolveBlocks.
+#define MODULE_MAGIC "MITSMOD"
+#define MODULE_VERSION 11
+
+typedef struct {
+    char magic[8];              // MODULE_MAGIC, NUL-padded
+    unsigned int version;       // MODULE_VERSION
+    unsigned int instrSize;     // sizeof(Instr) of the writer
+    unsigned int operandSize;   // sizeof(Operand) of the writer
+    int start;                  // first instruction after _start:
+    int codeCount;
+    int operandCount;
+    int nameCount;
+    int poolSize;
+    int maxDepth;
+    int reserved;
+    long long codeOffset;       // byte offsets of each section
+    long long operandOffset;
+    long long nameOffset;
+    long long poolOffset;
+} ModuleHeader;
+
+// Write a decoded, block-resolved program as a module; returns 0 on success
+int writeModule(const Program *prog, int start, const char *path);
+
+// Map a module and point prog at its sections. The arrays are borrowed
+// from the mapping (capacity 0) and copied only if the program grows.
+// Returns 1 when loaded, 0 when path is not a module, -1 on a bad module.
+int loadModule(Program *prog, int *start, const char *path);
+
+#endif // BYTECODE_H
@@ -6,20 +6,27 @@
 #include "rom.h"
 #include "register.h"
 #include "compiler.h"
+#include "decode.h"
+#include "bytecode.h"
+#include "translate.h"
+#include "optimize.h"
+#include "fuse.h"
+#include "pgo.h"
+#include "verify.h"
 
 // Global state and imported files
 State state;
 char importedFiles[MAX_IMPORTED_FILES][256];
 int importedFileCount = 0;
 
-void compile(const char *inputFile, const char *outputFile) {
+int compile(const char *inputFile, const CompileOutputs *outputs, const CompileOptions *options) {
     // Parse the ROM file first
     parseROMFile("main.rom");
 
     FILE *in = fopen(inputFile, "r");
     if (!in) {
         fprintf(stderr, "Error: Cannot open input file '%s'\n", inputFile);
-        return;
+        return 1;
     }
 
     char lines[MAX_LINES][MAX_LINE_LENGTH];
@@ -32,17 +39,17 @@ void compile(const char *inputFile, const char *outputFile) {
     fclose(in);
 
     // Check for _start label
-    int hasStart = 0;
+    int startIdx = -1;
     for (int i = 0; i < lineCount; i++) {
         if (strcmp(lines[i], "_start:") == 0) {
-            hasStart = 1;
+            startIdx = i + 1;
             break;
         }
     }
 
-    if (!hasStart) {
+    if (startIdx == -1) {
         fprintf(stderr, "Error: Missing _start: label\n");
-        return;
+        return 1;
     }
 
     // First pass: collect functions
@@ -67,11 +74,83 @@ void compile(const char *inputFile, const char *outputFile) {
         }
     }
 
-    printf("Compilation successful: Assembly parsed with %d ROM entries and %d functions\n", state.romCount, state.funcCount);
+    // Second pass: decode every line and resolve blocks into a module
+    Program program;
+    initProgram(&program);
+    for (int i = 0; i < lineCount; i++) {
+        decodeLine(&program, lines[i], i + 1);
+    }
+    resolveBlocks(&program, 0);
+    int errors = verifyProgram(&program, 0, inputFile);
+    if (errors != 0) {
+        if (errors > 0) fprintf(stderr, "Error: %d error%s in '%s', nothing was built\n", errors, errors == 1 ? "" : "s", inputFile);
+        freeProgram(&program);
+        return 1;
+    }
+    if (options->optimize) optimizeProgram(&program, startIdx);
+    if (options->useProfile && applyProfile(&program, startIdx, options->useProfile) < 0) {
+        fprintf(stderr, "Error: Cannot read profile file '%s'\n", options->useProfile);
+        freeProgram(&program);
+        return 1;
+    }
+    if (options->opProfile && fuseProgram(&program, options->opProfile) < 0) {
+        fprintf(stderr, "Error: Cannot read profile file '%s'\n", options->opProfile);
+        freeProgram(&program);
+        return 1;
+    }
+
+    int failed = 0;
+    if (outputs->module) {
+        if (writeModule(&program, startIdx, outputs->module) != 0) {
+            fprintf(stderr, "Error: Cannot write output file '%s'\n", outputs->module);
+            failed = 1;
+        } else {
+            printf("Compilation successful: %d instructions written to %s with %d ROM entries and %d functions\n",
+                   program.codeCount, outputs->module, state.romCount, state.funcCount);
+        }
+    }
+    if (!failed && outputs->csource) {
+        failed = translateProgram(&program, startIdx, inputFile, outputs->csource);
+        if (!failed) printf("Translation successful: C source written to %s\n", outputs->csource);
+    }
+    if (!failed && outputs->executable) {
+        failed = buildExecutable(&program, startIdx, inputFile, outputs->executable);
+    }
+    freeProgram(&program);
+    return failed;
+}
+
+// Translate to a temporary C file next to the executable and hand it to the C compiler
+int buildExecutable(const Program *program, int startIdx, const char *inputFile, const char *outputFile) {
+    char source[1024];
+    snprintf(source, sizeof(source), "%s.mits.c", outputFile);
+    if (translateProgram(program, startIdx, inputFile, source) != 0) return 1;
+
+    const char *cc = getenv("CC");
+    char command[4096];
+    snprintf(command, sizeof(command), "%s -O2 -o '%s' '%s' -lm", cc && *cc ? cc : "gcc", outputFile, source);
+    int status = system(command);
+    remove(source);
+    if (status != 0) {
+        fprintf(stderr, "Error: C compiler failed to build '%s'\n", outputFile);
+        return 1;
+    }
+
+    printf("Build successful: native executable written to %s\n", outputFile);
+    return 0;
+}
+
+// Options of build that are followed by a value
+int takesValue(const char *option) {
+    static const char *const options[] = {"-f", "-rom", "-c", "-exe", "-profile", "--use-profile", "-use-profile"};
+    for (size_t i = 0; i < sizeof(options) / sizeof(options[0]); i++) {
+        if (strcmp(option, options[i]) == 0) return 1;
+    }
+    return 0;
 }
 
 void printUsage(const char *progName) {
-    fprintf(stderr, "Usage: %s build -f <input.s> -rom <output.rom>\n", progName);
+    fprintf(stderr, "Usage: %s build -f <input.s> [-rom <output.rom>] [-c <output.c>] [-exe <output>] [-O0] [-profile <ops.prof>] [--use-profile <run.prof>]\n", progName);
 }
 
 int main(int argc, char *argv[]) {
@@ -82,26 +161,46 @@ int main(int argc, char *argv[]) {
 
     if (strcmp(argv[1], "build") == 0) {
         const char *inputFile = NULL;
-        const char *outputFile = NULL;
+        CompileOutputs outputs = {NULL, NULL, NULL};
+        CompileOptions options = {1, NULL, NULL};
 
         for (int i = 2; i < argc; i++) {
             if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
                 inputFile = argv[i + 1];
                 i++;
             } else if (strcmp(argv[i], "-rom") == 0 && i + 1 < argc) {
-                outputFile = argv[i + 1];
+                outputs.module = argv[i + 1];
+                i++;
+            } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+                outputs.csource = argv[i + 1];
+                i++;
+            } else if (strcmp(argv[i], "-exe") == 0 && i + 1 < argc) {
+                outputs.executable = argv[i + 1];
+                i++;
+            } else if (strcmp(argv[i], "-O0") == 0) {
+                options.optimize = 0;
+            } else if (strcmp(argv[i], "-profile") == 0 && i + 1 < argc) {
+                options.opProfile = argv[i + 1];
+                i++;
+            } else if ((strcmp(argv[i], "--use-profile") == 0 || strcmp(argv[i], "-use-profile") == 0) &&
+                       i + 1 < argc) {
+                options.useProfile = argv[i + 1];
                 i++;
+            } else {
+                fprintf(stderr, "Error: %s '%s'\n", takesValue(argv[i]) ? "Missing value for option" : "Unknown option",
+                        argv[i]);
+                printUsage(argv[0]);
+                return 1;
             }
         }
 
-        if (!inputFile || !outputFile) {
-            fprintf(stderr, "Error: Missing -f or -rom argument\n");
+        if (!inputFile || (!outputs.module && !outputs.csource && !outputs.executable)) {
+            fprintf(stderr, "Error: Missing -f or output (-rom, -c, -exe) argument\n");
             printUsage(argv[0]);
             return 1;
         }
 
-        compile(inputFile, outputFile);
-        return 0;
+        return compile(inputFile, &outputs, &options);
     } else {
         fprintf(stderr, "Error: Unknown command '%s'\n", argv[1]);
         printUsage(argv[0]);
@@ -1,8 +1,27 @@
 #ifndef COMPILER_H
 #define COMPILER_H
 
-// Main compilation function
-void compile(const char *inputFile, const char *outputFile);
+#include "decode.h"
+
+// Files a build writes; NULL entries are skipped
+typedef struct {
+    const char *module;         // -rom: binary bytecode module
+    const char *csource;        // -c: translated C source
+    const char *executable;     // -exe: native executable built from the C source
+} CompileOutputs;
+
+// How a build transforms the program before writing it
+typedef struct {
+    int optimize;               // 0 with -O0
+    const char *opProfile;      // -profile: op profile for superinstructions
+    const char *useProfile;     // --use-profile: run profile for guarded specialization
+} CompileOptions;
+
+// Compile an assembly file into the requested outputs; returns 0 on success
+int compile(const char *inputFile, const CompileOutputs *outputs, const CompileOptions *options);
+
+// Translate a decoded program to C and build it with $CC (default gcc)
+int buildExecutable(const Program *program, int startIdx, const char *inputFile, const char *outputFile);
 
 // Print usage information
 void printUsage(const char *progName);
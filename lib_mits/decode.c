@@ -0,0 +1,856 @@
+#include "decode.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+
+#define MAX_TOKEN 64
+#define MAX_TEXT 512
+
+// Local copies of the text helpers so this file links into both tools
+static void trimText(char *str) {
+    int start = 0, end = strlen(str) - 1;
+    while (start <= end && isspace((unsigned char)str[start])) start++;
+    while (end >= start && isspace((unsigned char)str[end])) end--;
+    if (start > 0) {
+        memmove(str, str + start, end - start + 2);
+        str[end - start + 1] = '\0';
+    } else {
+        str[end + 1] = '\0';
+    }
+}
+
+static const char *nextWord(const char *str, char *word) {
+    int i = 0;
+    while (*str && !isspace((unsigned char)*str) && *str != ',' && i < MAX_TOKEN - 1) {
+        word[i++] = *str++;
+    }
+    word[i] = '\0';
+    while (*str && (isspace((unsigned char)*str) || *str == ',')) str++;
+    return str;
+}
+
+// Make room for needed elements. An array with no capacity but used
+// elements is borrowed from a mapped module and gets copied instead.
+static void *grow(void *data, int *capacity, int used, int needed, size_t size) {
+    if (needed <= *capacity) return data;
+    int cap = *capacity ? *capacity : 64;
+    while (cap < needed) cap *= 2;
+    void *grown = *capacity || !data ? realloc(data, cap * size) : malloc(cap * size);
+    if (!grown) {
+        fprintf(stderr, "Error: Out of memory while decoding\n");
+        exit(1);
+    }
+    if (!*capacity && data) memcpy(grown, data, used * size);
+    *capacity = cap;
+    return grown;
+}
+
+static int addText(Program *prog, const char *text, int len) {
+    prog->pool = grow(prog->pool, &prog->poolCapacity, prog->poolSize, prog->poolSize + len + 1, 1);
+    int offset = prog->poolSize;
+    memcpy(prog->pool + offset, text, len);
+    prog->pool[offset + len] = '\0';
+    prog->poolSize += len + 1;
+    return offset;
+}
+
+static Operand *addOperand(Program *prog, Instr *in) {
+    prog->operands = grow(prog->operands, &prog->operandCapacity, prog->operandCount, prog->operandCount + 1, sizeof(Operand));
+    if (in->argc == 0) in->args = prog->operandCount;
+    in->argc++;
+    Operand *op = &prog->operands[prog->operandCount++];
+    memset(op, 0, sizeof(*op));
+    op->kind = OPD_NUMBER;
+    op->ref = -1;
+    return op;
+}
+
+static void addTextOperand(Program *prog, Instr *in, const char *text, int len) {
+    int offset = addText(prog, text, len);
+    Operand *op = addOperand(prog, in);
+    op->kind = OPD_TEXT;
+    op->ref = offset;
+}
+
+const char *opName(int op) {
+    static const char *const names[OP_COUNT] = {
+        [OP_NOP] = "nop", [OP_MOV] = "mov", [OP_RDL] = "rdl", [OP_CHAR] = "char",
+        [OP_ADDR] = "addr", [OP_SUBR] = "subr", [OP_MUL] = "mul", [OP_DIV] = "div",
+        [OP_MOD] = "mod", [OP_SDA] = "sda", [OP_VGA] = "vga", [OP_EXEC] = "exec",
+        [OP_READ] = "read", [OP_REQ] = "req", [OP_WASM] = "wasm", [OP_VEC] = "vec",
+        [OP_BUF] = "buf", [OP_STR] = "str",
+        [OP_FOR] = "for", [OP_COND] = "cond", [OP_ELSE] = "else", [OP_END] = "end",
+        [OP_DEF] = "def", [OP_CALL] = "call", [OP_RET] = "ret", [OP_CALC] = "calc",
+        [OP_TEST] = "test",
+        [OP_CALC2] = "calc2", [OP_CALC3] = "calc3", [OP_CALC_TEST] = "calc_test",
+        [OP_CALC_END] = "calc_end", [OP_TEST_CALC] = "test_calc", [OP_GCALC] = "gcalc",
+        [OP_GTEST] = "gtest", [OP_INVALID] = "invalid",
+    };
+    return op >= 0 && op < OP_COUNT && names[op] ? names[op] : "?";
+}
+
+int baseOp(const Instr *in) {
+    switch (in->op) {
+    case OP_CALC2:
+    case OP_CALC3:
+    case OP_CALC_TEST:
+    case OP_CALC_END:
+        return OP_CALC;
+    case OP_TEST_CALC:
+        return OP_TEST;
+    case OP_GCALC:
+        return in->target;
+    case OP_GTEST:
+        return OP_COND;
+    default:
+        return in->op;
+    }
+}
+
+void initProgram(Program *prog) {
+    memset(prog, 0, sizeof(*prog));
+}
+
+void freeProgram(Program *prog) {
+    // Arrays without capacity belong to a mapped module
+    if (prog->codeCapacity) free(prog->code);
+    if (prog->operandCapacity) free(prog->operands);
+    if (prog->poolCapacity) free(prog->pool);
+    if (prog->nameCapacity) free(prog->names);
+    free(prog->malformed);
+    initProgram(prog);
+}
+
+int findName(const Program *prog, const char *name) {
+    for (int i = 0; i < prog->nameCount; i++) {
+        if (strcmp(prog->pool + prog->names[i], name) == 0) return i;
+    }
+    return -1;
+}
+
+int internName(Program *prog, const char *name) {
+    int slot = findName(prog, name);
+    if (slot >= 0) return slot;
+    int offset = addText(prog, name, strlen(name));
+    prog->names = grow(prog->names, &prog->nameCapacity, prog->nameCount, prog->nameCount + 1, sizeof(int));
+    prog->names[prog->nameCount] = offset;
+    return prog->nameCount++;
+}
+
+// Same rule the interpreter enforces on destinations
+static int isRegisterName(const char *name) {
+    if (strlen(name) != 3) return 0;
+    for (int i = 0; i < 3; i++) {
+        if (!isalpha((unsigned char)name[i])) return 0;
+    }
+    return 1;
+}
+
+// Tokens that could ever name a register; anything else is a plain literal
+static int isIdentifier(const char *word) {
+    if (!*word || isdigit((unsigned char)*word)) return 0;
+    for (const char *p = word; *p; p++) {
+        if (!isalnum((unsigned char)*p) && *p != '_') return 0;
+    }
+    return 1;
+}
+
+static int registerRef(Program *prog, const char *name) {
+    return isIdentifier(name) ? internName(prog, name) : -1;
+}
+
+double floatLiteral(const Operand *op) {
+    double num;
+    memcpy(&num, &op->num, sizeof(num));
+    return num;
+}
+
+static void setFloat(Operand *op, double num) {
+    op->kind = OPD_FLOAT;
+    memcpy(&op->num, &num, sizeof(num));
+}
+
+// Digits with one decimal point, optionally signed: 1.08, -0.5, 3.
+static int isFloatWord(const char *word, double *num) {
+    const char *p = word + (*word == '-' || *word == '+');
+    int digits = 0, points = 0;
+    for (; *p; p++) {
+        if (isdigit((unsigned char)*p)) digits++;
+        else if (*p == '.') points++;
+        else return 0;
+    }
+    if (digits == 0 || points != 1) return 0;
+    *num = strtod(word, NULL);
+    return isfinite(*num);
+}
+
+// Returns 0 if text is not an operand at all; it then reads as the number
+// its leading digits make, if any
+static int decodeOperand(Program *prog, Operand *op, const char *text) {
+    char word[MAX_TOKEN];
+    strncpy(word, text, MAX_TOKEN - 1);
+    word[MAX_TOKEN - 1] = '\0';
+    trimText(word);
+
+    static const struct { const char *prefix; OperandKind kind; } conversions[] = {
+        { "hex=", OPD_HEX }, { "b31 ", OPD_B31 }, { "b32 ", OPD_B32 }, { "i32 ", OPD_B32 },
+        { "c26 ", OPD_C26 }, { "UTF ", OPD_UTF }, { "flt ", OPD_FLT }
+    };
+
+    char *end;
+    if (strncmp(word, "rom=", 4) == 0) {
+        op->kind = OPD_ROM;
+        op->ref = addText(prog, word + 4, strlen(word + 4));
+        return 1;
+    }
+    if (strncmp(word, "code=", 5) == 0) {
+        op->kind = OPD_NUMBER;
+        op->num = strtoll(word + 5, &end, 10);
+        return end > word + 5 && *end == '\0';
+    }
+    for (size_t i = 0; i < sizeof(conversions) / sizeof(conversions[0]); i++) {
+        if (strncmp(word, conversions[i].prefix, 4) == 0) {
+            op->kind = conversions[i].kind;
+            op->ref = registerRef(prog, word + 4);
+            return op->ref >= 0;
+        }
+    }
+    if (strcmp(word, "ARGUMENTS") == 0) {
+        op->kind = OPD_ARGUMENTS;
+        return 1;
+    }
+    double num;
+    if (isFloatWord(word, &num)) {
+        setFloat(op, num);
+        return 1;
+    }
+
+    op->num = strtoll(word, &end, 10);
+    op->ref = registerRef(prog, word);
+    op->kind = op->ref >= 0 ? OPD_REGISTER : OPD_NUMBER;
+    return op->ref >= 0 || (end > word && *end == '\0');
+}
+
+// Checks a destination; invalid names turn the instruction into OP_INVALID
+static int decodeDest(Program *prog, Instr *in, const char *name) {
+    if (!isRegisterName(name)) {
+        in->op = OP_INVALID;
+        in->argc = 0;
+        addTextOperand(prog, in, name, strlen(name));
+        return 0;
+    }
+    in->dest = internName(prog, name);
+    return 1;
+}
+
+// Split left/right around the first occurrence of sep into two operands
+static int decodeBinary(Program *prog, Instr *in, const char *expr, char sep) {
+    const char *at = strchr(expr, sep);
+    if (!at) return 0;
+    char left[MAX_TEXT];
+    int len = at - expr < MAX_TEXT - 1 ? at - expr : MAX_TEXT - 1;
+    memcpy(left, expr, len);
+    left[len] = '\0';
+    decodeOperand(prog, addOperand(prog, in), left);
+    decodeOperand(prog, addOperand(prog, in), at + 1);
+    return 1;
+}
+
+// Arithmetic expressions are parsed once into postfix operands: leaves
+// are ordinary operands, operators follow their inputs. Parsing is lenient
+// like the rest of the language: a missing operand reads as 0, an open
+// parenthesis closes at the end of the line and text after an unmatched
+// ')' is ignored. Such an expression still runs that way, but the
+// instruction goes on the program's malformed list for verifyProgram to
+// report.
+typedef struct {
+    Program *prog;
+    Instr *in;
+    const char *at;
+    int malformed;
+} ExprParser;
+
+static void skipSpace(ExprParser *p) {
+    while (isspace((unsigned char)*p->at)) p->at++;
+}
+
+static void addOperator(ExprParser *p, OperandKind kind) {
+    addOperand(p->prog, p->in)->kind = kind;
+}
+
+static void parseSum(ExprParser *p);
+
+static void parsePrimary(ExprParser *p) {
+    skipSpace(p);
+    if (*p->at == '(') {
+        p->at++;
+        parseSum(p);
+        skipSpace(p);
+        if (*p->at == ')') p->at++;
+        else p->malformed = 1;
+        return;
+    }
+
+    // A leaf runs up to the next operator or parenthesis
+    const char *start = p->at;
+    while (*p->at && !strchr("+-*/%()", *p->at)) p->at++;
+    char leaf[MAX_TEXT];
+    int len = p->at - start < MAX_TEXT - 1 ? p->at - start : MAX_TEXT - 1;
+    memcpy(leaf, start, len);
+    leaf[len] = '\0';
+    if (!decodeOperand(p->prog, addOperand(p->prog, p->in), leaf)) p->malformed = 1;
+}
+
+static void parseUnary(ExprParser *p) {
+    skipSpace(p);
+    if (*p->at == '+') {
+        p->at++;
+        parseUnary(p);
+    } else if (*p->at == '-') {
+        p->at++;
+        int first = p->prog->operandCount;
+        parseUnary(p);
+        Operand *last = &p->prog->operands[p->prog->operandCount - 1];
+        if (p->prog->operandCount - first == 1 && last->kind == OPD_NUMBER) {
+            // Fold negative literals
+            last->num = (long long)(0ULL - (unsigned long long)last->num);
+        } else if (p->prog->operandCount - first == 1 && last->kind == OPD_FLOAT) {
+            setFloat(last, -floatLiteral(last));
+        } else {
+            addOperator(p, OPD_NEG);
+        }
+    } else {
+        parsePrimary(p);
+    }
+}
+
+static void parseProduct(ExprParser *p) {
+    parseUnary(p);
+    for (;;) {
+        skipSpace(p);
+        char op = *p->at;
+        if (op != '*' && op != '/' && op != '%') return;
+        p->at++;
+        parseUnary(p);
+        addOperator(p, op == '*' ? OPD_MUL : op == '/' ? OPD_DIV : OPD_MOD);
+    }
+}
+
+static void parseSum(ExprParser *p) {
+    parseProduct(p);
+    for (;;) {
+        skipSpace(p);
+        char op = *p->at;
+        if (op != '+' && op != '-') return;
+        p->at++;
+        parseProduct(p);
+        addOperator(p, op == '+' ? OPD_ADD : OPD_SUB);
+    }
+}
+
+static void decodeExpression(Program *prog, Instr *in, const char *expr) {
+    ExprParser parser = { prog, in, expr, 0 };
+    parseSum(&parser);
+    skipSpace(&parser);
+    if (*parser.at || parser.malformed) {
+        prog->malformed = grow(prog->malformed, &prog->malformedCapacity, prog->malformedCount,
+                               prog->malformedCount + 1, sizeof(int));
+        prog->malformed[prog->malformedCount++] = in - prog->code;
+    }
+}
+
+// Locate the text between the first pair of quotes following start
+static int quoted(const char *start, const char **text) {
+    const char *open = strchr(start, '"');
+    if (!open) return -1;
+    const char *close = strchr(open + 1, '"');
+    if (!close) return -1;
+    *text = open + 1;
+    return close - open - 1;
+}
+
+static void addAttribute(Program *prog, Instr *in, const char *data, const char *name) {
+    const char *at = strstr(data, name);
+    const char *text = "";
+    int len = 0;
+    if (at) {
+        at += strlen(name);
+        const char *end = strchr(at, '"');
+        if (end) {
+            text = at;
+            len = end - at;
+        }
+    }
+    addTextOperand(prog, in, text, len);
+}
+
+// wasm -ne takes txt="..." or txt=reg, the text a register holds when the
+// element is made
+static void addTextAttribute(Program *prog, Instr *in, const char *data) {
+    const char *at = strstr(data, "txt=");
+    if (!at || at[4] == '"') {
+        addAttribute(prog, in, data, "txt=\"");
+        return;
+    }
+    char word[MAX_TOKEN];
+    nextWord(at + 4, word);
+    if (word[0]) decodeOperand(prog, addOperand(prog, in), word);
+    else addTextOperand(prog, in, "", 0);
+}
+
+static void decodeFor(Program *prog, Instr *in, const char *line) {
+    char copy[MAX_TEXT];
+    strncpy(copy, line + (strlen(line) >= 4 ? 4 : strlen(line)), MAX_TEXT - 1);
+    copy[MAX_TEXT - 1] = '\0';
+    in->mode = FOR_MALFORMED;
+
+    char *marker = strstr(copy, ", exec:");
+    if (!marker) return;
+    *marker = '\0';
+    for (char *c = copy; *c; c++) {
+        if (*c == ',') *c = ' ';
+    }
+
+    char *mov = strtok(copy, " ");
+    char *var = strtok(NULL, " ");
+    char *from = strtok(NULL, " ");
+    char *to = strtok(NULL, " ");
+    if (!mov || !var || !from || !to || strcmp(mov, "mov") != 0) return;
+
+    if (!isRegisterName(var)) {
+        in->mode = FOR_INVALID_NAME;
+        addTextOperand(prog, in, var, strlen(var));
+        return;
+    }
+    in->mode = FOR_OK;
+    in->dest = internName(prog, var);
+    decodeOperand(prog, addOperand(prog, in), from);
+    decodeOperand(prog, addOperand(prog, in), to);
+}
+
+// def name, ARGUMENTS, pure, exec: - dest holds the name, -1 if it has none
+static void decodeDef(Program *prog, Instr *in, const char *line) {
+    char name[MAX_TOKEN];
+    const char *at = line + 3;
+    while (isspace((unsigned char)*at)) at++;
+    const char *rest = nextWord(at, name);
+    if (isIdentifier(name)) in->dest = internName(prog, name);
+    in->mode = strstr(rest, "ARGUMENTS") ? DEF_ARGUMENTS : DEF_PLAIN;
+    while (*rest) {
+        rest = nextWord(rest, name);
+        if (strcmp(name, "pure") == 0) in->mode |= DEF_PURE;
+    }
+}
+
+// exec value, or exec name, arguments... for a def. The first item is
+// args[0] either way; dest names it when it could be a def.
+static void decodeExec(Program *prog, Instr *in, const char *rest) {
+    if (strncmp(rest, "sys=help", 8) == 0) {
+        in->mode = EXEC_HELP;
+        return;
+    }
+
+    char copy[MAX_TEXT];
+    strncpy(copy, rest, MAX_TEXT - 1);
+    copy[MAX_TEXT - 1] = '\0';
+    char *item = copy;
+    for (;;) {
+        char *comma = strchr(item, ',');
+        if (comma) *comma = '\0';
+        decodeOperand(prog, addOperand(prog, in), item);
+        if (!comma) break;
+        item = comma + 1;
+    }
+
+    const Operand *name = operandAt(prog, in, 0);
+    if (name->kind == OPD_REGISTER) in->dest = name->ref;
+}
+
+static void decodeCond(Program *prog, Instr *in, const char *line) {
+    char copy[MAX_TEXT];
+    strncpy(copy, line + (strlen(line) >= 5 ? 5 : strlen(line)), MAX_TEXT - 1);
+    copy[MAX_TEXT - 1] = '\0';
+    in->mode = CMP_MALFORMED;
+
+    char *comma = strchr(copy, ',');
+    if (!comma) return;
+    *comma = '\0';
+    trimText(copy);
+
+    char *left = strtok(copy, " ");
+    char *cmp = strtok(NULL, " ");
+    char *right = strtok(NULL, " ");
+    if (!left || !cmp || !right) return;
+
+    static const char *names[] = { "<", ">", "<=", ">=", "==", "!=" };
+    in->mode = CMP_NONE;
+    for (int i = 0; i < 6; i++) {
+        if (strcmp(cmp, names[i]) == 0) in->mode = CMP_LT + i;
+    }
+    decodeOperand(prog, addOperand(prog, in), left);
+    decodeOperand(prog, addOperand(prog, in), right);
+}
+
+static void decodeRead(Program *prog, Instr *in, const char *rest) {
+    char copy[MAX_TEXT];
+    char *args[10];
+    int count = 0;
+    strncpy(copy, rest, MAX_TEXT - 1);
+    copy[MAX_TEXT - 1] = '\0';
+    for (char *tok = strtok(copy, " "); tok && count < 10; tok = strtok(NULL, " ")) {
+        args[count++] = tok;
+    }
+
+    int first = 0;
+    for (int i = 0; i < count; i++) {
+        if (strcmp(args[i], "-lt") == 0) {
+            in->mode |= READ_LT;
+            first = i + 1;
+        } else if (strcmp(args[i], "-a") == 0) {
+            in->mode |= READ_ALL;
+        } else if (strcmp(args[i], "-hxd") == 0) {
+            in->mode |= READ_HXD;
+        }
+    }
+    while (first < count && (strcmp(args[first], "-a") == 0 || strcmp(args[first], "-hxd") == 0)) {
+        first++;
+    }
+    for (int i = first; i < count && i < first + 3; i++) {
+        addTextOperand(prog, in, args[i], strlen(args[i]));
+    }
+}
+
+// req ftype="type", "file" and, for "bin", the register the file goes to
+static void decodeReq(Program *prog, Instr *in, const char *rest) {
+    const char *ftype, *path;
+    int ftypeLen = quoted(rest, &ftype);
+    if (ftypeLen <= 0) return;
+    int pathLen = quoted(ftype + ftypeLen + 1, &path);
+    if (pathLen <= 0) return;
+    addTextOperand(prog, in, ftype, ftypeLen);
+    addTextOperand(prog, in, path, pathLen);
+
+    char dest[MAX_TOKEN];
+    rest = path + pathLen + 1;
+    while (*rest == ',' || isspace((unsigned char)*rest)) rest++;
+    nextWord(rest, dest);
+    if (dest[0]) decodeDest(prog, in, dest);
+}
+
+static void decodeWasm(Program *prog, Instr *in, const char *rest) {
+    char flag[MAX_TOKEN], spec[MAX_TEXT];
+    const char *text;
+    int len;
+    rest = nextWord(rest, flag);
+
+    if (strcmp(flag, "-np") == 0) {
+        nextWord(rest, spec);
+        if ((len = quoted(spec, &text)) < 0) return;
+        in->mode = WASM_NEW_PAGE;
+        addTextOperand(prog, in, text, len);
+    } else if (strcmp(flag, "-ne") == 0) {
+        in->mode = WASM_NEW_ELEMENT;
+        addAttribute(prog, in, rest, "type=\"");
+        addTextAttribute(prog, in, rest);
+        addAttribute(prog, in, rest, "id=\"");
+        addAttribute(prog, in, rest, "class=\"");
+        addAttribute(prog, in, rest, "style=\"");
+    } else if (strcmp(flag, "-ae") == 0) {
+        in->mode = WASM_ATTACH;
+        for (int i = 0; i < 2; i++) {
+            rest = nextWord(rest, spec);
+            len = quoted(spec, &text);
+            addTextOperand(prog, in, len < 0 ? "" : text, len < 0 ? 0 : len);
+        }
+    } else if (strcmp(flag, "-op") == 0) {
+        char port[MAX_TOKEN], ap[MAX_TOKEN];
+        rest = nextWord(rest, port);
+        rest = nextWord(rest, ap);
+        nextWord(rest, spec);
+        in->mode = WASM_OPEN_PORT;
+        addTextOperand(prog, in, port, strlen(port));
+        len = quoted(spec, &text);
+        addTextOperand(prog, in, len < 0 ? "" : text, len < 0 ? 0 : len);
+    } else if (strcmp(flag, "-ns") == 0) {
+        in->mode = WASM_NEW_SCRIPT;
+    }
+}
+
+static const char *const vecNames[] = {
+    [VEC_FILL] = "fill", [VEC_ADD] = "add", [VEC_MUL] = "mul", [VEC_DOT] = "dot",
+    [VEC_SUM] = "sum", [VEC_MIN] = "min", [VEC_MAX] = "max", [VEC_SLICE] = "slice",
+    [VEC_GET] = "get", [VEC_SET] = "set", [VEC_LEN] = "len", [VEC_PUSH] = "push",
+};
+
+static const char *const bufNames[] = {
+    [BUF_XOR] = "xor", [BUF_AND] = "and", [BUF_OR] = "or", [BUF_CMP] = "cmp",
+    [BUF_FIND] = "find", [BUF_COUNT] = "count", [BUF_CRC] = "crc", [BUF_XXH] = "xxh",
+    [BUF_SHA] = "sha", [BUF_SLICE] = "slice", [BUF_LEN] = "len",
+};
+
+static const char *const strNames[] = {
+    [STR_NEW] = "new", [STR_ADD] = "add", [STR_LEN] = "len",
+};
+
+int vecOperandCount(int mode) {
+    static const int counts[] = {
+        [VEC_NONE] = -1, [VEC_FILL] = 2, [VEC_ADD] = 2, [VEC_MUL] = 2, [VEC_DOT] = 2,
+        [VEC_SUM] = 1, [VEC_MIN] = 1, [VEC_MAX] = 1, [VEC_SLICE] = 3, [VEC_GET] = 2,
+        [VEC_SET] = 3, [VEC_LEN] = 1, [VEC_PUSH] = 2,
+    };
+    return mode >= 0 && mode <= VEC_PUSH ? counts[mode] : -1;
+}
+
+int bufOperandCount(int mode) {
+    static const int counts[] = {
+        [BUF_NONE] = -1, [BUF_XOR] = 2, [BUF_AND] = 2, [BUF_OR] = 2, [BUF_CMP] = 2,
+        [BUF_FIND] = 3, [BUF_COUNT] = 1, [BUF_CRC] = 1, [BUF_XXH] = 1, [BUF_SHA] = 1,
+        [BUF_SLICE] = 3, [BUF_LEN] = 1,
+    };
+    return mode >= 0 && mode <= BUF_LEN ? counts[mode] : -1;
+}
+
+int strOperandCount(int mode) {
+    static const int counts[] = { [STR_NONE] = -1, [STR_NEW] = 0, [STR_ADD] = 2, [STR_LEN] = 1 };
+    return mode >= 0 && mode <= STR_LEN ? counts[mode] : -1;
+}
+
+// vec, buf and str: dest, operation, operands... with the operation one of
+// names[1..last]. An unknown operation leaves mode 0, no destination and
+// no operands.
+static void decodeOperation(Program *prog, Instr *in, const char *rest, const char *const *names, int last,
+                            int (*operandCount)(int)) {
+    char dest[MAX_TOKEN], name[MAX_TOKEN];
+    rest = nextWord(rest, dest);
+    rest = nextWord(rest, name);
+    if (!decodeDest(prog, in, dest)) return;
+    for (int mode = 1; mode <= last; mode++) {
+        if (strcmp(name, names[mode]) == 0) in->mode = mode;
+    }
+    if (in->mode == 0) {
+        // Stores nothing
+        in->dest = -1;
+        return;
+    }
+
+    char copy[MAX_TEXT];
+    strncpy(copy, rest, MAX_TEXT - 1);
+    copy[MAX_TEXT - 1] = '\0';
+    // Missing operands read as 0, extra ones are ignored
+    char *item = copy;
+    for (int k = 0; k < operandCount(in->mode); k++) {
+        char *comma = item ? strchr(item, ',') : NULL;
+        if (comma) *comma = '\0';
+        decodeOperand(prog, addOperand(prog, in), item ? item : "");
+        item = comma ? comma + 1 : NULL;
+    }
+}
+
+// Labels ("name:") with no operands never execute
+static int isLabel(const char *line) {
+    size_t len = strlen(line);
+    return len > 0 && line[len - 1] == ':' && strchr(line, ' ') == NULL;
+}
+
+int decodeLine(Program *prog, const char *line, int lineNo) {
+    prog->code = grow(prog->code, &prog->codeCapacity, prog->codeCount, prog->codeCount + 1, sizeof(Instr));
+    int index = prog->codeCount++;
+    Instr *in = &prog->code[index];
+    memset(in, 0, sizeof(*in));
+    in->op = OP_NOP;
+    in->dest = -1;
+    in->line = lineNo;
+
+    if (line[0] == '\0' || line[0] == ';' || isLabel(line)) return index;
+
+    // Block structure is recognised on the raw line, before comments are cut
+    char word[MAX_TOKEN];
+    nextWord(line, word);
+    if (strcmp(word, "for") == 0) {
+        in->op = OP_FOR;
+        decodeFor(prog, in, line);
+        return index;
+    }
+    if (strcmp(word, "cond") == 0) {
+        in->op = OP_COND;
+        decodeCond(prog, in, line);
+        return index;
+    }
+    if (strcmp(word, "def") == 0) {
+        in->op = OP_DEF;
+        decodeDef(prog, in, line);
+        return index;
+    }
+    if (strcmp(word, "end") == 0) {
+        in->op = OP_END;
+        return index;
+    }
+    if (strcmp(line, "else") == 0) {
+        in->op = OP_ELSE;
+        return index;
+    }
+
+    char text[MAX_TEXT];
+    strncpy(text, line, MAX_TEXT - 1);
+    text[MAX_TEXT - 1] = '\0';
+    char *comment = strchr(text, ';');
+    if (comment) *comment = '\0';
+    trimText(text);
+    if (text[0] == '\0') return index;
+
+    char instruction[MAX_TOKEN], dest[MAX_TOKEN], flag[MAX_TOKEN];
+    const char *rest = nextWord(text, instruction);
+    const char *start;
+    int len;
+
+    if (strcmp(instruction, "mov") == 0) {
+        rest = nextWord(rest, dest);
+        in->op = OP_MOV;
+        if (decodeDest(prog, in, dest)) decodeOperand(prog, addOperand(prog, in), rest);
+    } else if (strcmp(instruction, "rdl") == 0) {
+        flag[0] = '\0';
+        if (rest[0] == '-') rest = nextWord(rest, flag);
+        nextWord(rest, dest);
+        in->op = OP_RDL;
+        in->mode = strcmp(flag, "-i") == 0 ? RDL_INT : strcmp(flag, "-f") == 0 ? RDL_FLOAT : RDL_STRING;
+        decodeDest(prog, in, dest);
+    } else if (strcmp(instruction, "char") == 0) {
+        rest = nextWord(rest, dest);
+        in->op = OP_CHAR;
+        if (decodeDest(prog, in, dest)) {
+            if ((len = quoted(rest, &start)) < 0) in->op = OP_NOP;
+            else addTextOperand(prog, in, start, len);
+        }
+    } else if (strcmp(instruction, "addr") == 0) {
+        rest = nextWord(rest, dest);
+        in->op = OP_ADDR;
+        if (decodeDest(prog, in, dest)) {
+            if (decodeBinary(prog, in, rest, '+')) in->mode = ADDR_CONCAT;
+            decodeExpression(prog, in, rest);
+        }
+    } else if (strcmp(instruction, "subr") == 0) {
+        rest = nextWord(rest, dest);
+        in->op = OP_SUBR;
+        in->dest = internName(prog, dest);
+        decodeExpression(prog, in, rest);
+    } else if (strcmp(instruction, "mul") == 0 || strcmp(instruction, "div") == 0 ||
+               strcmp(instruction, "mod") == 0) {
+        rest = nextWord(rest, dest);
+        char sep = instruction[1] == 'u' ? '*' : instruction[0] == 'd' ? '/' : '%';
+        in->op = sep == '*' ? OP_MUL : sep == '/' ? OP_DIV : OP_MOD;
+        if (decodeDest(prog, in, dest)) {
+            // Without its own operator the instruction does nothing
+            if (!strchr(rest, sep)) in->op = OP_NOP;
+            else decodeExpression(prog, in, rest);
+        }
+    } else if (strcmp(instruction, "sda") == 0) {
+        rest = nextWord(rest, dest);
+        in->op = OP_SDA;
+        if (decodeDest(prog, in, dest)) {
+            if (strncmp(rest, "ARGUMENTS", 9) == 0) {
+                in->mode = SDA_ARGUMENTS;
+            } else {
+                while (*rest) {
+                    rest = nextWord(rest, word);
+                    if (word[0] == '\0') break;
+                    decodeOperand(prog, addOperand(prog, in), word);
+                }
+            }
+        }
+    } else if (strcmp(instruction, "vga") == 0) {
+        in->op = OP_VGA;
+        decodeOperand(prog, addOperand(prog, in), rest);
+    } else if (strcmp(instruction, "exec") == 0) {
+        in->op = OP_EXEC;
+        decodeExec(prog, in, rest);
+    } else if (strcmp(instruction, "read") == 0) {
+        in->op = OP_READ;
+        decodeRead(prog, in, rest);
+    } else if (strcmp(instruction, "req") == 0) {
+        in->op = OP_REQ;
+        decodeReq(prog, in, rest);
+    } else if (strcmp(instruction, "wasm") == 0) {
+        in->op = OP_WASM;
+        decodeWasm(prog, in, rest);
+    } else if (strcmp(instruction, "vec") == 0) {
+        in->op = OP_VEC;
+        decodeOperation(prog, in, rest, vecNames, VEC_PUSH, vecOperandCount);
+    } else if (strcmp(instruction, "buf") == 0) {
+        in->op = OP_BUF;
+        decodeOperation(prog, in, rest, bufNames, BUF_LEN, bufOperandCount);
+    } else if (strcmp(instruction, "str") == 0) {
+        in->op = OP_STR;
+        decodeOperation(prog, in, rest, strNames, STR_LEN, strOperandCount);
+    }
+    return index;
+}
+
+// Turn every exec that names a def into a call. Runs over the whole
+// program, so code decoded earlier can call defs that arrive later.
+static void linkCalls(Program *prog) {
+    int *defs = malloc((prog->nameCount + 1) * sizeof(int));
+    if (!defs) {
+        fprintf(stderr, "Error: Out of memory while decoding\n");
+        exit(1);
+    }
+    for (int slot = 0; slot < prog->nameCount; slot++) defs[slot] = -1;
+    for (int i = 0; i < prog->codeCount; i++) {
+        const Instr *in = &prog->code[i];
+        if (in->op == OP_DEF && in->dest >= 0 && defs[in->dest] < 0) defs[in->dest] = i;
+    }
+    for (int i = 0; i < prog->codeCount; i++) {
+        Instr *in = &prog->code[i];
+        if (in->op == OP_EXEC && in->mode == EXEC_VALUE && in->dest >= 0 && defs[in->dest] >= 0) {
+            in->op = OP_CALL;
+            in->target = defs[in->dest];
+        }
+    }
+    free(defs);
+}
+
+void resolveBlocks(Program *prog, int first) {
+    int *open = malloc((prog->codeCount - first + 1) * sizeof(int));
+    int depth = 0;
+    if (!open) {
+        fprintf(stderr, "Error: Out of memory while decoding\n");
+        exit(1);
+    }
+
+    for (int i = first; i < prog->codeCount; i++) {
+        Instr *in = &prog->code[i];
+        in->target = -1;
+        in->alt = -1;
+
+        if (in->op == OP_END && depth > 0) {
+            Instr *opener = &prog->code[open[--depth]];
+            opener->target = i;
+            in->target = open[depth];
+            if (opener->op == OP_DEF) in->op = OP_RET;
+        } else if (in->op == OP_ELSE && depth > 0 && prog->code[open[depth - 1]].op == OP_COND &&
+                   prog->code[open[depth - 1]].alt < 0) {
+            prog->code[open[depth - 1]].alt = i;
+            in->alt = open[depth - 1];
+        }
+        in->depth = in->op == OP_ELSE && in->alt >= 0 ? depth - 1 : depth;
+
+        if (in->op == OP_FOR || in->op == OP_COND || in->op == OP_DEF) {
+            open[depth++] = i;
+            if (depth > prog->maxDepth) prog->maxDepth = depth;
+        }
+    }
+
+    // Unterminated blocks run to the end of what was decoded
+    while (depth > 0) {
+        prog->code[open[--depth]].target = prog->codeCount;
+    }
+
+    // An else jumps to the end of its cond
+    for (int i = first; i < prog->codeCount; i++) {
+        Instr *in = &prog->code[i];
+        if (in->op == OP_ELSE && in->alt >= 0) in->target = prog->code[in->alt].target;
+    }
+    free(open);
+    linkCalls(prog);
+}
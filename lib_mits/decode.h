@@ -0,0 +1,203 @@
+#ifndef DECODE_H
+#define DECODE_H
+
+// Instruction set understood by the executor. Every source line decodes to
+// exactly one instruction, so an instruction index is also a line index.
+typedef enum {
+    OP_NOP,
+    OP_MOV,
+    OP_RDL,
+    OP_CHAR,
+    OP_ADDR,
+    OP_SUBR,
+    OP_MUL,
+    OP_DIV,
+    OP_MOD,
+    OP_SDA,
+    OP_VGA,
+    OP_EXEC,
+    OP_READ,
+    OP_REQ,
+    OP_WASM,
+    OP_VEC,
+    OP_BUF,
+    OP_STR,
+    OP_FOR,
+    OP_COND,
+    OP_ELSE,
+    OP_END,
+    OP_DEF,
+    OP_CALL,        // exec of a def, linked by resolveBlocks
+    OP_RET,         // the end closing a def
+    OP_CALC,        // numeric store: operands and register are always numbers
+    OP_TEST,        // cond whose operands are always numbers
+    // Superinstructions fused by mits-compiler -profile. Each replaces the
+    // first instruction of its sequence and runs the whole sequence in one
+    // dispatch; the instructions after it stay in place.
+    OP_CALC2,       // calc, calc
+    OP_CALC3,       // calc, calc, calc
+    OP_CALC_TEST,   // calc, test
+    OP_CALC_END,    // calc, end
+    OP_TEST_CALC,   // test, calc
+    // Guarded forms chosen by mits-compiler --use-profile for instructions
+    // that only met numbers in the training run
+    OP_GCALC,       // calc if every register holds a number, else target's opcode
+    OP_GTEST,       // test if both operands hold numbers, else a plain cond
+    OP_INVALID,     // destination failed the 3-letter name check
+    OP_COUNT
+} Opcode;
+
+// Operand kinds, one per form accepted by the old parseValue
+typedef enum {
+    OPD_NUMBER,     // literal number (also code=N)
+    OPD_REGISTER,   // register reference, falls back to the literal in num
+    OPD_ROM,        // rom=key, ref is the pool offset of the key
+    OPD_HEX,        // hex=reg
+    OPD_B31,        // b31 reg
+    OPD_B32,        // b32 reg / i32 reg
+    OPD_C26,        // c26 reg
+    OPD_UTF,        // UTF reg
+    OPD_FLT,        // flt reg
+    OPD_ARGUMENTS,  // ARGUMENTS
+    OPD_TEXT,       // raw text, ref is a pool offset
+    OPD_FLOAT,      // literal float such as 1.08, see floatLiteral
+    OPD_ADD,        // expression operators, in postfix after their inputs
+    OPD_SUB,
+    OPD_MUL,
+    OPD_DIV,
+    OPD_MOD,
+    OPD_NEG
+} OperandKind;
+
+// rdl input modes
+enum { RDL_STRING, RDL_INT, RDL_FLOAT };
+
+// cond comparisons
+enum { CMP_NONE, CMP_LT, CMP_GT, CMP_LE, CMP_GE, CMP_EQ, CMP_NE, CMP_MALFORMED };
+
+// for header states
+enum { FOR_OK, FOR_MALFORMED, FOR_INVALID_NAME };
+
+// addr forms: ADDR_CONCAT keeps both halves of the first '+' in args[0..1]
+// ahead of the expression
+enum { ADDR_NUMERIC, ADDR_CONCAT };
+
+// sda forms
+enum { SDA_LIST, SDA_ARGUMENTS };
+
+// exec forms
+enum { EXEC_VALUE, EXEC_HELP };
+
+// def flags: DEF_ARGUMENTS bodies read their call arguments through
+// ARGUMENTS, DEF_PURE defs were declared pure, and calls to DEF_MEMO defs
+// are memoized (set by the optimizer)
+enum { DEF_PLAIN, DEF_ARGUMENTS = 1, DEF_PURE = 2, DEF_MEMO = 4 };
+
+// read flags
+enum { READ_LT = 1, READ_ALL = 2, READ_HXD = 4 };
+
+// wasm subcommands
+enum { WASM_NONE, WASM_NEW_PAGE, WASM_NEW_ELEMENT, WASM_ATTACH, WASM_OPEN_PORT, WASM_NEW_SCRIPT };
+
+// vec operations
+enum {
+    VEC_NONE, VEC_FILL, VEC_ADD, VEC_MUL, VEC_DOT, VEC_SUM, VEC_MIN, VEC_MAX,
+    VEC_SLICE, VEC_GET, VEC_SET, VEC_LEN, VEC_PUSH
+};
+
+// buf operations
+enum { BUF_NONE, BUF_XOR, BUF_AND, BUF_OR, BUF_CMP, BUF_FIND, BUF_COUNT, BUF_CRC, BUF_XXH, BUF_SHA,
+       BUF_SLICE, BUF_LEN };
+
+// str operations
+enum { STR_NONE, STR_NEW, STR_ADD, STR_LEN };
+
+typedef struct {
+    unsigned char kind;     // OperandKind
+    int ref;                // register slot or pool offset, -1 if none
+    long long num;          // literal value
+} Operand;
+
+typedef struct {
+    unsigned char op;       // Opcode
+    unsigned char mode;     // opcode-specific form (rdl mode, comparison, ...)
+    unsigned short argc;    // number of operands
+    int dest;               // destination register slot, -1 if none
+    int args;               // index of the first operand in Program.operands
+    int target;             // for/cond/def: matching end; call: its def;
+                            // else/end/ret: see resolveBlocks; gcalc:
+                            // the opcode it falls back to
+    int alt;                // cond: its else; else: its cond
+    int depth;              // block nesting depth, 0 at top level
+    int line;               // source line number (1-based)
+} Instr;
+
+// A program's arrays are normally heap-allocated. A program loaded from a
+// module borrows them from the mapped file instead (capacity 0); decoding
+// more lines into it copies each array the first time it has to grow.
+typedef struct {
+    Instr *code;
+    int codeCount;
+    int codeCapacity;
+    Operand *operands;
+    int operandCount;
+    int operandCapacity;
+    char *pool;             // NUL-terminated text constants
+    int poolSize;
+    int poolCapacity;
+    int *names;             // register slot -> pool offset of its name
+    int nameCount;
+    int nameCapacity;
+    int maxDepth;           // deepest block nesting seen so far
+    int *malformed;         // instructions whose expression did not parse
+    int malformedCount;     // cleanly, in order; modules never have any
+    int malformedCapacity;
+} Program;
+
+// Initialize an empty program
+void initProgram(Program *prog);
+
+// Release everything owned by a program
+void freeProgram(Program *prog);
+
+// Decode one source line and append it; returns the instruction index
+int decodeLine(Program *prog, const char *line, int lineNo);
+
+// Return the register slot for a name, adding it if needed
+int internName(Program *prog, const char *name);
+
+// Return the slot for a name, or -1 if the program never mentions it
+int findName(const Program *prog, const char *name);
+
+// Match for/cond/def headers with their else/end lines for every
+// instruction from first onwards. Openers without an end get the index
+// just past the last instruction; stray else/end lines get -1. The end of
+// a def becomes OP_RET, and every exec naming a def anywhere in the
+// program becomes OP_CALL with target set to that def; the first def of
+// a name wins.
+void resolveBlocks(Program *prog, int first);
+
+// Name of an opcode as written in op profiles
+const char *opName(int op);
+
+// Generic opcode an instruction stands for: the first opcode of a
+// superinstruction, or the one a guarded opcode falls back to. The
+// operands still have that opcode's layout.
+int baseOp(const Instr *in);
+
+// Operands a vec operation takes, -1 for VEC_NONE
+int vecOperandCount(int mode);
+
+// Operands a buf operation takes, -1 for BUF_NONE
+int bufOperandCount(int mode);
+
+// Operands a str operation takes, -1 for STR_NONE
+int strOperandCount(int mode);
+
+// Value of an OPD_FLOAT operand, whose bits are kept in num
+double floatLiteral(const Operand *op);
+
+#define poolText(prog, offset) ((prog)->pool + (offset))
+#define operandAt(prog, in, i) (&(prog)->operands[(in)->args + (i)])
+
+#endif // DECODE_H
@@ -0,0 +1,84 @@
+#include "fuse.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    int op;                 // the superinstruction
+    int length;
+    int ops[3];             // the sequence it replaces
+    long long count;        // times the sequence ran in the profile
+} Pattern;
+
+static int opByName(const char *name) {
+    for (int op = 0; op < OP_COUNT; op++) {
+        if (strcmp(opName(op), name) == 0) return op;
+    }
+    return -1;
+}
+
+static int compareSavings(const void *a, const void *b) {
+    const Pattern *x = a, *y = b;
+    long long sx = x->count * (x->length - 1), sy = y->count * (y->length - 1);
+    return sx < sy ? 1 : sx > sy ? -1 : 0;
+}
+
+static int matches(const Program *prog, int at, const Pattern *p) {
+    if (at + p->length > prog->codeCount) return 0;
+    for (int k = 0; k < p->length; k++) {
+        if (prog->code[at + k].op != p->ops[k]) return 0;
+    }
+    return 1;
+}
+
+int fuseProgram(Program *prog, const char *profilePath) {
+    Pattern patterns[] = {
+        {OP_CALC3, 3, {OP_CALC, OP_CALC, OP_CALC}, 0},
+        {OP_CALC2, 2, {OP_CALC, OP_CALC}, 0},
+        {OP_CALC_TEST, 2, {OP_CALC, OP_TEST}, 0},
+        {OP_CALC_END, 2, {OP_CALC, OP_END}, 0},
+        {OP_TEST_CALC, 2, {OP_TEST, OP_CALC}, 0},
+    };
+    int patternCount = sizeof(patterns) / sizeof(patterns[0]);
+
+    FILE *f = fopen(profilePath, "r");
+    if (!f) return -1;
+
+    // "<count> <op> <op> [<op>]" per line; # starts a comment
+    char line[256];
+    long long pairs = 0;
+    while (fgets(line, sizeof(line), f)) {
+        char names[3][16];
+        long long count;
+        int fields = sscanf(line, "%lld %15s %15s %15s", &count, names[0], names[1], names[2]);
+        if (fields < 3 || count <= 0) continue;
+
+        int length = fields - 1, ops[3];
+        for (int k = 0; k < length; k++) ops[k] = opByName(names[k]);
+        if (length == 2) pairs += count;
+        for (int p = 0; p < patternCount; p++) {
+            if (patterns[p].length == length && memcmp(patterns[p].ops, ops, length * sizeof(int)) == 0) {
+                patterns[p].count += count;
+            }
+        }
+    }
+    fclose(f);
+
+    int enabled = 0;
+    for (int p = 0; p < patternCount; p++) {
+        if (patterns[p].count > 0 && patterns[p].count * 100 >= pairs) patterns[enabled++] = patterns[p];
+    }
+    qsort(patterns, enabled, sizeof(Pattern), compareSavings);
+
+    int fused = 0;
+    for (int i = 0; i < prog->codeCount; i++) {
+        for (int p = 0; p < enabled; p++) {
+            if (!matches(prog, i, &patterns[p])) continue;
+            prog->code[i].op = patterns[p].op;
+            i += patterns[p].length - 1;
+            fused++;
+            break;
+        }
+    }
+    return fused;
+}
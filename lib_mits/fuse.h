@@ -0,0 +1,15 @@
+#ifndef FUSE_H
+#define FUSE_H
+
+#include "decode.h"
+
+// Superinstructions (mits-compiler -profile). The profile is the file
+// written by mits-interp --profile-ops for a module built without one.
+// Each fused sequence (calc2, calc3, calc_test, calc_end, test_calc) is
+// used when its sequence makes up at least 1% of the profiled pairs;
+// the ones saving the most dispatches win where they overlap. Returns
+// the number of superinstructions made, or -1 if the profile cannot be
+// read.
+int fuseProgram(Program *prog, const char *profilePath);
+
+#endif // FUSE_H
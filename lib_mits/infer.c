@@ -0,0 +1,123 @@
+#include "infer.h"
+#include <string.h>
+
+int operandType(const unsigned char *types, const Operand *op) {
+    // Only register operands and conversions read a register
+    int readsRegister = op->kind == OPD_REGISTER || (op->kind >= OPD_HEX && op->kind <= OPD_FLT);
+    int source = readsRegister && op->ref >= 0 ? types[op->ref] : 0;
+    switch (op->kind) {
+    case OPD_REGISTER: return source ? source : T_NUMBER;
+    case OPD_ROM: return T_ANY;
+    case OPD_HEX: return T_HEX;
+    case OPD_B31: return T_STRING;
+    case OPD_C26: return T_STRING | (source & T_VECTOR);
+    case OPD_FLT:
+    case OPD_FLOAT: return T_FLOAT;
+    case OPD_UTF: return T_STRING | (source & ~T_HEX);
+    default: return T_NUMBER;
+    }
+}
+
+// Could this operand be a hex value at run time
+static int mayBeHex(const unsigned char *types, const Operand *op) {
+    return (operandType(types, op) & T_HEX) != 0;
+}
+
+// Arithmetic on operands first..argc-1 gives a float if any input may be one
+static int arithmeticType(const Program *prog, const unsigned char *types, const Instr *in, int first) {
+    for (int k = first; k < in->argc; k++) {
+        const Operand *op = operandAt(prog, in, k);
+        if (op->kind < OPD_ADD && (operandType(types, op) & T_FLOAT)) return T_NUMBER | T_FLOAT;
+    }
+    return T_NUMBER;
+}
+
+// What a vec operation stores: an element, a count or a vector
+static int vecType(int mode) {
+    switch (mode) {
+    case VEC_DOT:
+    case VEC_SUM:
+    case VEC_MIN:
+    case VEC_MAX:
+    case VEC_GET:
+        return T_NUMBER | T_FLOAT;
+    case VEC_LEN:
+        return T_NUMBER;
+    default:
+        return T_VECTOR;
+    }
+}
+
+// What a buf operation stores: a number for cmp, find, count and len, else
+// bytes
+static int bufType(int mode) {
+    return mode == BUF_CMP || mode == BUF_FIND || mode == BUF_COUNT || mode == BUF_LEN ? T_NUMBER : T_HEX;
+}
+
+// What a str operation stores: a length for len, else a text
+static int strType(int mode) {
+    return mode == STR_LEN ? T_NUMBER : T_TEXT;
+}
+
+void inferTypes(const Program *prog, int first, unsigned char *types) {
+    memset(types, 0, prog->nameCount);
+    for (int i = first; i < prog->codeCount; i++) {
+        if (prog->code[i].op == OP_REQ) {
+            memset(types, T_ANY, prog->nameCount);
+            return;
+        }
+    }
+
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+        for (int i = first; i < prog->codeCount; i++) {
+            const Instr *in = &prog->code[i];
+            const Operand *args = in->argc ? operandAt(prog, in, 0) : NULL;
+            int type = T_NUMBER;
+
+            switch (baseOp(in)) {
+            case OP_MOV:
+                type = operandType(types, &args[0]);
+                break;
+            case OP_RDL:
+                type = in->mode == RDL_INT ? T_NUMBER : in->mode == RDL_FLOAT ? T_FLOAT : T_STRING;
+                break;
+            case OP_CHAR:
+                type = T_STRING;
+                break;
+            case OP_ADDR:
+                type = arithmeticType(prog, types, in, in->mode == ADDR_CONCAT ? 2 : 0);
+                if (in->mode == ADDR_CONCAT && mayBeHex(types, &args[0]) && mayBeHex(types, &args[1])) type |= T_HEX;
+                break;
+            case OP_SUBR:
+            case OP_MUL:
+            case OP_DIV:
+            case OP_MOD:
+                type = arithmeticType(prog, types, in, 0);
+                break;
+            case OP_SDA:
+            case OP_CALC:
+                break;
+            case OP_VEC:
+                type = vecType(in->mode);
+                break;
+            case OP_BUF:
+                type = bufType(in->mode);
+                break;
+            case OP_STR:
+                type = strType(in->mode);
+                break;
+            case OP_FOR:
+                if (in->mode != FOR_OK) continue;
+                break;
+            default:
+                continue;
+            }
+            if (in->dest >= 0 && (types[in->dest] | type) != types[in->dest]) {
+                types[in->dest] |= type;
+                changed = 1;
+            }
+        }
+    }
+}
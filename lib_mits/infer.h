@@ -0,0 +1,24 @@
+#ifndef INFER_H
+#define INFER_H
+
+#include "decode.h"
+
+// Register type bits found by inference. An undefined register reads as a
+// number, so a register never stored has type 0 and counts as a number.
+#define T_NUMBER 1
+#define T_STRING 2
+#define T_HEX 4
+#define T_FLOAT 8
+#define T_VECTOR 16
+#define T_TEXT 32
+#define T_ANY (T_NUMBER | T_STRING | T_HEX | T_FLOAT | T_VECTOR | T_TEXT)
+
+// Type of the value an operand produces, given the current register types
+int operandType(const unsigned char *types, const Operand *op);
+
+// Fill types (one entry per register slot) with every type each register
+// can hold once instructions first..codeCount-1 have run. A program with
+// req can store anything anywhere, so every register gets T_ANY.
+void inferTypes(const Program *prog, int first, unsigned char *types);
+
+#endif // INFER_H
@@ -0,0 +1,557 @@
+#include "optimize.h"
+#include "infer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Every jump in a decoded program lands just after a block instruction,
+// so a run of non-block instructions always executes from its first
+// instruction to its last. Each run gets a stamp, which dead-store
+// elimination and the register-table checks rely on. Constants are
+// tracked across blocks instead: a register a block never stores keeps
+// its value through the block, including every iteration of a for.
+typedef struct {
+    Program *prog;
+    int stamp;
+    char *known;            // register holds constValue here
+    long long *constValue;
+    int *storeStamp;        // run in which the register was last stored
+    char *topStored;        // stored by top-level code after _start
+    char *inDef;            // instruction sits inside a def body
+    int tableSafe;          // every register fits in the interpreter's table
+} Optimizer;
+
+// Instructions that always store their destination and nothing else
+static int isStore(const Instr *in) {
+    switch (in->op) {
+    case OP_MOV:
+    case OP_CHAR:
+    case OP_ADDR:
+    case OP_SUBR:
+    case OP_MUL:
+    case OP_DIV:
+    case OP_MOD:
+    case OP_SDA:
+    case OP_CALC:
+    case OP_VEC:
+    case OP_BUF:
+    case OP_STR:
+        return in->dest >= 0;
+    default:
+        return 0;
+    }
+}
+
+// Instructions that never jump, stop the program or touch registers they
+// do not name; anything else ends a straight-line run
+static int isStraight(const Instr *in) {
+    return isStore(in) || in->op == OP_NOP || in->op == OP_INVALID || in->op == OP_VGA || in->op == OP_RDL;
+}
+
+static int readsSlot(const Operand *op) {
+    return op->ref >= 0 && op->kind != OPD_ROM && op->kind != OPD_TEXT;
+}
+
+static int readsRegister(const Program *prog, const Instr *in, int slot) {
+    for (int k = 0; k < in->argc; k++) {
+        const Operand *op = operandAt(prog, in, k);
+        if (readsSlot(op) && op->ref == slot) return 1;
+    }
+    return 0;
+}
+
+// Same arithmetic as the interpreter: wrapping, and x / 0 == x % 0 == 0
+static long long foldOperator(int kind, long long l, long long r) {
+    switch (kind) {
+    case OPD_ADD: return (long long)((unsigned long long)l + (unsigned long long)r);
+    case OPD_SUB: return (long long)((unsigned long long)l - (unsigned long long)r);
+    case OPD_MUL: return (long long)((unsigned long long)l * (unsigned long long)r);
+    case OPD_DIV:
+        if (r == 0) return 0;
+        if (r == -1) return (long long)(0ULL - (unsigned long long)l);
+        return l / r;
+    case OPD_MOD:
+        if (r == 0 || r == -1) return 0;
+        return l % r;
+    }
+    return 0;
+}
+
+static int isDefined(const Optimizer *opt, int index, int slot) {
+    return opt->storeStamp[slot] == opt->stamp || (!opt->inDef[index] && opt->topStored[slot]);
+}
+
+static int knownConstant(const Optimizer *opt, int slot, long long *value) {
+    if (!opt->known[slot]) return 0;
+    *value = opt->constValue[slot];
+    return 1;
+}
+
+static void setNumber(Operand *op, long long value) {
+    op->kind = OPD_NUMBER;
+    op->ref = -1;
+    op->num = value;
+}
+
+static void forgetAll(Optimizer *opt) {
+    memset(opt->known, 0, opt->prog->nameCount + 1);
+}
+
+// Forget every register instructions first..last may store. Calls,
+// execs, imports and the host hooks can store anything.
+static void forgetStores(Optimizer *opt, int first, int last) {
+    const Program *prog = opt->prog;
+    if (last >= prog->codeCount) last = prog->codeCount - 1;
+    for (int j = first; j <= last; j++) {
+        const Instr *in = &prog->code[j];
+        switch (in->op) {
+        case OP_CALL:
+        case OP_EXEC:
+        case OP_REQ:
+        case OP_READ:
+        case OP_WASM:
+            forgetAll(opt);
+            return;
+        case OP_RDL:
+        case OP_FOR:
+            if (in->dest >= 0) opt->known[in->dest] = 0;
+            break;
+        default:
+            if (isStore(in)) opt->known[in->dest] = 0;
+            break;
+        }
+    }
+}
+
+// Leaving a block for the instruction at index: only what held on entry
+// and survives the whole block is still known
+static void leaveBlock(Optimizer *opt, int header) {
+    const Instr *head = &opt->prog->code[header];
+    forgetStores(opt, header + 1, head->target - 1);
+    if (head->op == OP_FOR && head->dest >= 0) opt->known[head->dest] = 0;
+}
+
+// Replace reads of registers holding known constants with the constants
+static void propagate(Optimizer *opt, Instr *in) {
+    for (int k = in->op == OP_CALL ? 1 : 0; k < in->argc; k++) {
+        Operand *op = operandAt(opt->prog, in, k);
+        long long value;
+        if (op->kind == OPD_REGISTER && knownConstant(opt, op->ref, &value)) setNumber(op, value);
+    }
+}
+
+// Fold constant subexpressions of the postfix expression in operands
+// first..argc-1, shrinking it in place. Returns 1 and the value if the
+// whole expression is constant.
+static int foldExpression(Program *prog, Instr *in, int first, long long *value) {
+    typedef struct {
+        int start;          // output position of the subexpression
+        int constant;
+        long long value;
+    } Entry;
+
+    Operand *ops = operandAt(prog, in, first);
+    int count = in->argc - first;
+    if (count <= 0) return 0;
+    Entry *stack = malloc(count * sizeof(Entry));
+    if (!stack) return 0;
+
+    int top = 0, out = 0;
+    for (int i = 0; i < count; i++) {
+        Operand op = ops[i];
+        if (op.kind == OPD_NEG) {
+            Entry *e = &stack[top - 1];
+            if (e->constant) {
+                e->value = (long long)(0ULL - (unsigned long long)e->value);
+                setNumber(&ops[e->start], e->value);
+            } else {
+                ops[out++] = op;
+            }
+        } else if (op.kind >= OPD_ADD) {
+            Entry right = stack[--top];
+            Entry *left = &stack[top - 1];
+            if (left->constant && right.constant) {
+                left->value = foldOperator(op.kind, left->value, right.value);
+                out = left->start;
+                setNumber(&ops[out++], left->value);
+            } else {
+                ops[out++] = op;
+                left->constant = 0;
+            }
+        } else {
+            stack[top].start = out;
+            stack[top].constant = op.kind == OPD_NUMBER;
+            stack[top].value = op.num;
+            top++;
+            ops[out++] = op;
+        }
+    }
+
+    in->argc = first + out;
+    int constant = stack[0].constant;
+    *value = stack[0].value;
+    free(stack);
+    return constant;
+}
+
+// Could this addr half be hex at run time
+static int mayBeHex(const Operand *op) {
+    return op->kind == OPD_HEX || op->kind == OPD_REGISTER || op->kind == OPD_ROM;
+}
+
+static void makeMov(Instr *in, int operand) {
+    in->op = OP_MOV;
+    in->mode = 0;
+    in->args += operand;
+    in->argc = 1;
+}
+
+// Simplify one instruction; returns 1 and the stored value if it stores a
+// known constant
+static int simplify(Program *prog, Instr *in, long long *value) {
+    switch (in->op) {
+    case OP_MOV:
+        if (operandAt(prog, in, 0)->kind != OPD_NUMBER) return 0;
+        *value = operandAt(prog, in, 0)->num;
+        return 1;
+
+    case OP_ADDR:
+        // Hex concatenation needs both halves to be hex
+        if (in->mode == ADDR_CONCAT &&
+            (!mayBeHex(operandAt(prog, in, 0)) || !mayBeHex(operandAt(prog, in, 1)))) {
+            in->mode = ADDR_NUMERIC;
+            in->args += 2;
+            in->argc -= 2;
+        }
+        if (in->mode == ADDR_CONCAT) {
+            foldExpression(prog, in, 2, value);
+            return 0;
+        }
+        // fall through
+    case OP_SUBR:
+    case OP_MUL:
+    case OP_DIV:
+    case OP_MOD:
+        if (!foldExpression(prog, in, 0, value)) return 0;
+        makeMov(in, 0);
+        return 1;
+
+    case OP_SDA: {
+        if (in->mode != SDA_LIST || in->argc == 0) return 0;
+        // Addition wraps, so the constants can be summed into one operand
+        Operand *ops = operandAt(prog, in, 0);
+        unsigned long long sum = 0;
+        int kept = 0;
+        for (int k = 0; k < in->argc; k++) {
+            if (ops[k].kind == OPD_NUMBER) sum += (unsigned long long)ops[k].num;
+            else ops[kept++] = ops[k];
+        }
+        if (kept == 0) {
+            setNumber(&ops[0], (long long)sum);
+            makeMov(in, 0);
+            *value = (long long)sum;
+            return 1;
+        }
+        if (sum != 0) setNumber(&ops[kept++], (long long)sum);
+        in->argc = kept;
+        return 0;
+    }
+
+    default:
+        return 0;
+    }
+}
+
+// Forward pass: constant propagation and folding
+static void foldConstants(Optimizer *opt, int start) {
+    Program *prog = opt->prog;
+    for (int i = 0; i < prog->codeCount; i++) {
+        Instr *in = &prog->code[i];
+        // Code above _start: only runs when called
+        if (i == start) {
+            opt->stamp++;
+            forgetAll(opt);
+        }
+
+        // Block headers and calls read their operands before they jump
+        propagate(opt, in);
+        if (!isStraight(in)) {
+            opt->stamp++;
+            switch (in->op) {
+            case OP_FOR:
+                // The body also runs after earlier iterations
+                leaveBlock(opt, i);
+                break;
+            case OP_ELSE:
+                if (in->alt >= 0) leaveBlock(opt, in->alt);
+                break;
+            case OP_END:
+                if (in->target >= 0) leaveBlock(opt, in->target);
+                break;
+            case OP_COND:
+            case OP_TEST:
+                break;
+            default:
+                // A def body runs from its callers, and an exec left
+                // unresolved may call a def a req brings in
+                forgetAll(opt);
+                break;
+            }
+            continue;
+        }
+        if (in->op == OP_RDL) {
+            opt->known[in->dest] = 0;
+            continue;
+        }
+        if (!isStore(in)) continue;
+
+        long long value;
+        int constant = simplify(prog, in, &value);
+        int slot = in->dest;
+        opt->known[slot] = 0;
+        // A store that finds the register table full is dropped
+        if (constant && (opt->tableSafe || isDefined(opt, i, slot))) {
+            opt->known[slot] = 1;
+            opt->constValue[slot] = value;
+        }
+        opt->storeStamp[slot] = opt->stamp;
+        if (in->depth == 0 && !opt->inDef[i] && i >= start) opt->topStored[slot] = 1;
+    }
+}
+
+// Is the store at index overwritten before anything can read it. Dropping
+// it must not change the order in which registers are first defined, so
+// another register may only be stored in between when this one already
+// exists.
+static int isDeadStore(const Optimizer *opt, int index) {
+    const Program *prog = opt->prog;
+    const Instr *store = &prog->code[index];
+    int slot = store->dest;
+    int otherStores = 0;
+
+    for (int j = index + 1; j < prog->codeCount; j++) {
+        const Instr *in = &prog->code[j];
+        if (!isStraight(in) || readsRegister(prog, in, slot)) return 0;
+        if (in->op == OP_RDL) {
+            if (in->dest == slot) return 0;
+            otherStores = 1;
+        } else if (isStore(in)) {
+            if (in->dest == slot) return !otherStores || isDefined(opt, index, slot);
+            otherStores = 1;
+        }
+    }
+    return 0;
+}
+
+// Forward pass: dead-store elimination
+static void removeDeadStores(Optimizer *opt, int start) {
+    Program *prog = opt->prog;
+    opt->stamp++;
+    memset(opt->topStored, 0, prog->nameCount + 1);
+
+    for (int i = 0; i < prog->codeCount; i++) {
+        Instr *in = &prog->code[i];
+        if (i == start) opt->stamp++;
+        if (!isStraight(in)) {
+            opt->stamp++;
+            continue;
+        }
+        if (!isStore(in)) continue;
+
+        if (isDeadStore(opt, i)) {
+            in->op = OP_NOP;
+            in->mode = 0;
+            in->argc = 0;
+            in->dest = -1;
+            continue;
+        }
+        opt->storeStamp[in->dest] = opt->stamp;
+        if (in->depth == 0 && !opt->inDef[i] && i >= start) opt->topStored[in->dest] = 1;
+    }
+}
+
+static int isNumeric(const unsigned char *types, const Operand *op) {
+    return op->kind == OPD_NUMBER || (op->kind == OPD_REGISTER && (types[op->ref] & ~T_NUMBER) == 0);
+}
+
+// Postfix expression over number literals and number registers only
+static int isNumericExpression(const Program *prog, const unsigned char *types, const Instr *in) {
+    if (in->argc == 0) return 0;
+    for (int k = 0; k < in->argc; k++) {
+        const Operand *op = operandAt(prog, in, k);
+        if (op->kind < OPD_ADD && !isNumeric(types, op)) return 0;
+    }
+    return 1;
+}
+
+// Last pass: rewrite instructions whose operands are always numbers into
+// OP_CALC and OP_TEST, which skip the interpreter's type checks
+static void specializeTypes(Optimizer *opt) {
+    Program *prog = opt->prog;
+    unsigned char *types = malloc(prog->nameCount + 1);
+    if (!types) return;
+    inferTypes(prog, 0, types);
+
+    for (int i = 0; i < prog->codeCount; i++) {
+        Instr *in = &prog->code[i];
+        switch (in->op) {
+        case OP_ADDR:
+            if (in->mode == ADDR_CONCAT &&
+                (!(operandType(types, operandAt(prog, in, 0)) & T_HEX) ||
+                 !(operandType(types, operandAt(prog, in, 1)) & T_HEX))) {
+                in->mode = ADDR_NUMERIC;
+                in->args += 2;
+                in->argc -= 2;
+            }
+            if (in->mode == ADDR_CONCAT) break;
+            // fall through
+        case OP_MOV:
+        case OP_SUBR:
+        case OP_MUL:
+        case OP_DIV:
+        case OP_MOD:
+            if (in->dest < 0 || (types[in->dest] & ~T_NUMBER) != 0) break;
+            if (in->op == OP_MOV && in->argc != 1) break;
+            if (!isNumericExpression(prog, types, in)) break;
+            in->op = OP_CALC;
+            in->mode = 0;
+            break;
+
+        case OP_COND:
+            if (in->mode == CMP_NONE || in->mode == CMP_MALFORMED || in->argc != 2) break;
+            if (!isNumeric(types, operandAt(prog, in, 0)) || !isNumeric(types, operandAt(prog, in, 1))) break;
+            in->op = OP_TEST;
+            break;
+
+        default:
+            break;
+        }
+    }
+    free(types);
+}
+
+// Registers a pure def may read: its own top-level stores so far, or for a
+// def declared pure anything the caller set
+static int readsDefined(const Program *prog, const Instr *in, const char *defined, int declared) {
+    for (int k = 0; k < in->argc; k++) {
+        const Operand *op = operandAt(prog, in, k);
+        if (op->kind == OPD_REGISTER) {
+            if (!declared && !defined[op->ref]) return 0;
+        } else if (op->kind != OPD_NUMBER && op->kind != OPD_ARGUMENTS && op->kind < OPD_ADD) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// A def whose calls leave the same registers behind for the same
+// ARGUMENTS: it only computes, every register it stores is stored by its
+// top-level code before anything else touches it, so every call stores
+// all of them, and it reads nothing else (unless declared pure)
+static int isPureDef(const Program *prog, int def, char *defined) {
+    const Instr *head = &prog->code[def];
+    int declared = (head->mode & DEF_PURE) != 0;
+    if (head->dest < 0 || head->target >= prog->codeCount) return 0;
+    memset(defined, 0, prog->nameCount + 1);
+
+    for (int i = def + 1; i < head->target; i++) {
+        const Instr *in = &prog->code[i];
+        int topLevel = in->depth == head->depth + 1;
+        switch (baseOp(in)) {
+        case OP_NOP:
+        case OP_ELSE:
+        case OP_END:
+            break;
+        case OP_MOV:
+            if (in->argc != 1) return 0;
+            // fall through
+        case OP_ADDR:
+        case OP_SUBR:
+        case OP_MUL:
+        case OP_DIV:
+        case OP_MOD:
+        case OP_SDA:
+        case OP_CALC:
+            if (in->dest < 0 || !readsDefined(prog, in, defined, declared)) return 0;
+            if (!defined[in->dest] && !topLevel) return 0;
+            defined[in->dest] = 1;
+            break;
+        case OP_FOR: {
+            // The index is only stored if the loop runs
+            const Operand *from = operandAt(prog, in, 0), *to = operandAt(prog, in, 1);
+            if (in->mode != FOR_OK || !readsDefined(prog, in, defined, declared)) return 0;
+            if (!defined[in->dest]) {
+                if (!topLevel || from->kind != OPD_NUMBER || to->kind != OPD_NUMBER || from->num > to->num) return 0;
+                defined[in->dest] = 1;
+            }
+            break;
+        }
+        case OP_COND:
+        case OP_TEST:
+            if (in->mode == CMP_NONE || in->mode == CMP_MALFORMED || in->argc != 2) return 0;
+            if (!readsDefined(prog, in, defined, declared)) return 0;
+            break;
+        default:
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Mark defs whose calls the interpreter may memoize with DEF_MEMO
+static void markPureDefs(Optimizer *opt) {
+    Program *prog = opt->prog;
+    char *defined = malloc(prog->nameCount + 1);
+    if (!defined) return;
+
+    for (int i = 0; i < prog->codeCount; i++) {
+        Instr *in = &prog->code[i];
+        if (in->op != OP_DEF) continue;
+        if (isPureDef(prog, i, defined)) {
+            in->mode |= DEF_MEMO;
+        } else if (in->mode & DEF_PURE) {
+            fprintf(stderr, "Warning: def on line %d is declared pure but has side effects or stores "
+                    "registers only some calls reach; its calls are not memoized\n", in->line);
+        }
+    }
+    free(defined);
+}
+
+void optimizeProgram(Program *prog, int start) {
+    Optimizer opt;
+    memset(&opt, 0, sizeof(opt));
+    opt.prog = prog;
+    opt.stamp = 1;
+    opt.known = calloc(prog->nameCount + 1, 1);
+    opt.constValue = calloc(prog->nameCount + 1, sizeof(long long));
+    opt.storeStamp = calloc(prog->nameCount + 1, sizeof(int));
+    opt.topStored = calloc(prog->nameCount + 1, 1);
+    opt.inDef = calloc(prog->codeCount + 1, 1);
+    if (!opt.known || !opt.constValue || !opt.storeStamp || !opt.topStored || !opt.inDef) {
+        fprintf(stderr, "Error: Out of memory while optimizing\n");
+        exit(1);
+    }
+
+    // Imported files bring registers of their own, so with req anywhere
+    // the table could fill up even if this program alone fits
+    opt.tableSafe = prog->nameCount <= OPTIMIZE_REGISTER_LIMIT;
+    for (int i = 0; i < prog->codeCount; i++) {
+        const Instr *in = &prog->code[i];
+        if (in->op == OP_REQ) opt.tableSafe = 0;
+        if (in->op == OP_DEF) {
+            int end = in->target < prog->codeCount ? in->target : prog->codeCount - 1;
+            for (int j = i + 1; j <= end; j++) opt.inDef[j] = 1;
+        }
+    }
+
+    foldConstants(&opt, start);
+    removeDeadStores(&opt, start);
+    specializeTypes(&opt);
+    markPureDefs(&opt);
+
+    free(opt.known);
+    free(opt.constValue);
+    free(opt.storeStamp);
+    free(opt.topStored);
+    free(opt.inDef);
+}
@@ -0,0 +1,29 @@
+#ifndef OPTIMIZE_H
+#define OPTIMIZE_H
+
+#include "decode.h"
+
+// Registers the interpreter can hold at once. Past this, new registers are
+// dropped, so a store may not define its register; the optimizer only
+// trusts a store it cannot prove will land when the program stays below it.
+#define OPTIMIZE_REGISTER_LIMIT 256
+
+// Rewrite a block-resolved program in place without changing what it
+// does (mits-compiler runs this unless given -O0):
+//  - constants stored by mov and arithmetic replace later register reads,
+//    across blocks when the block never stores the register, so values
+//    a loop body only reads are resolved once at compile time
+//  - arithmetic on constants is folded, and fully constant addr, subr,
+//    mul, div, mod and sda become mov
+//  - a store overwritten before anything can read it becomes a no-op
+//  - with register types inferred program-wide, stores and conds that
+//    only ever see numbers become OP_CALC and OP_TEST, and addr drops
+//    hex concatenation when a half can never be hex
+//  - defs whose calls only compute from ARGUMENTS and the registers the
+//    body stores itself (or that are declared pure) get DEF_MEMO, and
+//    the interpreter caches their results by ARGUMENTS
+// Instructions are never added or removed, so line numbers stay put.
+// start is the first instruction after _start:.
+void optimizeProgram(Program *prog, int start);
+
+#endif // OPTIMIZE_H
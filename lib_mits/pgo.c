@@ -0,0 +1,166 @@
+#include "pgo.h"
+#include "infer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    long long *counts;
+    long long *taken;
+    unsigned char *types;
+} Profile;
+
+// Read "index line count taken types" lines; 0 if the profile belongs to
+// another program
+static int readProfile(const Program *prog, FILE *f, Profile *p) {
+    char line[256];
+    while (fgets(line, sizeof(line), f)) {
+        int index, lineNo, types;
+        long long count, taken;
+        if (line[0] == '#') continue;
+        if (sscanf(line, "%d %d %lld %lld %d", &index, &lineNo, &count, &taken, &types) != 5) return 0;
+        if (index < 0 || index >= prog->codeCount || prog->code[index].line != lineNo) return 0;
+        p->counts[index] = count;
+        p->taken[index] = taken;
+        p->types[index] = types;
+    }
+    return 1;
+}
+
+// Operands the guarded forms can read without evalOperand
+static int plainOperands(const Program *prog, const Instr *in) {
+    if (in->argc == 0) return 0;
+    for (int k = 0; k < in->argc; k++) {
+        const Operand *op = operandAt(prog, in, k);
+        if (op->kind < OPD_ADD && op->kind != OPD_NUMBER && op->kind != OPD_REGISTER) return 0;
+    }
+    return 1;
+}
+
+static void guardNumbers(Program *prog, Instr *in) {
+    switch (in->op) {
+    case OP_MOV:
+        if (in->argc != 1) return;
+        // fall through
+    case OP_ADDR:
+    case OP_SUBR:
+    case OP_MUL:
+    case OP_DIV:
+    case OP_MOD:
+        if (in->dest < 0 || !plainOperands(prog, in)) return;
+        in->target = in->op;
+        in->op = OP_GCALC;
+        break;
+    case OP_COND:
+        if (in->mode == CMP_NONE || in->mode == CMP_MALFORMED || in->argc != 2) return;
+        if (!plainOperands(prog, in)) return;
+        in->op = OP_GTEST;
+        break;
+    default:
+        break;
+    }
+}
+
+static int invertComparison(int mode) {
+    switch (mode) {
+    case CMP_LT: return CMP_GE;
+    case CMP_GT: return CMP_LE;
+    case CMP_LE: return CMP_GT;
+    case CMP_GE: return CMP_LT;
+    case CMP_EQ: return CMP_NE;
+    default: return CMP_EQ;
+    }
+}
+
+// Block links that name an instruction index
+static int linksIndex(const Instr *in) {
+    return in->op != OP_GCALC;
+}
+
+// Swap the branches of the cond at c: cond [then] else [other] end becomes
+// cond' [other] else [then] end. where maps original indices to current ones.
+static void swapBranches(Program *prog, int c, int *where, int originalCount) {
+    Instr *head = &prog->code[c];
+    int e = head->alt, n = head->target;
+    int span = n - c + 1;
+    int *perm = malloc(span * sizeof(int));
+    Instr *moved = malloc(span * sizeof(Instr));
+    if (!perm || !moved) {
+        free(perm);
+        free(moved);
+        return;
+    }
+
+    int newElse = c + (n - e);
+    for (int i = c; i <= n; i++) {
+        int to = i;
+        if (i > c && i < e) to = newElse + (i - c);
+        else if (i == e) to = newElse;
+        else if (i > e && i < n) to = c + (i - e);
+        perm[i - c] = to;
+        moved[to - c] = prog->code[i];
+    }
+    memcpy(&prog->code[c], moved, span * sizeof(Instr));
+
+    for (int i = 0; i < prog->codeCount; i++) {
+        Instr *in = &prog->code[i];
+        if (!linksIndex(in)) continue;
+        if (in->target >= c && in->target <= n) in->target = perm[in->target - c];
+        if (in->alt >= c && in->alt <= n) in->alt = perm[in->alt - c];
+    }
+    for (int i = 0; i < originalCount; i++) {
+        if (where[i] >= c && where[i] <= n) where[i] = perm[where[i] - c];
+    }
+    prog->code[c].mode = invertComparison(prog->code[c].mode);
+
+    free(perm);
+    free(moved);
+}
+
+int applyProfile(Program *prog, int start, const char *profilePath) {
+    FILE *f = fopen(profilePath, "r");
+    if (!f) return -1;
+
+    int count = prog->codeCount;
+    Profile p;
+    p.counts = calloc(count + 1, sizeof(long long));
+    p.taken = calloc(count + 1, sizeof(long long));
+    p.types = calloc(count + 1, 1);
+    int *where = malloc((count + 1) * sizeof(int));
+    if (!p.counts || !p.taken || !p.types || !where) {
+        fprintf(stderr, "Error: Out of memory while reading the profile\n");
+        exit(1);
+    }
+
+    if (!readProfile(prog, f, &p)) {
+        fprintf(stderr, "Warning: Profile '%s' does not match this program, ignoring it\n", profilePath);
+    } else {
+        long long hottest = 0;
+        for (int i = 0; i < count; i++) {
+            if (p.counts[i] > hottest) hottest = p.counts[i];
+        }
+
+        for (int i = 0; i < count; i++) {
+            int hot = p.counts[i] > 0 && p.counts[i] * 100 >= hottest;
+            if (hot && p.types[i] == T_NUMBER) guardNumbers(prog, &prog->code[i]);
+        }
+
+        // Outer conds first; where keeps track of instructions already moved
+        for (int i = 0; i < count; i++) where[i] = i;
+        for (int i = 0; i < count; i++) {
+            int c = where[i];
+            const Instr *in = &prog->code[c];
+            int hot = p.counts[i] > 0 && p.counts[i] * 100 >= hottest;
+            if (!hot || in->op != OP_TEST || in->alt < 0 || in->target >= prog->codeCount) continue;
+            if (start > c && start <= in->target) continue;
+            if (p.taken[i] * 2 < p.counts[i]) swapBranches(prog, c, where, count);
+        }
+    }
+
+    fclose(f);
+    free(p.counts);
+    free(p.taken);
+    free(p.types);
+    free(where);
+    return 0;
+}
@@ -0,0 +1,21 @@
+#ifndef PGO_H
+#define PGO_H
+
+#include "decode.h"
+
+// Profile-guided optimization (mits-compiler --use-profile). The profile
+// is written by mits-interp --write-profile for the same source; the
+// optimizer never adds or removes instructions, so a text run and a
+// module run give the same instruction indices. Hot instructions (at
+// least 1% of the hottest one's count) are rewritten as follows:
+//  - mov and arithmetic that only met numbers become OP_GCALC, and conds
+//    that only compared numbers become OP_GTEST. Both check the types at
+//    run time and fall back to the generic instruction.
+//  - a number-only cond with an else whose else-branch ran more often is
+//    inverted and its branches swapped, so the likely branch falls through
+// Every rewrite keeps the program's behaviour, so a stale profile can only
+// cost speed; one naming instructions the program does not have is
+// ignored with a warning. Returns -1 if the profile cannot be read.
+int applyProfile(Program *prog, int start, const char *profilePath);
+
+#endif // PGO_H
@@ -0,0 +1,997 @@
+#include "translate.h"
+#include "infer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <limits.h>
+
+// Runtime emitted at the top of every translated program. It mirrors the
+// interpreter: numbers wrap, div/mod by zero give 0, strings hold up to
+// 511 bytes and hex values are unbounded. Hex values longer than the inline
+// buffer live in a counted block; stores into a register go through mv_set
+// so the block it held is freed once nothing holds it.
+static const char *prelude =
+    "#include <limits.h>\n"
+    "#include <math.h>\n"
+    "#include <stdio.h>\n"
+    "#include <stdlib.h>\n"
+    "#include <string.h>\n"
+    "\n"
+    "enum { MV_UNDEF, MV_NUMBER, MV_STRING, MV_HEX, MV_FLOAT };\n"
+    "\n"
+    "typedef struct {\n"
+    "    long long refs;\n"
+    "    unsigned char bytes[];\n"
+    "} mv_block;\n"
+    "\n"
+    "typedef struct {\n"
+    "    int type;\n"
+    "    long long len;\n"
+    "    long long num;\n"
+    "    double flt;\n"
+    "    mv_block *block;\n"
+    "    unsigned char bytes[512];\n"
+    "} mv;\n"
+    "\n"
+    "static const mv mits_undef;\n"
+    "\n"
+    "static long long mits_add(long long a, long long b) { return (long long)((unsigned long long)a + (unsigned long long)b); }\n"
+    "static long long mits_sub(long long a, long long b) { return (long long)((unsigned long long)a - (unsigned long long)b); }\n"
+    "static long long mits_mul(long long a, long long b) { return (long long)((unsigned long long)a * (unsigned long long)b); }\n"
+    "static long long mits_div(long long a, long long b) { return b == 0 ? 0 : b == -1 ? mits_sub(0, a) : a / b; }\n"
+    "static long long mits_mod(long long a, long long b) { return b == 0 || b == -1 ? 0 : a % b; }\n"
+    "\n"
+    "// A float truncated toward zero, saturating at the ends of the range\n"
+    "static long long mits_trunc(double num) {\n"
+    "    if (num != num) return 0;\n"
+    "    if (num <= -9223372036854775808.0) return LLONG_MIN;\n"
+    "    if (num >= 9223372036854775808.0) return LLONG_MAX;\n"
+    "    return (long long)num;\n"
+    "}\n"
+    "\n"
+    "static mv mv_number(long long num) {\n"
+    "    mv v;\n"
+    "    v.type = MV_NUMBER;\n"
+    "    v.len = 0;\n"
+    "    v.num = num;\n"
+    "    v.block = NULL;\n"
+    "    v.bytes[0] = 0;\n"
+    "    return v;\n"
+    "}\n"
+    "\n"
+    "// A value of len bytes, yet to be filled in, kept in a block when they\n"
+    "// do not fit the inline buffer\n"
+    "static mv mv_sized(int type, long long len) {\n"
+    "    mv v = mv_number(0);\n"
+    "    v.type = type;\n"
+    "    v.len = len;\n"
+    "    if (len < (long long)sizeof(v.bytes)) {\n"
+    "        v.bytes[len] = 0;\n"
+    "        return v;\n"
+    "    }\n"
+    "    v.block = malloc(sizeof(mv_block) + len);\n"
+    "    if (!v.block) {\n"
+    "        fputs(\"Error: Out of memory\\n\", stderr);\n"
+    "        exit(1);\n"
+    "    }\n"
+    "    v.block->refs = 0;\n"
+    "    return v;\n"
+    "}\n"
+    "\n"
+    "// The bytes of a string or hex value\n"
+    "static const unsigned char *mv_data(const mv *r) { return r->block ? r->block->bytes : r->bytes; }\n"
+    "\n"
+    "static mv mv_bytes(int type, const void *bytes, long long len, long long limit) {\n"
+    "    mv v = mv_sized(type, len > limit ? limit : len);\n"
+    "    memcpy((unsigned char *)mv_data(&v), bytes, v.len);\n"
+    "    return v;\n"
+    "}\n"
+    "\n"
+    "// Store v into a register, freeing the block it held if v was the last\n"
+    "// to use it\n"
+    "static void mv_set(mv *r, mv v) {\n"
+    "    if (v.block) v.block->refs++;\n"
+    "    if (r->block && --r->block->refs == 0) free(r->block);\n"
+    "    *r = v;\n"
+    "}\n"
+    "\n"
+    "static mv mv_float(double flt) {\n"
+    "    mv v = mv_number(0);\n"
+    "    v.type = MV_FLOAT;\n"
+    "    v.flt = flt;\n"
+    "    return v;\n"
+    "}\n"
+    "\n"
+    "#define mv_string(s, n) mv_bytes(MV_STRING, s, n, 511)\n"
+    "#define mv_hex(b, n) mv_bytes(MV_HEX, b, n, LLONG_MAX)\n"
+    "\n"
+    "// An undefined register reads as the number 0\n"
+    "static mv mv_get(const mv *r) { return r->type == MV_UNDEF ? mv_number(0) : *r; }\n"
+    "static long long mv_num(const mv *r) {\n"
+    "    return r->type == MV_NUMBER ? r->num : r->type == MV_FLOAT ? mits_trunc(r->flt) : 0;\n"
+    "}\n"
+    "static double mv_dbl(const mv *r) {\n"
+    "    return r->type == MV_NUMBER ? (double)r->num : r->type == MV_FLOAT ? r->flt : 0;\n"
+    "}\n"
+    "\n"
+    "static mv mv_fltnum(long long num) { return mv_float((double)num); }\n"
+    "\n"
+    "static mv mv_hexof(const mv *r) {\n"
+    "    return r->type == MV_STRING ? mv_hex(r->bytes, (int)strlen((const char *)r->bytes)) : mv_hex(\"\", 0);\n"
+    "}\n"
+    "\n"
+    "static mv mv_b31(const mv *r) {\n"
+    "    return r->type == MV_HEX ? mv_string(mv_data(r), r->len) : mv_string(\"\", 0);\n"
+    "}\n"
+    "\n"
+    "static long long mv_b32(const mv *r) {\n"
+    "    long long num = 0;\n"
+    "    if (r->type != MV_HEX) return 0;\n"
+    "    for (int i = 0; i < r->len && i < 8; i++) num = (num << 8) | mv_data(r)[i];\n"
+    "    return num;\n"
+    "}\n"
+    "\n"
+    "static mv mv_c26(const mv *r) {\n"
+    "    char text[32];\n"
+    "    if (r->type == MV_UNDEF) return mv_string(\"\", 0);\n"
+    "    if (r->type == MV_NUMBER) return mv_string(text, snprintf(text, sizeof(text), \"%lld\", r->num));\n"
+    "    if (r->type == MV_FLOAT) return mv_string(text, snprintf(text, sizeof(text), \"%.2f\", r->flt));\n"
+    "    return r->type == MV_HEX ? mv_b31(r) : *r;\n"
+    "}\n"
+    "\n"
+    "static mv mv_utf(const mv *r) {\n"
+    "    if (r->type == MV_UNDEF) return mv_string(\"\", 0);\n"
+    "    return r->type == MV_HEX ? mv_b31(r) : *r;\n"
+    "}\n"
+    "\n"
+    "static mv mv_flt(const mv *r) {\n"
+    "    return r->type == MV_NUMBER || r->type == MV_FLOAT ? mv_float(mv_dbl(r)) : mv_float(0);\n"
+    "}\n"
+    "\n"
+    "static mv mv_concat(const mv *l, const mv *r) {\n"
+    "    mv v = mv_sized(MV_HEX, l->len + r->len);\n"
+    "    unsigned char *bytes = (unsigned char *)mv_data(&v);\n"
+    "    memcpy(bytes, mv_data(l), l->len);\n"
+    "    memcpy(bytes + l->len, mv_data(r), r->len);\n"
+    "    return v;\n"
+    "}\n"
+    "\n"
+    "// Byte order of two strings, using their lengths rather than the NULs\n"
+    "static long long mv_order(const mv *l, const mv *r) {\n"
+    "    int shorter = l->len < r->len ? l->len : r->len;\n"
+    "    int order = memcmp(l->bytes, r->bytes, shorter);\n"
+    "    return order ? order : (l->len > r->len) - (l->len < r->len);\n"
+    "}\n"
+    "\n"
+    "// cond compares numbers and floats, and strings by their bytes\n"
+    "static int mv_compare(const mv *l, const mv *r, int mode) {\n"
+    "    long long a = l->num, b = r->num;\n"
+    "    if (l->type == MV_STRING && r->type == MV_STRING) {\n"
+    "        // Strings of different lengths are never equal\n"
+    "        if (mode >= 5 && l->len != r->len) return mode == 6;\n"
+    "        a = mv_order(l, r);\n"
+    "        b = 0;\n"
+    "    } else if ((l->type == MV_FLOAT || r->type == MV_FLOAT) && (l->type == MV_NUMBER || l->type == MV_FLOAT)\n"
+    "               && (r->type == MV_NUMBER || r->type == MV_FLOAT)) {\n"
+    "        double x = mv_dbl(l), y = mv_dbl(r);\n"
+    "        switch (mode) {\n"
+    "        case 1: return x < y;\n"
+    "        case 2: return x > y;\n"
+    "        case 3: return x <= y;\n"
+    "        case 4: return x >= y;\n"
+    "        case 5: return x == y;\n"
+    "        case 6: return x != y;\n"
+    "        }\n"
+    "        return 0;\n"
+    "    } else if (l->type != MV_NUMBER || r->type != MV_NUMBER) {\n"
+    "        return 0;\n"
+    "    }\n"
+    "    switch (mode) {\n"
+    "    case 1: return a < b;\n"
+    "    case 2: return a > b;\n"
+    "    case 3: return a <= b;\n"
+    "    case 4: return a >= b;\n"
+    "    case 5: return a == b;\n"
+    "    case 6: return a != b;\n"
+    "    }\n"
+    "    return 0;\n"
+    "}\n"
+    "\n"
+    "static void vga_number(long long num) {\n"
+    "    printf(\"%lld\\n\", num);\n"
+    "}\n"
+    "\n"
+    "static void vga_value(mv v) {\n"
+    "    if (v.type == MV_STRING) {\n"
+    "        printf(\"%s\\n\", (const char *)v.bytes);\n"
+    "    } else if (v.type == MV_HEX) {\n"
+    "        for (long long i = 0; i < v.len; i++) {\n"
+    "            printf(\"%02x\", mv_data(&v)[i]);\n"
+    "            if (i < v.len - 1) printf(\" \");\n"
+    "        }\n"
+    "        printf(\"\\n\");\n"
+    "    } else if (v.type == MV_FLOAT) {\n"
+    "        printf(\"%.2f\\n\", v.flt);\n"
+    "    } else {\n"
+    "        vga_number(v.num);\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "static int mits_readline(char *buffer) {\n"
+    "    if (fgets(buffer, 512, stdin) == NULL) return 0;\n"
+    "    int len = strlen(buffer);\n"
+    "    if (len > 0 && buffer[len - 1] == '\\n') buffer[len - 1] = '\\0';\n"
+    "    return 1;\n"
+    "}\n"
+    "\n"
+    "static mv mits_readfloat(const char *buffer) {\n"
+    "    return mv_float(strtod(buffer, NULL));\n"
+    "}\n"
+    "\n"
+    "// A number or float inside an expression that may meet floats\n"
+    "typedef struct {\n"
+    "    int isflt;\n"
+    "    long long num;\n"
+    "    double flt;\n"
+    "} mn;\n"
+    "\n"
+    "static mn mn_int(long long num) { mn v = { 0, num, 0 }; return v; }\n"
+    "static mn mn_flt(double flt) { mn v = { 1, 0, flt }; return v; }\n"
+    "static mn mn_at(const mv *r) { return r->type == MV_FLOAT ? mn_flt(r->flt) : mn_int(r->type == MV_NUMBER ? r->num : 0); }\n"
+    "static mn mn_of(mv v) { return mn_at(&v); }\n"
+    "static mn mn_neg(mn v) { return v.isflt ? mn_flt(-v.flt) : mn_int(mits_sub(0LL, v.num)); }\n"
+    "static mv mv_mn(mn v) { return v.isflt ? mv_float(v.flt) : mv_number(v.num); }\n"
+    "\n"
+    "// Integer arithmetic while both sides are numbers, float arithmetic otherwise\n"
+    "static mn mn_apply(int kind, mn l, mn r) {\n"
+    "    if (!l.isflt && !r.isflt) {\n"
+    "        switch (kind) {\n"
+    "        case 0: return mn_int(mits_add(l.num, r.num));\n"
+    "        case 1: return mn_int(mits_sub(l.num, r.num));\n"
+    "        case 2: return mn_int(mits_mul(l.num, r.num));\n"
+    "        case 3: return mn_int(mits_div(l.num, r.num));\n"
+    "        default: return mn_int(mits_mod(l.num, r.num));\n"
+    "        }\n"
+    "    }\n"
+    "    double a = l.isflt ? l.flt : (double)l.num, b = r.isflt ? r.flt : (double)r.num;\n"
+    "    switch (kind) {\n"
+    "    case 0: return mn_flt(a + b);\n"
+    "    case 1: return mn_flt(a - b);\n"
+    "    case 2: return mn_flt(a * b);\n"
+    "    case 3: return mn_flt(b == 0 ? 0 : a / b);\n"
+    "    default: return mn_flt(b == 0 ? 0 : fmod(a, b));\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "static int mits_finish(int code) {\n"
+    "    if (code != 0) printf(\"program finished with: code %d\\n\", code);\n"
+    "    return code;\n"
+    "}\n";
+
+typedef struct {
+    char *data;
+    size_t len;
+    size_t capacity;
+} Text;
+
+typedef struct {
+    const Program *prog;
+    FILE *out;
+    unsigned char *types;   // register slot -> T_* bits
+    char *tagged;           // register slot -> needs a tagged mv local
+    int temps;              // counter for unique temporaries
+    int failed;
+} Translator;
+
+static void textAppend(Text *t, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int need = vsnprintf(NULL, 0, fmt, args);
+    va_end(args);
+    if (need < 0) return;
+
+    if (t->len + need + 1 > t->capacity) {
+        size_t capacity = t->capacity ? t->capacity : 128;
+        while (t->len + need + 1 > capacity) capacity *= 2;
+        char *data = realloc(t->data, capacity);
+        if (!data) {
+            fprintf(stderr, "Error: Out of memory while translating\n");
+            exit(1);
+        }
+        t->data = data;
+        t->capacity = capacity;
+    }
+    va_start(args, fmt);
+    vsnprintf(t->data + t->len, need + 1, fmt, args);
+    va_end(args);
+    t->len += need;
+}
+
+static void emitLine(Translator *tr, int indent, const char *fmt, ...) {
+    fprintf(tr->out, "%*s", indent * 4, "");
+    va_list args;
+    va_start(args, fmt);
+    vfprintf(tr->out, fmt, args);
+    va_end(args);
+    fputc('\n', tr->out);
+}
+
+// Write text as a C string literal
+static void appendLiteral(Text *t, const char *text, int len) {
+    textAppend(t, "\"");
+    for (int i = 0; i < len; i++) {
+        unsigned char c = text[i];
+        if (c == '"' || c == '\\' || c == '?') textAppend(t, "\\%c", c);
+        else if (isprint(c)) textAppend(t, "%c", c);
+        else textAppend(t, "\\%03o", c);
+    }
+    textAppend(t, "\"");
+}
+
+static const char *slotName(const Program *prog, int slot) {
+    return poolText(prog, prog->names[slot]);
+}
+
+// C name of a register local: r_<name>, or r<slot> when the name is not a C identifier
+static void appendRegister(Translator *tr, Text *t, int slot) {
+    const char *name = slotName(tr->prog, slot);
+    int plain = !isdigit((unsigned char)name[0]);
+    for (const char *p = name; *p; p++) {
+        if (!isalnum((unsigned char)*p) && *p != '_') plain = 0;
+    }
+    if (plain) textAppend(t, "r_%s", name);
+    else textAppend(t, "r%d", slot);
+}
+
+// Could this operand be a hex value at run time
+static int mayBeHex(const Translator *tr, const Operand *op) {
+    return (operandType(tr->types, op) & T_HEX) != 0;
+}
+
+// Could this operand be a float at run time
+static int mayBeFloat(const Translator *tr, const Operand *op) {
+    return op->kind < OPD_ADD && (operandType(tr->types, op) & T_FLOAT) != 0;
+}
+
+// Is this operand a number whatever happens at run time
+static int isNumber(const Translator *tr, const Operand *op) {
+    switch (op->kind) {
+    case OPD_NUMBER:
+    case OPD_B32:
+    case OPD_ARGUMENTS: return 1;
+    case OPD_REGISTER: return !tr->tagged[op->ref];
+    default: return 0;
+    }
+}
+
+// Decide which registers need a tagged mv: those that can hold something
+// other than a number
+static void markTagged(Translator *tr, int start) {
+    const Program *prog = tr->prog;
+    inferTypes(prog, start, tr->types);
+
+    // c26 and UTF tell an undefined register from 0, so their sources need a tag
+    for (int slot = 0; slot < prog->nameCount; slot++) {
+        tr->tagged[slot] = (tr->types[slot] & ~T_NUMBER) != 0;
+    }
+    for (int i = start; i < prog->codeCount; i++) {
+        const Instr *in = &prog->code[i];
+        for (int k = 0; k < in->argc; k++) {
+            const Operand *op = operandAt(prog, in, k);
+            if ((op->kind == OPD_C26 || op->kind == OPD_UTF) && op->ref >= 0) tr->tagged[op->ref] = 1;
+        }
+    }
+}
+
+// Pointer to the mv behind a conversion operand
+static void appendSource(Translator *tr, Text *t, const Operand *op) {
+    if (op->ref < 0) {
+        textAppend(t, "&mits_undef");
+    } else {
+        textAppend(t, "&");
+        appendRegister(tr, t, op->ref);
+    }
+}
+
+// C expression for an operand read as a number (evalNumber)
+static void appendNumber(Translator *tr, Text *t, const Operand *op) {
+    switch (op->kind) {
+    case OPD_NUMBER:
+        if (op->num == LLONG_MIN) textAppend(t, "(-%lldLL - 1)", LLONG_MAX);
+        else textAppend(t, "%lldLL", op->num);
+        break;
+    case OPD_REGISTER:
+        if (tr->tagged[op->ref]) {
+            textAppend(t, "mv_num(&");
+            appendRegister(tr, t, op->ref);
+            textAppend(t, ")");
+        } else {
+            appendRegister(tr, t, op->ref);
+        }
+        break;
+    case OPD_B32:
+        if (op->ref >= 0 && tr->tagged[op->ref]) {
+            textAppend(t, "mv_b32(");
+            appendSource(tr, t, op);
+            textAppend(t, ")");
+        } else {
+            textAppend(t, "0LL");
+        }
+        break;
+    case OPD_FLT:
+        if (op->ref < 0) {
+            textAppend(t, "0LL");
+        } else if (tr->tagged[op->ref]) {
+            textAppend(t, "mits_trunc(mv_dbl(&");
+            appendRegister(tr, t, op->ref);
+            textAppend(t, "))");
+        } else {
+            textAppend(t, "mits_trunc((double)");
+            appendRegister(tr, t, op->ref);
+            textAppend(t, ")");
+        }
+        break;
+    case OPD_FLOAT:
+        // %a keeps every bit, including the sign of -0.0
+        textAppend(t, "mits_trunc(%a)", floatLiteral(op));
+        break;
+    case OPD_UTF:
+        // UTF passes numbers and floats through; everything else reads as 0
+        if (op->ref >= 0) {
+            textAppend(t, "mv_num(");
+            appendSource(tr, t, op);
+            textAppend(t, ")");
+        } else {
+            textAppend(t, "0LL");
+        }
+        break;
+    default:
+        // Strings, hex values and ARGUMENTS outside a call read as 0
+        textAppend(t, "0LL");
+        break;
+    }
+}
+
+// C expression of type mv for an operand (evalOperand)
+static void appendValue(Translator *tr, Text *t, const Operand *op) {
+    int tagged = op->ref >= 0 && op->kind != OPD_TEXT && op->kind != OPD_ROM && tr->tagged[op->ref];
+    switch (op->kind) {
+    case OPD_REGISTER:
+        if (tagged) {
+            textAppend(t, "mv_get(&");
+            appendRegister(tr, t, op->ref);
+            textAppend(t, ")");
+        } else {
+            textAppend(t, "mv_number(");
+            appendRegister(tr, t, op->ref);
+            textAppend(t, ")");
+        }
+        return;
+    case OPD_HEX:
+    case OPD_B31:
+    case OPD_FLT:
+        if (!tagged && op->ref >= 0) {
+            // A number or undefined register
+            if (op->kind == OPD_HEX) textAppend(t, "mv_hex(\"\", 0)");
+            else if (op->kind == OPD_B31) textAppend(t, "mv_string(\"\", 0)");
+            else {
+                textAppend(t, "mv_fltnum(");
+                appendRegister(tr, t, op->ref);
+                textAppend(t, ")");
+            }
+            return;
+        }
+        textAppend(t, op->kind == OPD_HEX ? "mv_hexof(" : op->kind == OPD_B31 ? "mv_b31(" : "mv_flt(");
+        appendSource(tr, t, op);
+        textAppend(t, ")");
+        return;
+    case OPD_C26:
+    case OPD_UTF:
+        textAppend(t, op->kind == OPD_C26 ? "mv_c26(" : "mv_utf(");
+        appendSource(tr, t, op);
+        textAppend(t, ")");
+        return;
+    case OPD_FLOAT:
+        textAppend(t, "mv_float(%a)", floatLiteral(op));
+        return;
+    default:
+        textAppend(t, "mv_number(");
+        appendNumber(tr, t, op);
+        textAppend(t, ")");
+        return;
+    }
+}
+
+// C expression for a postfix arithmetic expression (evaluateExpression)
+static void appendExpression(Translator *tr, Text *t, const Operand *ops, int count) {
+    Text *stack = calloc(count, sizeof(Text));
+    int top = 0;
+    for (int i = 0; i < count; i++) {
+        const Operand *op = &ops[i];
+        Text node = {0};
+        if (op->kind == OPD_NEG) {
+            top--;
+            textAppend(&node, "mits_sub(0LL, %s)", stack[top].data);
+        } else if (op->kind >= OPD_ADD) {
+            static const char *const calls[] = {
+                [OPD_ADD - OPD_ADD] = "mits_add", [OPD_SUB - OPD_ADD] = "mits_sub",
+                [OPD_MUL - OPD_ADD] = "mits_mul", [OPD_DIV - OPD_ADD] = "mits_div",
+                [OPD_MOD - OPD_ADD] = "mits_mod",
+            };
+            top -= 2;
+            textAppend(&node, "%s(%s, %s)", calls[op->kind - OPD_ADD], stack[top].data, stack[top + 1].data);
+            free(stack[top + 1].data);
+        } else {
+            appendNumber(tr, &node, op);
+            stack[top++] = node;
+            continue;
+        }
+        free(stack[top].data);
+        stack[top++] = node;
+    }
+    textAppend(t, "%s", stack[0].data);
+    free(stack[0].data);
+    free(stack);
+}
+
+// Does the expression in ops[0..count-1] read anything that may be a float
+static int mayMeetFloat(const Translator *tr, const Operand *ops, int count) {
+    for (int i = 0; i < count; i++) {
+        if (mayBeFloat(tr, &ops[i])) return 1;
+    }
+    return 0;
+}
+
+// C expression of type mn for a postfix expression that may meet floats
+// (evaluateValue)
+static void appendMixedExpression(Translator *tr, Text *t, const Operand *ops, int count) {
+    Text *stack = calloc(count, sizeof(Text));
+    int top = 0;
+    for (int i = 0; i < count; i++) {
+        const Operand *op = &ops[i];
+        Text node = {0};
+        if (op->kind == OPD_NEG) {
+            top--;
+            textAppend(&node, "mn_neg(%s)", stack[top].data);
+        } else if (op->kind >= OPD_ADD) {
+            top -= 2;
+            textAppend(&node, "mn_apply(%d, %s, %s)", op->kind - OPD_ADD, stack[top].data, stack[top + 1].data);
+            free(stack[top + 1].data);
+        } else {
+            if (isNumber(tr, op)) {
+                textAppend(&node, "mn_int(");
+                appendNumber(tr, &node, op);
+            } else if (op->kind == OPD_REGISTER) {
+                textAppend(&node, "mn_at(&");
+                appendRegister(tr, &node, op->ref);
+            } else {
+                textAppend(&node, "mn_of(");
+                appendValue(tr, &node, op);
+            }
+            textAppend(&node, ")");
+            stack[top++] = node;
+            continue;
+        }
+        free(stack[top].data);
+        stack[top++] = node;
+    }
+    textAppend(t, "%s", stack[0].data);
+    free(stack[0].data);
+    free(stack);
+}
+
+// C expression of type mv for the arithmetic of a generic store
+static void appendArithmetic(Translator *tr, Text *t, const Operand *ops, int count) {
+    int mixed = mayMeetFloat(tr, ops, count);
+    textAppend(t, mixed ? "mv_mn(" : "mv_number(");
+    if (mixed) appendMixedExpression(tr, t, ops, count);
+    else appendExpression(tr, t, ops, count);
+    textAppend(t, ")");
+}
+
+// Format of a store of an expression into a register. Tagged registers
+// may hold a hex block, so they are set through mv_set.
+static const char *storeFormat(const Translator *tr, int slot) {
+    return tr->tagged[slot] ? "mv_set(&%s, %s);" : "%s = %s;";
+}
+
+// Store the arithmetic of a generic store into a register; one that may
+// meet floats always stores into a tagged register
+static void emitStoreArithmetic(Translator *tr, int indent, int slot, const Operand *ops, int count) {
+    Text target = {0}, expr = {0};
+    appendRegister(tr, &target, slot);
+    if (tr->tagged[slot]) {
+        appendArithmetic(tr, &expr, ops, count);
+    } else {
+        appendExpression(tr, &expr, ops, count);
+    }
+    emitLine(tr, indent, storeFormat(tr, slot), target.data, expr.data);
+    free(target.data);
+    free(expr.data);
+}
+
+// Store a number expression into a register
+static void emitStoreNumber(Translator *tr, int indent, int slot, const char *expr) {
+    Text target = {0};
+    appendRegister(tr, &target, slot);
+    if (tr->tagged[slot]) emitLine(tr, indent, "mv_set(&%s, mv_number(%s));", target.data, expr);
+    else emitLine(tr, indent, "%s = %s;", target.data, expr);
+    free(target.data);
+}
+
+// The messages badName in verify.c reports before a run, printed here when
+// the translated program reaches the line
+static void emitNameError(Translator *tr, int indent, const char *name) {
+    Text message = {0};
+    char text[256];
+    size_t len = strlen(name);
+    int letters = len == 3;
+    for (size_t i = 0; letters && i < 3; i++) {
+        if (!isalpha((unsigned char)name[i])) letters = 0;
+    }
+    if (len != 3) {
+        snprintf(text, sizeof(text), "Error: Variable names must be exactly 3 letters, got '%s' (%zu letters)\n", name, len);
+    } else if (!letters) {
+        snprintf(text, sizeof(text), "Error: Variable names must contain only letters, got '%s'\n", name);
+    } else {
+        return;
+    }
+    appendLiteral(&message, text, strlen(text));
+    emitLine(tr, indent, "fputs(%s, stderr);", message.data);
+    free(message.data);
+}
+
+static void unsupported(Translator *tr, const Instr *in, const char *what) {
+    fprintf(stderr, "Error: line %d: %s cannot be translated to C\n", in->line, what);
+    tr->failed = 1;
+}
+
+static void emitRange(Translator *tr, int first, int stop, int indent);
+
+static void emitFor(Translator *tr, const Instr *in, int index, int indent) {
+    const Program *prog = tr->prog;
+    int bodyEnd = in->target < prog->codeCount ? in->target : prog->codeCount;
+
+    if (in->mode != FOR_OK) {
+        // A header that cannot run leaves its body to execute once
+        if (in->mode == FOR_INVALID_NAME) {
+            emitNameError(tr, indent, poolText(prog, operandAt(prog, in, 0)->ref));
+        }
+        emitRange(tr, index + 1, bodyEnd, indent);
+        return;
+    }
+
+    const Operand *args = operandAt(prog, in, 0);
+    int id = tr->temps++;
+    int loops = in->target < prog->codeCount;
+    Text dest = {0}, from = {0}, to = {0};
+    appendRegister(tr, &dest, in->dest);
+
+    emitLine(tr, indent, "{");
+    if (isNumber(tr, &args[0]) && isNumber(tr, &args[1])) {
+        appendNumber(tr, &from, &args[0]);
+        appendNumber(tr, &to, &args[1]);
+        emitLine(tr, indent + 1, "long long first%d = %s, last%d = %s;", id, from.data, id, to.data);
+        emitLine(tr, indent + 1, "for (long long i%d = first%d; i%d <= last%d; i%d++) {", id, id, id, id, id);
+        if (tr->tagged[in->dest]) emitLine(tr, indent + 2, "mv_set(&%s, mv_number(i%d));", dest.data, id);
+        else emitLine(tr, indent + 2, "%s = i%d;", dest.data, id);
+        emitRange(tr, index + 1, bodyEnd, indent + 2);
+        emitLine(tr, indent + 2, loops ? "if (i%d == last%d) break;" : "break;", id, id);
+        emitLine(tr, indent + 1, "}");
+    } else {
+        // Only numeric bounds loop; anything else runs the body once
+        appendValue(tr, &from, &args[0]);
+        appendValue(tr, &to, &args[1]);
+        emitLine(tr, indent + 1, "mv from%d = %s, to%d = %s;", id, from.data, id, to.data);
+        emitLine(tr, indent + 1, "int numeric%d = from%d.type == MV_NUMBER && to%d.type == MV_NUMBER;", id, id, id);
+        emitLine(tr, indent + 1, "long long first%d = numeric%d ? from%d.num : 0, last%d = numeric%d ? to%d.num : 0;",
+                 id, id, id, id, id, id);
+        emitLine(tr, indent + 1, "for (long long i%d = first%d; i%d <= last%d; i%d++) {", id, id, id, id, id);
+        if (tr->tagged[in->dest]) emitLine(tr, indent + 2, "if (numeric%d) mv_set(&%s, mv_number(i%d));", id, dest.data, id);
+        else emitLine(tr, indent + 2, "if (numeric%d) %s = i%d;", id, dest.data, id);
+        emitRange(tr, index + 1, bodyEnd, indent + 2);
+        emitLine(tr, indent + 2, loops ? "if (!numeric%d || i%d == last%d) break;" : "break;", id, id, id);
+        emitLine(tr, indent + 1, "}");
+    }
+    emitLine(tr, indent, "}");
+    free(dest.data);
+    free(from.data);
+    free(to.data);
+}
+
+static void emitCond(Translator *tr, const Instr *in, int index, int indent) {
+    const Program *prog = tr->prog;
+    int end = in->target < prog->codeCount ? in->target : prog->codeCount;
+
+    // A malformed header runs both branches
+    if (in->mode == CMP_MALFORMED) {
+        emitRange(tr, index + 1, end, indent);
+        return;
+    }
+
+    static const char *ops[] = { [CMP_LT] = "<", [CMP_GT] = ">", [CMP_LE] = "<=",
+                                 [CMP_GE] = ">=", [CMP_EQ] = "==", [CMP_NE] = "!=" };
+    const Operand *args = operandAt(prog, in, 0);
+    Text left = {0}, right = {0};
+    emitLine(tr, indent, "{");
+    if (in->mode == CMP_NONE) {
+        emitLine(tr, indent + 1, "if (0) {");
+    } else if (isNumber(tr, &args[0]) && isNumber(tr, &args[1])) {
+        appendNumber(tr, &left, &args[0]);
+        appendNumber(tr, &right, &args[1]);
+        emitLine(tr, indent + 1, "if (%s %s %s) {", left.data, ops[in->mode], right.data);
+    } else {
+        int id = tr->temps++;
+        appendValue(tr, &left, &args[0]);
+        appendValue(tr, &right, &args[1]);
+        emitLine(tr, indent + 1, "mv left%d = %s, right%d = %s;", id, left.data, id, right.data);
+        emitLine(tr, indent + 1, "if (mv_compare(&left%d, &right%d, %d)) {", id, id, in->mode);
+    }
+
+    if (in->alt >= 0) {
+        emitRange(tr, index + 1, in->alt, indent + 2);
+        emitLine(tr, indent + 1, "} else {");
+        emitRange(tr, in->alt + 1, end, indent + 2);
+    } else {
+        emitRange(tr, index + 1, end, indent + 2);
+    }
+    emitLine(tr, indent + 1, "}");
+    emitLine(tr, indent, "}");
+    free(left.data);
+    free(right.data);
+}
+
+static void emitInstruction(Translator *tr, const Instr *in, int indent) {
+    const Program *prog = tr->prog;
+    const Operand *args = in->argc ? operandAt(prog, in, 0) : NULL;
+    Text expr = {0}, target = {0};
+
+    for (int k = 0; k < in->argc; k++) {
+        if (args[k].kind == OPD_ROM) {
+            unsupported(tr, in, "rom= lookup");
+            return;
+        }
+    }
+    if (in->dest >= 0) appendRegister(tr, &target, in->dest);
+
+    switch (baseOp(in)) {
+    case OP_INVALID:
+        emitNameError(tr, indent, poolText(prog, args[0].ref));
+        break;
+
+    case OP_MOV:
+        if (tr->tagged[in->dest]) appendValue(tr, &expr, &args[0]);
+        else appendNumber(tr, &expr, &args[0]);
+        emitLine(tr, indent, storeFormat(tr, in->dest), target.data, expr.data);
+        break;
+
+    case OP_RDL: {
+        int id = tr->temps++;
+        emitLine(tr, indent, "{");
+        emitLine(tr, indent + 1, "char line%d[512];", id);
+        emitLine(tr, indent + 1, "if (mits_readline(line%d)) {", id);
+        if (in->mode == RDL_INT) {
+            textAppend(&expr, "strtoll(line%d, NULL, 10)", id);
+            emitStoreNumber(tr, indent + 2, in->dest, expr.data);
+        } else if (in->mode == RDL_FLOAT) {
+            emitLine(tr, indent + 2, "mv_set(&%s, mits_readfloat(line%d));", target.data, id);
+        } else {
+            emitLine(tr, indent + 2, "mv_set(&%s, mv_string(line%d, (int)strlen(line%d)));", target.data, id, id);
+        }
+        emitLine(tr, indent + 1, "}");
+        emitLine(tr, indent, "}");
+        break;
+    }
+
+    case OP_CHAR: {
+        const char *text = poolText(prog, args[0].ref);
+        appendLiteral(&expr, text, strlen(text));
+        emitLine(tr, indent, "mv_set(&%s, mv_string(%s, %d));", target.data, expr.data, (int)strlen(text));
+        break;
+    }
+
+    case OP_ADDR: {
+        int first = in->mode == ADDR_CONCAT ? 2 : 0;
+        if (in->mode == ADDR_CONCAT && mayBeHex(tr, &args[0]) && mayBeHex(tr, &args[1])) {
+            appendArithmetic(tr, &expr, args + first, in->argc - first);
+            // Hex concatenation when both halves turn out to be hex
+            Text left = {0}, right = {0};
+            int id = tr->temps++;
+            appendValue(tr, &left, &args[0]);
+            appendValue(tr, &right, &args[1]);
+            emitLine(tr, indent, "{");
+            emitLine(tr, indent + 1, "mv left%d = %s, right%d = %s;", id, left.data, id, right.data);
+            emitLine(tr, indent + 1, "if (left%d.type == MV_HEX && right%d.type == MV_HEX) mv_set(&%s, mv_concat(&left%d, &right%d));",
+                     id, id, target.data, id, id);
+            emitLine(tr, indent + 1, "else mv_set(&%s, %s);", target.data, expr.data);
+            emitLine(tr, indent, "}");
+            free(left.data);
+            free(right.data);
+        } else {
+            emitStoreArithmetic(tr, indent, in->dest, args + first, in->argc - first);
+        }
+        break;
+    }
+
+    case OP_SUBR:
+    case OP_MUL:
+    case OP_DIV:
+    case OP_MOD:
+        emitStoreArithmetic(tr, indent, in->dest, args, in->argc);
+        break;
+
+    case OP_CALC:
+        appendExpression(tr, &expr, args, in->argc);
+        emitStoreNumber(tr, indent, in->dest, expr.data);
+        break;
+
+    case OP_SDA:
+        // ARGUMENTS is empty outside a function call
+        textAppend(&expr, "0LL");
+        for (int k = 0; in->mode == SDA_LIST && k < in->argc; k++) {
+            Text sum = {0};
+            textAppend(&sum, "mits_add(%s, ", expr.data);
+            appendNumber(tr, &sum, &args[k]);
+            textAppend(&sum, ")");
+            free(expr.data);
+            expr = sum;
+        }
+        emitStoreNumber(tr, indent, in->dest, expr.data);
+        break;
+
+    case OP_VGA:
+        if (isNumber(tr, &args[0])) {
+            appendNumber(tr, &expr, &args[0]);
+            emitLine(tr, indent, "vga_number(%s);", expr.data);
+        } else {
+            appendValue(tr, &expr, &args[0]);
+            emitLine(tr, indent, "vga_value(%s);", expr.data);
+        }
+        break;
+
+    case OP_EXEC:
+        if (in->mode == EXEC_HELP) {
+            emitLine(tr, indent, "puts(\"mov, char, hex, addr, subr, mul, div, mod, vga, exec, cond, for, sda, def, req, read, vec, buf, str\");");
+        } else if (isNumber(tr, &args[0])) {
+            int id = tr->temps++;
+            appendNumber(tr, &expr, &args[0]);
+            emitLine(tr, indent, "{");
+            emitLine(tr, indent + 1, "long long code%d = %s;", id, expr.data);
+            emitLine(tr, indent + 1, "if (code%d <= 255) return mits_finish((int)code%d);", id, id);
+            emitLine(tr, indent, "}");
+        } else {
+            int id = tr->temps++;
+            appendValue(tr, &expr, &args[0]);
+            emitLine(tr, indent, "{");
+            emitLine(tr, indent + 1, "mv code%d = %s;", id, expr.data);
+            emitLine(tr, indent + 1, "if (code%d.type == MV_NUMBER && code%d.num <= 255) return mits_finish((int)code%d.num);",
+                     id, id, id);
+            emitLine(tr, indent, "}");
+        }
+        break;
+
+    case OP_CALL:
+        unsupported(tr, in, "a def call");
+        break;
+
+    case OP_READ:
+        unsupported(tr, in, "read");
+        break;
+
+    case OP_REQ:
+        unsupported(tr, in, "req");
+        break;
+
+    case OP_WASM:
+        unsupported(tr, in, "wasm");
+        break;
+
+    case OP_VEC:
+        unsupported(tr, in, "vec");
+        break;
+
+    case OP_BUF:
+        unsupported(tr, in, "buf");
+        break;
+
+    case OP_STR:
+        unsupported(tr, in, "str");
+        break;
+
+    default:
+        // Labels, stray else/end lines
+        break;
+    }
+    free(expr.data);
+    free(target.data);
+}
+
+// Emit instructions first..stop-1; each block header consumes its body
+static void emitRange(Translator *tr, int first, int stop, int indent) {
+    const Program *prog = tr->prog;
+    int i = first;
+    while (i < stop && !tr->failed) {
+        const Instr *in = &prog->code[i];
+        switch (baseOp(in)) {
+        case OP_FOR:
+            emitFor(tr, in, i, indent);
+            i = in->target + 1;
+            break;
+        case OP_COND:
+        case OP_TEST:
+            emitCond(tr, in, i, indent);
+            i = in->target + 1;
+            break;
+        case OP_DEF:
+            // Function bodies never run at the top level
+            i = in->target + 1;
+            break;
+        default:
+            emitInstruction(tr, in, indent);
+            i++;
+            break;
+        }
+    }
+}
+
+int translateProgram(const Program *prog, int start, const char *source, const char *path) {
+    Translator tr;
+    memset(&tr, 0, sizeof(tr));
+    tr.prog = prog;
+    tr.types = calloc(prog->nameCount + 1, 1);
+    tr.tagged = calloc(prog->nameCount + 1, 1);
+    if (!tr.types || !tr.tagged) {
+        fprintf(stderr, "Error: Out of memory while translating\n");
+        exit(1);
+    }
+
+    // Blocks must not straddle _start, since execution begins inside them
+    for (int i = start; i < prog->codeCount; i++) {
+        const Instr *in = &prog->code[i];
+        if ((in->op == OP_END || in->op == OP_ELSE) && in->target >= 0 && in->target < start) {
+            unsupported(&tr, in, "a block opened before _start:");
+        }
+    }
+    if (tr.failed) {
+        free(tr.types);
+        free(tr.tagged);
+        return 1;
+    }
+
+    markTagged(&tr, start);
+
+    tr.out = fopen(path, "w");
+    if (!tr.out) {
+        fprintf(stderr, "Error: Cannot write output file '%s'\n", path);
+        free(tr.types);
+        free(tr.tagged);
+        return 1;
+    }
+
+    fprintf(tr.out, "// Translated from %s by mits-compiler\n", source);
+    fputs(prelude, tr.out);
+    fprintf(tr.out, "\nint main(void) {\n");
+    for (int slot = 0; slot < prog->nameCount; slot++) {
+        Text name = {0};
+        appendRegister(&tr, &name, slot);
+        if (tr.tagged[slot]) emitLine(&tr, 1, "mv %s = {0};", name.data);
+        else emitLine(&tr, 1, "long long %s = 0;", name.data);
+        free(name.data);
+    }
+    fputc('\n', tr.out);
+    emitRange(&tr, start, prog->codeCount, 1);
+    emitLine(&tr, 1, "return mits_finish(0);");
+    fprintf(tr.out, "}\n");
+
+    int failed = tr.failed;
+    if (fclose(tr.out) != 0) {
+        fprintf(stderr, "Error: Cannot write output file '%s'\n", path);
+        failed = 1;
+    }
+    if (failed) remove(path);
+    free(tr.types);
+    free(tr.tagged);
+    return failed;
+}
@@ -0,0 +1,13 @@
+#ifndef TRANSLATE_H
+#define TRANSLATE_H
+
+#include "decode.h"
+
+// Translate a decoded, block-resolved program into a standalone C file.
+// Registers that only ever hold numbers become long long locals; the rest
+// use the small tagged value type from the emitted runtime. Programs that
+// need req, read, wasm, def calls or rom= lookups cannot be translated.
+// Returns 0 on success and reports problems on stderr.
+int translateProgram(const Program *prog, int start, const char *source, const char *path);
+
+#endif // TRANSLATE_H
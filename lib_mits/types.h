@@ -2,7 +2,7 @@
 #define TYPES_H
 
 #define MAX_LINES 1024
-#define MAX_LINE_LENGTH 256
+#define MAX_LINE_LENGTH 512
 #define MAX_REGISTERS 256
 #define MAX_FUNCTIONS 128
 #define MAX_ROM_ENTRIES 512
@@ -0,0 +1,371 @@
+#include "verify.h"
+#include "infer.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    const Program *prog;
+    const char *path;
+    int errors;             // source errors reported so far
+    unsigned char *types;   // register types, inferred when first needed
+} Verifier;
+
+static void sourceError(Verifier *v, const Instr *in, const char *format, ...) {
+    va_list args;
+    fprintf(stderr, "Error: %s: line %d: ", v->path, in->line);
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fprintf(stderr, "\n");
+    v->errors++;
+}
+
+static int broken(const Verifier *v, int index, const char *problem) {
+    if (index >= 0) {
+        fprintf(stderr, "Error: %s: instruction %d (line %d): %s\n", v->path, index,
+                v->prog->code[index].line, problem);
+    } else {
+        fprintf(stderr, "Error: %s: %s\n", v->path, problem);
+    }
+    return -1;
+}
+
+static void badName(Verifier *v, const Instr *in) {
+    const char *name = poolText(v->prog, operandAt(v->prog, in, 0)->ref);
+    if (strlen(name) != 3) {
+        sourceError(v, in, "Variable names must be exactly 3 letters, got '%s' (%zu letters)", name, strlen(name));
+    } else {
+        sourceError(v, in, "Variable names must contain only letters, got '%s'", name);
+    }
+}
+
+static int readsRegister(int kind) {
+    return kind == OPD_REGISTER || (kind >= OPD_HEX && kind <= OPD_FLT);
+}
+
+static int isTextOperand(const Program *prog, const Instr *in, int k) {
+    return k < in->argc && operandAt(prog, in, k)->kind == OPD_TEXT;
+}
+
+// Every operand but skip (-1 for none) is raw text
+static int allTextBut(const Program *prog, const Instr *in, int skip) {
+    for (int k = 0; k < in->argc; k++) {
+        if (k != skip && !isTextOperand(prog, in, k)) return 0;
+    }
+    return 1;
+}
+
+static int allText(const Program *prog, const Instr *in) {
+    return allTextBut(prog, in, -1);
+}
+
+// Postfix operands first..argc-1 never take more values than they have
+// and leave exactly one behind
+static int isExpression(const Program *prog, const Instr *in, int first) {
+    int depth = 0;
+    for (int k = first; k < in->argc; k++) {
+        int kind = operandAt(prog, in, k)->kind;
+        if (kind == OPD_NEG) {
+            if (depth < 1) return 0;
+        } else if (kind >= OPD_ADD) {
+            if (depth < 2) return 0;
+            depth--;
+        } else {
+            depth++;
+        }
+    }
+    return depth == 1 || first >= in->argc;
+}
+
+static int isCalcForm(int op) {
+    return op == OP_CALC || op == OP_CALC2 || op == OP_CALC3 || op == OP_CALC_TEST || op == OP_CALC_END;
+}
+
+static int isTestForm(int op) {
+    return op == OP_TEST || op == OP_TEST_CALC;
+}
+
+static int isNumber(const Verifier *v, const Operand *op) {
+    return op->kind == OPD_NUMBER || (op->kind == OPD_REGISTER && (v->types[op->ref] & ~T_NUMBER) == 0);
+}
+
+// The number-only forms read registers without looking at their type
+static int onlyNumbers(Verifier *v, const Instr *in) {
+    const Program *prog = v->prog;
+    if (!v->types) {
+        v->types = malloc(prog->nameCount + 1);
+        if (!v->types) {
+            fprintf(stderr, "Error: Out of memory while verifying\n");
+            exit(1);
+        }
+        inferTypes(prog, 0, v->types);
+    }
+
+    if (isTestForm(in->op)) {
+        return in->argc == 2 && in->mode >= CMP_LT && in->mode <= CMP_NE
+            && isNumber(v, operandAt(prog, in, 0)) && isNumber(v, operandAt(prog, in, 1));
+    }
+    if (in->dest < 0 || (v->types[in->dest] & ~T_NUMBER) != 0 || in->argc == 0) return 0;
+    for (int k = 0; k < in->argc; k++) {
+        const Operand *op = operandAt(prog, in, k);
+        if (op->kind < OPD_ADD && !isNumber(v, op)) return 0;
+    }
+    return isExpression(prog, in, 0);
+}
+
+// Operands a store of the given opcode reads
+static int isStoreShape(const Program *prog, const Instr *in, int op) {
+    if (in->dest < 0) return 0;
+    switch (op) {
+    case OP_MOV:
+        return in->argc >= 1;
+    case OP_CHAR:
+        return isTextOperand(prog, in, 0);
+    case OP_ADDR:
+        if (in->mode == ADDR_CONCAT) return in->argc >= 2 && isExpression(prog, in, 2);
+        return isExpression(prog, in, 0);
+    case OP_SUBR:
+    case OP_MUL:
+    case OP_DIV:
+    case OP_MOD:
+        return isExpression(prog, in, 0);
+    default:
+        return 1;
+    }
+}
+
+static int opensBlock(const Instr *in) {
+    int op = baseOp(in);
+    return op == OP_FOR || op == OP_COND || op == OP_TEST || op == OP_DEF;
+}
+
+// Operands and links the instruction at index is run with; NULL if they fit
+static const char *checkShape(Verifier *v, int index) {
+    const Program *prog = v->prog;
+    const Instr *in = &prog->code[index];
+    int count = prog->codeCount;
+
+    if (opensBlock(in)) {
+        if (in->target <= index || in->target > count) return "block link out of range";
+        if (in->target < count) {
+            const Instr *end = &prog->code[in->target];
+            if ((end->op != OP_END && end->op != OP_RET) || end->target != index) return "block does not match its end";
+        }
+    }
+
+    switch (in->op) {
+    case OP_MOV:
+    case OP_CHAR:
+    case OP_ADDR:
+    case OP_SUBR:
+    case OP_MUL:
+    case OP_DIV:
+    case OP_MOD:
+        if (!isStoreShape(prog, in, in->op)) return "malformed store";
+        break;
+    case OP_RDL:
+    case OP_SDA:
+        if (in->dest < 0) return "store without a register";
+        break;
+    case OP_VGA:
+        if (in->argc < 1) return "missing operand";
+        break;
+    case OP_VEC:
+        if (in->mode > VEC_PUSH) return "malformed vec";
+        if (in->mode != VEC_NONE && (in->dest < 0 || in->argc != vecOperandCount(in->mode))) return "malformed vec";
+        break;
+    case OP_BUF:
+        if (in->mode > BUF_LEN) return "malformed buf";
+        if (in->mode != BUF_NONE && (in->dest < 0 || in->argc != bufOperandCount(in->mode))) return "malformed buf";
+        break;
+    case OP_STR:
+        if (in->mode > STR_LEN) return "malformed str";
+        if (in->mode != STR_NONE && (in->dest < 0 || in->argc != strOperandCount(in->mode))) return "malformed str";
+        break;
+    case OP_EXEC:
+        if (in->mode != EXEC_HELP && in->argc < 1) return "missing operand";
+        break;
+    case OP_READ:
+        if (in->argc > 3 || !allText(prog, in)) return "malformed read";
+        break;
+    case OP_REQ:
+        if (!allText(prog, in)) return "malformed req";
+        break;
+    case OP_WASM: {
+        static const int needs[] = {
+            [WASM_NEW_PAGE] = 1, [WASM_NEW_ELEMENT] = 5, [WASM_ATTACH] = 2, [WASM_OPEN_PORT] = 2,
+        };
+        int need = in->mode < sizeof(needs) / sizeof(needs[0]) ? needs[in->mode] : 0;
+        // wasm -ne may take its txt from a register
+        int value = in->mode == WASM_NEW_ELEMENT ? 1 : -1;
+        if (in->argc < need || !allTextBut(prog, in, value)) return "malformed wasm";
+        break;
+    }
+    case OP_FOR:
+        if (in->mode == FOR_OK && (in->dest < 0 || in->argc < 2)) return "malformed for";
+        if (in->mode == FOR_INVALID_NAME && !isTextOperand(prog, in, 0)) return "malformed for";
+        break;
+    case OP_COND:
+    case OP_GTEST:
+        if (in->mode != CMP_MALFORMED && in->argc < 2) return "malformed cond";
+        if (in->op == OP_GTEST && (in->argc != 2 || in->mode < CMP_LT || in->mode > CMP_NE)) return "malformed cond";
+        break;
+    case OP_ELSE:
+        if (in->alt >= 0) {
+            if (in->alt >= index) return "else does not match its cond";
+            const Instr *cond = &prog->code[in->alt];
+            if ((baseOp(cond) != OP_COND && baseOp(cond) != OP_TEST) || cond->alt != index || cond->target != in->target) {
+                return "else does not match its cond";
+            }
+        }
+        break;
+    case OP_END:
+    case OP_RET:
+        if (in->target >= index || in->target < -1) return "end link out of range";
+        if (in->target >= 0 && !opensBlock(&prog->code[in->target])) return "end does not match a block";
+        break;
+    case OP_CALL:
+        if (in->argc < 1 || in->target < 0 || in->target >= count) return "call link out of range";
+        if (prog->code[in->target].op != OP_DEF || prog->code[in->target].dest < 0) return "call does not name a def";
+        break;
+    case OP_INVALID:
+        if (!isTextOperand(prog, in, 0)) return "malformed instruction";
+        break;
+    case OP_GCALC:
+        if (in->target != OP_MOV && in->target != OP_ADDR && (in->target < OP_SUBR || in->target > OP_MOD)) {
+            return "guarded store of an unknown kind";
+        }
+        if (!isStoreShape(prog, in, in->target)) return "malformed store";
+        break;
+    default:
+        break;
+    }
+
+    // A cond's else must point back at it
+    int op = baseOp(in);
+    if ((op == OP_COND || op == OP_TEST) && in->alt >= 0) {
+        if (in->alt <= index || in->alt >= in->target || prog->code[in->alt].op != OP_ELSE
+            || prog->code[in->alt].alt != index) {
+            return "cond does not match its else";
+        }
+    }
+
+    // Superinstructions run the instructions after them as well
+    int follow = in->op == OP_CALC3 ? 2 : in->op == OP_CALC2 || in->op == OP_CALC_TEST || in->op == OP_CALC_END || in->op == OP_TEST_CALC;
+    if (index + follow >= count) return "fused sequence runs past the program";
+    for (int k = 1; k <= follow; k++) {
+        int next = prog->code[index + k].op;
+        if (in->op == OP_CALC_TEST ? !isTestForm(next) : in->op == OP_CALC_END ? next != OP_END : !isCalcForm(next)) {
+            return "fused sequence does not match";
+        }
+    }
+    return NULL;
+}
+
+// Source problems the decoder tolerated; they are only worth a message
+static void checkSource(Verifier *v, int index) {
+    const Program *prog = v->prog;
+    const Instr *in = &prog->code[index];
+
+    switch (in->op) {
+    case OP_INVALID:
+        badName(v, in);
+        break;
+    case OP_FOR:
+        if (in->mode == FOR_INVALID_NAME) badName(v, in);
+        else if (in->mode == FOR_MALFORMED) sourceError(v, in, "for needs the form 'for mov reg, start, end, exec:'");
+        break;
+    case OP_COND:
+        if (in->mode == CMP_MALFORMED) sourceError(v, in, "cond needs the form 'cond a < b, exec:'");
+        else if (in->mode == CMP_NONE) sourceError(v, in, "cond needs one of < > <= >= == !=");
+        break;
+    case OP_ELSE:
+        if (in->alt < 0) sourceError(v, in, "else without a cond to belong to");
+        break;
+    case OP_END:
+        if (in->target < 0) sourceError(v, in, "end without a block to close");
+        break;
+    case OP_VEC:
+        if (in->mode == VEC_NONE) {
+            sourceError(v, in, "vec needs one of fill, add, mul, dot, sum, min, max, slice, get, set, len, push");
+        }
+        break;
+    case OP_BUF:
+        if (in->mode == BUF_NONE) sourceError(v, in, "buf needs one of xor, and, or, cmp, find, count, crc, xxh, sha, slice, len");
+        break;
+    case OP_STR:
+        if (in->mode == STR_NONE) sourceError(v, in, "str needs one of new, add, len");
+        break;
+    case OP_REQ:
+        if (in->argc == 2 && in->dest < 0 && strcmp(poolText(prog, operandAt(prog, in, 0)->ref), "bin") == 0) {
+            sourceError(v, in, "req ftype=\"bin\" needs a register to map the file into");
+        }
+        break;
+    default:
+        break;
+    }
+    if (opensBlock(in) && in->target == prog->codeCount) {
+        sourceError(v, in, "%s is never closed by end", opName(baseOp(in)));
+    }
+}
+
+int verifyProgram(const Program *prog, int first, const char *path) {
+    Verifier v = {prog, path, 0, NULL};
+
+    if (prog->poolSize > 0 && prog->pool[prog->poolSize - 1] != '\0') return broken(&v, -1, "text pool is not terminated");
+    for (int slot = 0; slot < prog->nameCount; slot++) {
+        if (prog->names[slot] < 0 || prog->names[slot] >= prog->poolSize) return broken(&v, -1, "register name out of range");
+    }
+
+    // Everything later checks may index must be in range first
+    for (int i = first; i < prog->codeCount; i++) {
+        const Instr *in = &prog->code[i];
+        if (in->op >= OP_COUNT) return broken(&v, i, "unknown opcode");
+        if (in->dest < -1 || in->dest >= prog->nameCount) return broken(&v, i, "register out of range");
+        if (in->args < 0 || (long long)in->args + in->argc > prog->operandCount) return broken(&v, i, "operands out of range");
+        if (in->depth < 0 || in->depth > prog->maxDepth) return broken(&v, i, "nesting depth out of range");
+        for (int k = 0; k < in->argc; k++) {
+            const Operand *op = operandAt(prog, in, k);
+            if (op->kind > OPD_NEG) return broken(&v, i, "unknown operand kind");
+            int lowest = op->kind == OPD_REGISTER ? 0 : -1;
+            if (readsRegister(op->kind) && (op->ref < lowest || op->ref >= prog->nameCount)) {
+                return broken(&v, i, "register out of range");
+            }
+            if ((op->kind == OPD_ROM || op->kind == OPD_TEXT) && (op->ref < 0 || op->ref >= prog->poolSize)) {
+                return broken(&v, i, "text out of range");
+            }
+            if (!readsRegister(op->kind) && op->kind != OPD_ROM && op->kind != OPD_TEXT && op->ref != -1) {
+                return broken(&v, i, "operand refers to nothing");
+            }
+        }
+    }
+
+    for (int i = first; i < prog->codeCount; i++) {
+        const char *problem = checkShape(&v, i);
+        if (problem) {
+            free(v.types);
+            return broken(&v, i, problem);
+        }
+    }
+    // Type inference reads operands, so it waits until every shape fits
+    for (int i = first; i < prog->codeCount; i++) {
+        const Instr *in = &prog->code[i];
+        if ((isCalcForm(in->op) || isTestForm(in->op)) && !onlyNumbers(&v, in)) {
+            free(v.types);
+            return broken(&v, i, "number-only instruction may meet other values");
+        }
+    }
+    int malformed = 0;
+    for (int i = first; i < prog->codeCount; i++) {
+        checkSource(&v, i);
+        // The decoder lists malformed expressions in order
+        while (malformed < prog->malformedCount && prog->malformed[malformed] < i) malformed++;
+        if (malformed < prog->malformedCount && prog->malformed[malformed] == i) {
+            sourceError(&v, &prog->code[i], "%s has a malformed expression", opName(baseOp(&prog->code[i])));
+        }
+    }
+    free(v.types);
+    return v.errors;
+}
@@ -0,0 +1,24 @@
+#ifndef VERIFY_H
+#define VERIFY_H
+
+#include "decode.h"
+
+// Check a block-resolved program once before it runs, so the interpreter
+// needs no checks of its own while running it. Two kinds of problems:
+//  - source errors: register names that are not three letters, malformed
+//    for and cond headers and expressions, else and end outside a block,
+//    blocks that are never closed, vec, buf and str operations it does not
+//    know, and binary imports without a register. Each is reported as
+//    "Error: <path>: line N: ...".
+//    The interpreter still runs such a program (those lines do nothing or
+//    run as they always have); mits-compiler refuses to build it.
+//  - broken structure: an opcode, register slot, pool offset, operand
+//    count, postfix expression, block or call link that does not fit the
+//    program, a fused instruction without its sequence, or an OP_CALC or
+//    OP_TEST that could meet something other than a number. Only a damaged
+//    module can have these, and it must not run.
+// Instructions before first were verified earlier. Returns the number of
+// source errors, or -1 if the structure is broken.
+int verifyProgram(const Program *prog, int first, const char *path);
+
+#endif // VERIFY_H
@@ -0,0 +1,190 @@
+#include "bytes.h"
+#include "vector.h"
+#include "decode.h"
+#include <string.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define MITS_X86_SIMD
+#include <immintrin.h>
+#define AVX2 __attribute__((target("avx2")))
+#endif
+
+// Bits set in each 4-bit value
+static const unsigned char nibbleBits[16] = {0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4};
+
+// As in vector.c, each SIMD kernel handles a whole number of registers
+// and returns how many bytes it did; the plain loop after it does the rest
+
+#ifdef MITS_X86_SIMD
+AVX2 static long long combineBytesAvx2(int op, unsigned char *out, const unsigned char *a, const unsigned char *b,
+                                       long long count) {
+    long long i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(a + i));
+        __m256i y = _mm256_loadu_si256((const __m256i *)(b + i));
+        __m256i z = op == BUF_XOR ? _mm256_xor_si256(x, y) : op == BUF_AND ? _mm256_and_si256(x, y) : _mm256_or_si256(x, y);
+        _mm256_storeu_si256((__m256i *)(out + i), z);
+    }
+    return i;
+}
+
+static long long combineBytesSse2(int op, unsigned char *out, const unsigned char *a, const unsigned char *b,
+                                  long long count) {
+    long long i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i y = _mm_loadu_si128((const __m128i *)(b + i));
+        __m128i z = op == BUF_XOR ? _mm_xor_si128(x, y) : op == BUF_AND ? _mm_and_si128(x, y) : _mm_or_si128(x, y);
+        _mm_storeu_si128((__m128i *)(out + i), z);
+    }
+    return i;
+}
+
+// Stops at the first block that differs and leaves it to the plain loop
+AVX2 static long long sameBytesAvx2(const unsigned char *a, const unsigned char *b, long long count) {
+    long long i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(a + i));
+        __m256i y = _mm256_loadu_si256((const __m256i *)(b + i));
+        if ((unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, y)) != 0xffffffffu) break;
+    }
+    return i;
+}
+
+static long long sameBytesSse2(const unsigned char *a, const unsigned char *b, long long count) {
+    long long i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i y = _mm_loadu_si128((const __m128i *)(b + i));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) != 0xffff) break;
+    }
+    return i;
+}
+
+// Candidate positions are those where both the first and the last byte of
+// the needle match; only they get a full compare. positions is the number
+// of places the needle could start. Returns the match or -1, and sets
+// *done to the positions the kernel looked at.
+AVX2 static long long findBytesAvx2(const unsigned char *a, long long positions, const unsigned char *needle,
+                                    long long needleLen, long long start, long long *done) {
+    __m256i first = _mm256_set1_epi8((char)needle[0]);
+    __m256i last = _mm256_set1_epi8((char)needle[needleLen - 1]);
+    long long i = start;
+    for (; i + 32 <= positions; i += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(a + i));
+        __m256i y = _mm256_loadu_si256((const __m256i *)(a + i + needleLen - 1));
+        unsigned int mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(x, first), _mm256_cmpeq_epi8(y, last)));
+        while (mask) {
+            long long at = i + __builtin_ctz(mask);
+            if (memcmp(a + at + 1, needle + 1, needleLen > 2 ? needleLen - 2 : 0) == 0) return at;
+            mask &= mask - 1;
+        }
+    }
+    *done = i;
+    return -1;
+}
+
+static long long findBytesSse2(const unsigned char *a, long long positions, const unsigned char *needle,
+                               long long needleLen, long long start, long long *done) {
+    __m128i first = _mm_set1_epi8((char)needle[0]);
+    __m128i last = _mm_set1_epi8((char)needle[needleLen - 1]);
+    long long i = start;
+    for (; i + 16 <= positions; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i y = _mm_loadu_si128((const __m128i *)(a + i + needleLen - 1));
+        unsigned int mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(x, first), _mm_cmpeq_epi8(y, last)));
+        while (mask) {
+            long long at = i + __builtin_ctz(mask);
+            if (memcmp(a + at + 1, needle + 1, needleLen > 2 ? needleLen - 2 : 0) == 0) return at;
+            mask &= mask - 1;
+        }
+    }
+    *done = i;
+    return -1;
+}
+
+// Nibble lookup with pshufb, summed per 8 bytes by psadbw
+AVX2 static long long countBitsAvx2(const unsigned char *a, long long count, long long *bits) {
+    const __m256i table = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                           0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low = _mm256_set1_epi8(0x0f);
+    __m256i acc = _mm256_setzero_si256();
+    long long i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(a + i));
+        __m256i n = _mm256_add_epi8(_mm256_shuffle_epi8(table, _mm256_and_si256(x, low)),
+                                    _mm256_shuffle_epi8(table, _mm256_and_si256(_mm256_srli_epi16(x, 4), low)));
+        acc = _mm256_add_epi64(acc, _mm256_sad_epu8(n, _mm256_setzero_si256()));
+    }
+    long long lanes[4];
+    _mm256_storeu_si256((__m256i *)lanes, acc);
+    *bits += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    return i;
+}
+
+// SSE2 has no byte shuffle, so bits are added up in place instead
+static long long countBitsSse2(const unsigned char *a, long long count, long long *bits) {
+    const __m128i m1 = _mm_set1_epi8(0x55), m2 = _mm_set1_epi8(0x33), m4 = _mm_set1_epi8(0x0f);
+    __m128i acc = _mm_setzero_si128();
+    long long i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(a + i));
+        x = _mm_sub_epi8(x, _mm_and_si128(_mm_srli_epi16(x, 1), m1));
+        x = _mm_add_epi8(_mm_and_si128(x, m2), _mm_and_si128(_mm_srli_epi16(x, 2), m2));
+        x = _mm_and_si128(_mm_add_epi8(x, _mm_srli_epi16(x, 4)), m4);
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(x, _mm_setzero_si128()));
+    }
+    long long lanes[2];
+    _mm_storeu_si128((__m128i *)lanes, acc);
+    *bits += lanes[0] + lanes[1];
+    return i;
+}
+#endif
+
+void combineBytes(int op, unsigned char *out, const unsigned char *a, const unsigned char *b, long long count) {
+    long long i = 0;
+#ifdef MITS_X86_SIMD
+    if (simdLevel == SIMD_AVX2) i = combineBytesAvx2(op, out, a, b, count);
+    else if (simdLevel == SIMD_SSE2) i = combineBytesSse2(op, out, a, b, count);
+#endif
+    for (; i < count; i++) out[i] = op == BUF_XOR ? a[i] ^ b[i] : op == BUF_AND ? a[i] & b[i] : a[i] | b[i];
+}
+
+long long firstDifference(const unsigned char *a, const unsigned char *b, long long count) {
+    long long i = 0;
+#ifdef MITS_X86_SIMD
+    if (simdLevel == SIMD_AVX2) i = sameBytesAvx2(a, b, count);
+    else if (simdLevel == SIMD_SSE2) i = sameBytesSse2(a, b, count);
+#endif
+    while (i < count && a[i] == b[i]) i++;
+    return i;
+}
+
+long long findBytes(const unsigned char *a, long long count, const unsigned char *needle, long long needleLen,
+                    long long start) {
+    if (start < 0) start = 0;
+    if (needleLen == 0) return start <= count ? start : -1;
+    long long positions = count - needleLen + 1;
+    long long i = start;
+#ifdef MITS_X86_SIMD
+    long long found = -1;
+    if (simdLevel == SIMD_AVX2) found = findBytesAvx2(a, positions, needle, needleLen, start, &i);
+    else if (simdLevel == SIMD_SSE2) found = findBytesSse2(a, positions, needle, needleLen, start, &i);
+    if (found >= 0) return found;
+#endif
+    for (; i < positions; i++) {
+        if (a[i] == needle[0] && memcmp(a + i + 1, needle + 1, needleLen - 1) == 0) return i;
+    }
+    return -1;
+}
+
+long long countBits(const unsigned char *a, long long count) {
+    long long bits = 0;
+    long long i = 0;
+#ifdef MITS_X86_SIMD
+    if (simdLevel == SIMD_AVX2) i = countBitsAvx2(a, count, &bits);
+    else if (simdLevel == SIMD_SSE2) i = countBitsSse2(a, count, &bits);
+#endif
+    for (; i < count; i++) bits += nibbleBits[a[i] & 0x0f] + nibbleBits[a[i] >> 4];
+    return bits;
+}
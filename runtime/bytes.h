@@ -0,0 +1,22 @@
+#ifndef BYTES_H
+#define BYTES_H
+
+// Kernels behind buf, working on the bytes of hex values. Like the vec
+// kernels they run at the SIMD level selectSimd picked (see vector.h),
+// and every level gives the same results.
+
+// out[i] = a[i] op b[i] for op BUF_XOR, BUF_AND or BUF_OR; out may be a
+void combineBytes(int op, unsigned char *out, const unsigned char *a, const unsigned char *b, long long count);
+
+// Index of the first byte where a and b differ, count if there is none
+long long firstDifference(const unsigned char *a, const unsigned char *b, long long count);
+
+// Index of the first copy of needle in a at or after start, -1 if there is
+// none. An empty needle is found at start.
+long long findBytes(const unsigned char *a, long long count, const unsigned char *needle, long long needleLen,
+                    long long start);
+
+// Number of bits set in count bytes
+long long countBits(const unsigned char *a, long long count);
+
+#endif // BYTES_H
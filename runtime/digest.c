@@ -0,0 +1,257 @@
+#include "digest.h"
+#include "vector.h"
+#include <string.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define MITS_X86_DIGEST
+#include <immintrin.h>
+#define CRC32 __attribute__((target("sse4.2")))
+#define SHA_NI __attribute__((target("sha,sse4.1")))
+#endif
+
+static int crcHardware = 0;
+static int shaHardware = 0;
+
+void selectDigests(int level) {
+#ifdef MITS_X86_DIGEST
+    __builtin_cpu_init();
+    crcHardware = level > SIMD_SCALAR && __builtin_cpu_supports("sse4.2");
+    shaHardware = level > SIMD_SCALAR && __builtin_cpu_supports("sha") && __builtin_cpu_supports("sse4.1");
+#else
+    (void)level;
+#endif
+}
+
+// Spelled out byte by byte so the compiler makes a single load of them
+static unsigned long long readLittle64(const unsigned char *p) {
+    return (unsigned long long)p[0] | (unsigned long long)p[1] << 8 | (unsigned long long)p[2] << 16 |
+           (unsigned long long)p[3] << 24 | (unsigned long long)p[4] << 32 | (unsigned long long)p[5] << 40 |
+           (unsigned long long)p[6] << 48 | (unsigned long long)p[7] << 56;
+}
+
+static unsigned int readLittle32(const unsigned char *p) {
+    return (unsigned int)p[0] | (unsigned int)p[1] << 8 | (unsigned int)p[2] << 16 | (unsigned int)p[3] << 24;
+}
+
+static void writeBig(unsigned char *out, unsigned long long v, int size) {
+    for (int i = size - 1; i >= 0; i--) {
+        out[i] = (unsigned char)v;
+        v >>= 8;
+    }
+}
+
+// ---- CRC32C ----
+
+// Reflected Castagnoli polynomial, one table entry per byte value
+static unsigned int crcTable[256];
+
+static void buildCrcTable(void) {
+    for (unsigned int i = 0; i < 256; i++) {
+        unsigned int crc = i;
+        for (int k = 0; k < 8; k++) crc = crc & 1 ? crc >> 1 ^ 0x82f63b78u : crc >> 1;
+        crcTable[i] = crc;
+    }
+}
+
+static unsigned int crcBytes(unsigned int crc, const unsigned char *data, long long len) {
+    if (!crcTable[1]) buildCrcTable();
+    for (long long i = 0; i < len; i++) crc = crcTable[(crc ^ data[i]) & 0xff] ^ crc >> 8;
+    return crc;
+}
+
+#ifdef MITS_X86_DIGEST
+CRC32 static unsigned int crcBytesSse42(unsigned int crc, const unsigned char *data, long long len) {
+    unsigned long long wide = crc;
+    long long i = 0;
+    for (; i + 8 <= len; i += 8) wide = _mm_crc32_u64(wide, readLittle64(data + i));
+    crc = (unsigned int)wide;
+    for (; i < len; i++) crc = _mm_crc32_u8(crc, data[i]);
+    return crc;
+}
+#endif
+
+void crc32c(const unsigned char *data, long long len, unsigned char out[CRC_SIZE]) {
+    unsigned int crc;
+#ifdef MITS_X86_DIGEST
+    if (crcHardware) crc = crcBytesSse42(0xffffffffu, data, len);
+    else
+#endif
+        crc = crcBytes(0xffffffffu, data, len);
+    writeBig(out, ~crc, CRC_SIZE);
+}
+
+// ---- xxHash64 ----
+
+#define XXH_P1 0x9e3779b185ebca87ull
+#define XXH_P2 0xc2b2ae3d27d4eb4full
+#define XXH_P3 0x165667b19e3779f9ull
+#define XXH_P4 0x85ebca77c2b2ae63ull
+#define XXH_P5 0x27d4eb2f165667c5ull
+
+static unsigned long long rotateLeft(unsigned long long v, int bits) {
+    return v << bits | v >> (64 - bits);
+}
+
+static unsigned long long xxhRound(unsigned long long acc, unsigned long long input) {
+    return rotateLeft(acc + input * XXH_P2, 31) * XXH_P1;
+}
+
+static unsigned long long xxhMerge(unsigned long long hash, unsigned long long lane) {
+    return (hash ^ xxhRound(0, lane)) * XXH_P1 + XXH_P4;
+}
+
+void xxh64(const unsigned char *data, long long len, unsigned char out[XXH_SIZE]) {
+    const unsigned char *end = data + len;
+    unsigned long long hash;
+    if (len >= 32) {
+        // Four lanes over 32-byte stripes
+        unsigned long long v1 = XXH_P1 + XXH_P2, v2 = XXH_P2, v3 = 0, v4 = -XXH_P1;
+        for (; data + 32 <= end; data += 32) {
+            v1 = xxhRound(v1, readLittle64(data));
+            v2 = xxhRound(v2, readLittle64(data + 8));
+            v3 = xxhRound(v3, readLittle64(data + 16));
+            v4 = xxhRound(v4, readLittle64(data + 24));
+        }
+        hash = rotateLeft(v1, 1) + rotateLeft(v2, 7) + rotateLeft(v3, 12) + rotateLeft(v4, 18);
+        hash = xxhMerge(hash, v1);
+        hash = xxhMerge(hash, v2);
+        hash = xxhMerge(hash, v3);
+        hash = xxhMerge(hash, v4);
+    } else {
+        hash = XXH_P5;
+    }
+    hash += (unsigned long long)len;
+
+    for (; data + 8 <= end; data += 8) hash = rotateLeft(hash ^ xxhRound(0, readLittle64(data)), 27) * XXH_P1 + XXH_P4;
+    if (data + 4 <= end) {
+        hash = rotateLeft(hash ^ readLittle32(data) * XXH_P1, 23) * XXH_P2 + XXH_P3;
+        data += 4;
+    }
+    for (; data < end; data++) hash = rotateLeft(hash ^ *data * XXH_P5, 11) * XXH_P1;
+
+    hash ^= hash >> 33;
+    hash *= XXH_P2;
+    hash ^= hash >> 29;
+    hash *= XXH_P3;
+    hash ^= hash >> 32;
+    writeBig(out, hash, XXH_SIZE);
+}
+
+// ---- SHA-256 ----
+
+static const unsigned int shaRounds[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static unsigned int rotateRight(unsigned int v, int bits) {
+    return v >> bits | v << (32 - bits);
+}
+
+static void shaBlocks(unsigned int state[8], const unsigned char *data, long long blocks) {
+    for (; blocks > 0; blocks--, data += 64) {
+        unsigned int w[64];
+        for (int i = 0; i < 16; i++) {
+            const unsigned char *p = data + i * 4;
+            w[i] = (unsigned int)p[0] << 24 | (unsigned int)p[1] << 16 | (unsigned int)p[2] << 8 | p[3];
+        }
+        for (int i = 16; i < 64; i++) {
+            unsigned int s0 = rotateRight(w[i - 15], 7) ^ rotateRight(w[i - 15], 18) ^ w[i - 15] >> 3;
+            unsigned int s1 = rotateRight(w[i - 2], 17) ^ rotateRight(w[i - 2], 19) ^ w[i - 2] >> 10;
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+        unsigned int a = state[0], b = state[1], c = state[2], d = state[3];
+        unsigned int e = state[4], f = state[5], g = state[6], h = state[7];
+        for (int i = 0; i < 64; i++) {
+            unsigned int t1 = h + (rotateRight(e, 6) ^ rotateRight(e, 11) ^ rotateRight(e, 25)) + ((e & f) ^ (~e & g)) +
+                              shaRounds[i] + w[i];
+            unsigned int t2 = (rotateRight(a, 2) ^ rotateRight(a, 13) ^ rotateRight(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+    }
+}
+
+#ifdef MITS_X86_DIGEST
+// The SHA extensions keep the state as ABEF and CDGH and do two rounds per
+// sha256rnds2; sha256msg1/msg2 extend the message four words at a time
+SHA_NI static void shaBlocksNi(unsigned int state[8], const unsigned char *data, long long blocks) {
+    const __m128i byteSwap = _mm_set_epi64x(0x0c0d0e0f08090a0bll, 0x0405060700010203ll);
+    __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[0]), 0xb1);   // CDAB
+    __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[4]), 0x1b); // EFGH
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);                                      // ABEF
+    state1 = _mm_blend_epi16(state1, tmp, 0xf0);                                           // CDGH
+
+    for (; blocks > 0; blocks--, data += 64) {
+        __m128i saved0 = state0, saved1 = state1;
+        __m128i msg[4];
+        // Four rounds per step; msg[i & 3] holds the words for step i
+        for (int i = 0; i < 16; i++) {
+            if (i < 4) msg[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + i * 16)), byteSwap);
+            __m128i words = _mm_add_epi32(msg[i & 3], _mm_loadu_si128((const __m128i *)&shaRounds[i * 4]));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, words);
+            if (i >= 3 && i < 15) {
+                __m128i next = _mm_add_epi32(msg[(i + 1) & 3], _mm_alignr_epi8(msg[i & 3], msg[(i - 1) & 3], 4));
+                msg[(i + 1) & 3] = _mm_sha256msg2_epu32(next, msg[i & 3]);
+            }
+            state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(words, 0x0e));
+            if (i >= 1 && i < 13) msg[(i - 1) & 3] = _mm_sha256msg1_epu32(msg[(i - 1) & 3], msg[i & 3]);
+        }
+        state0 = _mm_add_epi32(state0, saved0);
+        state1 = _mm_add_epi32(state1, saved1);
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1b);                                        // FEBA
+    state1 = _mm_shuffle_epi32(state1, 0xb1);                                     // DCHG
+    _mm_storeu_si128((__m128i *)&state[0], _mm_blend_epi16(tmp, state1, 0xf0));   // DCBA
+    _mm_storeu_si128((__m128i *)&state[4], _mm_alignr_epi8(state1, tmp, 8));      // HGFE
+}
+#endif
+
+static void shaCompress(unsigned int state[8], const unsigned char *data, long long blocks) {
+#ifdef MITS_X86_DIGEST
+    if (shaHardware) {
+        shaBlocksNi(state, data, blocks);
+        return;
+    }
+#endif
+    shaBlocks(state, data, blocks);
+}
+
+void sha256(const unsigned char *data, long long len, unsigned char out[SHA_SIZE]) {
+    unsigned int state[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                             0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+    long long whole = len / 64;
+    shaCompress(state, data, whole);
+
+    // The rest, a 1 bit, zeros and the length in bits fill one or two blocks
+    unsigned char tail[128] = {0};
+    int rest = len - whole * 64;
+    memcpy(tail, data + whole * 64, rest);
+    tail[rest] = 0x80;
+    int tailBlocks = rest < 56 ? 1 : 2;
+    writeBig(tail + tailBlocks * 64 - 8, (unsigned long long)len * 8, 8);
+    shaCompress(state, tail, tailBlocks);
+
+    for (int i = 0; i < 8; i++) writeBig(out + i * 4, state[i], 4);
+}
@@ -0,0 +1,27 @@
+#ifndef DIGEST_H
+#define DIGEST_H
+
+// Digests behind buf crc, xxh and sha. CRC32C uses the SSE4.2 crc32
+// instruction and SHA-256 the SHA extensions when the CPU has them; the
+// plain C versions give the same bytes. xxHash64 is plain C everywhere,
+// since it is already built from 64-bit multiplies.
+
+#define CRC_SIZE 4
+#define XXH_SIZE 8
+#define SHA_SIZE 32
+
+// Use the CPU's digest instructions unless level (from selectSimd) is
+// SIMD_SCALAR
+void selectDigests(int level);
+
+// Each writes its digest big-endian, the way the algorithm prints it
+
+// CRC32C (Castagnoli), as used by iSCSI, ext4 and SCTP
+void crc32c(const unsigned char *data, long long len, unsigned char out[CRC_SIZE]);
+
+// xxHash64 with seed 0
+void xxh64(const unsigned char *data, long long len, unsigned char out[XXH_SIZE]);
+
+void sha256(const unsigned char *data, long long len, unsigned char out[SHA_SIZE]);
+
+#endif // DIGEST_H
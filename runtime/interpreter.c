@@ -2,65 +2,94 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <math.h>
 #include <stdint.h>
 #include <unistd.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <signal.h>
+#include "decode.h"
+#include "bytecode.h"
+#include "infer.h"
+#include "verify.h"
+#include "jit.h"
+#include "value.h"
+#include "vector.h"
+#include "bytes.h"
+#include "digest.h"
+#include "text.h"
 
 #define MAX_LINES 1024
 #define MAX_LINE_LENGTH 512
 #define MAX_REGISTERS 256
-#define MAX_FUNCTIONS 128
 #define MAX_ROM_ENTRIES 512
 #define MAX_ARGS 64
+#define MAX_CALL_DEPTH 256
+#define MAX_ARG_STACK 4096
+#define MAX_LOOP_STATES 8192
 #define MAX_IMPORTED_FILES 64
 #define MAX_WASM_PAGES 16
 #define MAX_WASM_ELEMENTS 256
 
-typedef enum {
-    TYPE_NUMBER,
-    TYPE_STRING,
-    TYPE_HEX
-} ValueType;
-
-typedef struct {
-    ValueType type;
-    union {
-        long long numValue;
-        char strValue[512];
-        unsigned char hexValue[256];
-    } data;
-    int hexLen; // for HEX type
-} Value;
-
 typedef struct {
-    char name[64];
     Value value;
+    int defined;
 } Register;
 
 typedef struct {
-    char key[64];
+    char *key;
     Value value;
 } ROMEntry;
 
 typedef struct {
-    char name[64];
-    int startLine;
-    int endLine;
+    int header;         // index of the for instruction running at this depth
+    int slot;           // its index register
+    long long current;
+    long long last;
+} LoopState;
+
+// Calls to DEF_MEMO defs: the registers the body stores, by the ARGUMENTS
+// the call ran with, in a direct-mapped table per def
+#define MEMO_ENTRIES 1024
+#define MEMO_SHIFT 54       // 64 - log2(MEMO_ENTRIES)
+
+typedef struct {
+    int *slots;             // registers the body stores
+    int slotCount;
+    long long *keys;
+    char *filled;
+    long long *values;      // slotCount values per entry
+    long long hits;
+    long long misses;
+} MemoCache;
+
+// One active def call. Arguments and loop states live on contiguous
+// stacks in State, so a call only moves a few indices.
+typedef struct {
+    int returnPc;       // instruction after the call
+    int argBase;        // caller's ARGUMENTS
     int argCount;
-} Function;
+    int loopBase;       // caller's loop states
+    MemoCache *memo;    // cache to fill on return, NULL if none
+    long long memoKey;
+} CallFrame;
 
 typedef struct {
-    Register registers[MAX_REGISTERS];
+    Register *registers;            // indexed by register slot
+    int regCapacity;
+    int regOrder[MAX_REGISTERS];    // slots in the order they were first set
     int regCount;
     ROMEntry romEntries[MAX_ROM_ENTRIES];
     int romCount;
-    Function functions[MAX_FUNCTIONS];
-    int funcCount;
-    long long arguments[MAX_ARGS];
+    long long argStack[MAX_ARG_STACK];
+    int argBase;                    // ARGUMENTS of the running call
     int argCount;
+    int argTop;
+    CallFrame frames[MAX_CALL_DEPTH];
+    int frameCount;
+    LoopState loopStack[MAX_LOOP_STATES];
+    int loopTop;
     int exitCode;
     int shouldExit;
 } State;
@@ -90,8 +119,50 @@ typedef struct {
 
 State state;
 WasmState wasmState = {0};
-char lines[MAX_LINES][MAX_LINE_LENGTH];
-int lineCount = 0;
+Program program;
+
+// --jit: compiled for loops by header index; jitTried marks headers already
+// looked at so a loop the JIT cannot handle is only examined once
+int jitEnabled = 0;
+JitLoop **jitLoops = NULL;
+char *jitTried = NULL;
+int jitCapacity = 0;
+
+// --profile-ops: how often each opcode pair and triple ran back to back,
+// counting only instructions reached without a jump
+typedef struct {
+    const char *path;
+    long long *pairs;       // [first][second]
+    long long *triples;     // [first][second][third]
+    int lastPc;
+    int last;               // opcodes of the two instructions before, -1
+    int beforeLast;         // when a jump came in between
+} OpProfile;
+
+OpProfile opProfile = {NULL, NULL, NULL, -2, -1, -1};
+
+// --write-profile: per-instruction run counts, how often each cond took
+// its then-branch, and the T_* types its registers held (see infer.h)
+typedef struct {
+    const char *path;
+    int size;               // instructions of the main program
+    long long *counts;
+    long long *taken;
+    unsigned char *types;
+    int lastCond;           // cond that just ran, -1 if none
+    int condSkip;           // where that cond jumps when false
+} ExecProfile;
+
+ExecProfile execProfile = {NULL, 0, NULL, NULL, NULL, -1, 0};
+
+// Indexed by def instruction, created by the def's first call
+MemoCache **memoCaches = NULL;
+int memoCapacity = 0;
+int memoStats = 0;          // --memo-stats
+
+// --simd: the widest SIMD level the vec and buf kernels may use; scalar
+// also turns off the crc32 and SHA instructions behind the buf digests
+int simdLimit = SIMD_AVX2;
 
 void handleSignal(int sig) {
     if (sig == SIGINT) {
@@ -112,64 +183,91 @@ void trimWhitespace(char *str) {
     }
 }
 
-void stripComments(char *str) {
-    char *comment = strchr(str, ';');
-    if (comment) {
-        *comment = '\0';
-    }
-    trimWhitespace(str);
-}
-
-char *getFirstWord(char *str, char *word) {
-    int i = 0;
-    while (*str && !isspace(*str) && *str != ',' && i < 63) {
-        word[i++] = *str++;
+// Store value in a register slot; the register takes over the reference
+void addRegister(int slot, Value value) {
+    if (slot >= state.regCapacity) {
+        int capacity = state.regCapacity ? state.regCapacity : 64;
+        while (capacity <= slot) capacity *= 2;
+        Register *registers = realloc(state.registers, capacity * sizeof(Register));
+        if (!registers) return;
+        memset(registers + state.regCapacity, 0, (capacity - state.regCapacity) * sizeof(Register));
+        state.registers = registers;
+        state.regCapacity = capacity;
     }
-    word[i] = '\0';
-    while (*str && (isspace(*str) || *str == ',')) str++;
-    return str;
-}
 
-void addRegister(const char *name, Value value) {
-    for (int i = 0; i < state.regCount; i++) {
-        if (strcmp(state.registers[i].name, name) == 0) {
-            state.registers[i].value = value;
+    Register *reg = &state.registers[slot];
+    if (!reg->defined) {
+        if (state.regCount >= MAX_REGISTERS) {
+            releaseValue(value);
             return;
         }
+        reg->defined = 1;
+        state.regOrder[state.regCount++] = slot;
+    } else {
+        releaseValue(reg->value);
     }
-    if (state.regCount < MAX_REGISTERS) {
-        strcpy(state.registers[state.regCount].name, name);
-        state.registers[state.regCount].value = value;
-        state.regCount++;
-    }
+    reg->value = value;
 }
 
-Register *getRegister(const char *name) {
-    for (int i = 0; i < state.regCount; i++) {
-        if (strcmp(state.registers[i].name, name) == 0) {
-            return &state.registers[i];
-        }
-    }
-    return NULL;
+Register *getRegister(int slot) {
+    if (slot < 0 || slot >= state.regCapacity || !state.registers[slot].defined) return NULL;
+    return &state.registers[slot];
 }
 
 int addROMEntry(const char *key, Value value) {
     if (state.romCount < MAX_ROM_ENTRIES) {
-        strcpy(state.romEntries[state.romCount].key, key);
+        state.romEntries[state.romCount].key = strdup(key);
         state.romEntries[state.romCount].value = value;
         state.romCount++;
         return 0;
     }
+    releaseValue(value);
     return -1;
 }
 
-ROMEntry *getROMEntry(const char *key) {
+// Index of the first ROM entry with key, -1 if there is none
+int findROMEntry(const char *key) {
     for (int i = 0; i < state.romCount; i++) {
         if (strcmp(state.romEntries[i].key, key) == 0) {
-            return &state.romEntries[i];
+            return i;
         }
     }
-    return NULL;
+    return -1;
+}
+
+ROMEntry *getROMEntry(const char *key) {
+    int index = findROMEntry(key);
+    return index >= 0 ? &state.romEntries[index] : NULL;
+}
+
+// rom= operands bound to their entries by operand index, -1 while the key
+// is missing. Entries are only appended and the first one with a key wins,
+// so a bound operand stays bound; only missing keys are looked up again,
+// and only after an import added entries.
+int *romBindings = NULL;
+int romBindingCount = 0;
+
+// Bind the rom= operands decoded since the last call
+void bindROMOperands(void) {
+    if (program.operandCount <= romBindingCount) return;
+    int *grown = realloc(romBindings, program.operandCount * sizeof(int));
+    if (!grown) {
+        fprintf(stderr, "Error: Out of memory while binding ROM keys\n");
+        exit(1);
+    }
+    romBindings = grown;
+    for (int i = romBindingCount; i < program.operandCount; i++) {
+        const Operand *op = &program.operands[i];
+        romBindings[i] = op->kind == OPD_ROM ? findROMEntry(poolText(&program, op->ref)) : -1;
+    }
+    romBindingCount = program.operandCount;
+}
+
+void rebindMissingROM(void) {
+    for (int i = 0; i < romBindingCount; i++) {
+        const Operand *op = &program.operands[i];
+        if (op->kind == OPD_ROM && romBindings[i] < 0) romBindings[i] = findROMEntry(poolText(&program, op->ref));
+    }
 }
 
 void parseROMFile(const char *filename);
@@ -213,14 +311,12 @@ void parseROMFile(const char *filename) {
 
             Value v;
             if (val[0] == '"') {
-                v.type = TYPE_STRING;
                 val++;
                 char *endQuote = strchr(val, '"');
                 if (endQuote) *endQuote = '\0';
-                strncpy(v.data.strValue, val, 511);
+                v = makeString(val, strlen(val));
             } else {
-                v.type = TYPE_NUMBER;
-                v.data.numValue = strtoll(val, NULL, 10);
+                v = makeNumber(strtoll(val, NULL, 10));
             }
             addROMEntry(key, v);
         }
@@ -228,57 +324,32 @@ void parseROMFile(const char *filename) {
     fclose(f);
 }
 
-Value parseValue(const char *str);
-
-int isValidVarName(const char *name) {
-    if (strlen(name) != 3) {
-        fprintf(stderr, "Error: Variable names must be exactly 3 letters, got '%s' (%zu letters)\n", name, strlen(name));
-        return 0;
-    }
-    for (int i = 0; i < 3; i++) {
-        if (!isalpha(name[i])) {
-            fprintf(stderr, "Error: Variable names must contain only letters, got '%s'\n", name);
-            return 0;
-        }
-    }
-    return 1;
+Value stringToHex(const char *str) {
+    return makeHex((const unsigned char *)str, strlen(str));
 }
 
-Value stringToHex(const char *str) {
-    Value v;
-    v.type = TYPE_HEX;
-    v.hexLen = 0;
-    while (*str && v.hexLen < 256) {
-        v.data.hexValue[v.hexLen++] = (unsigned char)*str++;
-    }
-    return v;
+Value hexToString(Value hex) {
+    long long len = valueLength(hex);
+    return makeString(valueText(hex), len < MAX_STRING_LENGTH ? (int)len : MAX_STRING_LENGTH);
 }
 
-Value hexToString(const Value *hex) {
-    Value v;
-    v.type = TYPE_STRING;
-    int len = hex->hexLen < 511 ? hex->hexLen : 511;
-    memcpy(v.data.strValue, hex->data.hexValue, len);
-    v.data.strValue[len] = '\0';
-    return v;
+// The first MAX_STRING_LENGTH bytes of a text
+Value textToString(const Text *text) {
+    char bytes[MAX_STRING_LENGTH];
+    return makeString(bytes, flattenText(text, (unsigned char *)bytes, sizeof(bytes)));
 }
 
-Value hexToInt(const Value *hex) {
-    Value v;
-    v.type = TYPE_NUMBER;
-    v.data.numValue = 0;
+Value hexToInt(Value hex) {
+    long long num = 0;
+    const unsigned char *bytes = valueBytes(hex);
     // Convert hex bytes to integer (big-endian)
-    for (int i = 0; i < hex->hexLen && i < 8; i++) {
-        v.data.numValue = (v.data.numValue << 8) | hex->data.hexValue[i];
+    for (unsigned int i = 0; i < hex.len && i < 8; i++) {
+        num = (num << 8) | bytes[i];
     }
-    return v;
+    return makeNumber(num);
 }
 
 Value intToHex(long long num) {
-    Value v;
-    v.type = TYPE_HEX;
-    v.hexLen = 0;
-    
     // Convert integer to hex bytes (big-endian)
     unsigned char bytes[8];
     for (int i = 7; i >= 0; i--) {
@@ -286,201 +357,478 @@ Value intToHex(long long num) {
         num >>= 8;
     }
     
-    // Skip leading zeros
+    // Skip leading zeros, keeping at least one byte
     int start = 0;
     while (start < 7 && bytes[start] == 0) start++;
     
-    v.hexLen = 8 - start;
-    memcpy(v.data.hexValue, bytes + start, v.hexLen);
-    
-    if (v.hexLen == 0) {
-        v.hexLen = 1;
-        v.data.hexValue[0] = 0;
-    }
-    
-    return v;
+    return makeHex(bytes + start, 8 - start);
 }
 
-Value parseValue(const char *str) {
-    Value v;
-    char word[64];
-    strcpy(word, str);
-    trimWhitespace(word);
-
-    // Check for rom=key
-    if (strncmp(word, "rom=", 4) == 0) {
-        ROMEntry *entry = getROMEntry(word + 4);
-        if (entry) return entry->value;
-        v.type = TYPE_NUMBER;
-        v.data.numValue = 0;
-        return v;
-    }
+const char *slotName(int slot) {
+    return poolText(&program, program.names[slot]);
+}
 
-    // Check for code=N
-    if (strncmp(word, "code=", 5) == 0) {
-        v.type = TYPE_NUMBER;
-        v.data.numValue = strtoll(word + 5, NULL, 10);
-        return v;
+// Evaluate an operand; the caller owns the returned reference
+Value evalOperand(const Operand *op) {
+    Register *reg;
+
+    switch (op->kind) {
+    case OPD_ROM: {
+        int index = op - program.operands;
+        int entry = index >= 0 && index < romBindingCount ? romBindings[index]
+                                                          : findROMEntry(poolText(&program, op->ref));
+        if (entry >= 0) return retainValue(state.romEntries[entry].value);
+        break;
     }
 
-    // Check for hex=register
-    if (strncmp(word, "hex=", 4) == 0) {
-        Register *reg = getRegister(word + 4);
+    case OPD_HEX:
+        reg = getRegister(op->ref);
         if (reg && reg->value.type == TYPE_STRING) {
-            return stringToHex(reg->value.data.strValue);
+            return stringToHex(valueText(reg->value));
         }
-        v.type = TYPE_HEX;
-        v.hexLen = 0;
-        return v;
-    }
-
-    // Check for b31 register (hex to string)
-    if (strncmp(word, "b31 ", 4) == 0) {
-        Register *reg = getRegister(word + 4);
-        if (reg && reg->value.type == TYPE_HEX) {
-            return hexToString(&reg->value);
-        }
-        v.type = TYPE_STRING;
-        strcpy(v.data.strValue, "");
-        return v;
-    }
+        return makeHex(NULL, 0);
 
-    // Check for b32 register (hex to int)
-    if (strncmp(word, "b32 ", 4) == 0) {
-        Register *reg = getRegister(word + 4);
+    case OPD_B31:
+        reg = getRegister(op->ref);
         if (reg && reg->value.type == TYPE_HEX) {
-            return hexToInt(&reg->value);
+            return hexToString(reg->value);
         }
-        v.type = TYPE_NUMBER;
-        v.data.numValue = 0;
-        return v;
-    }
+        return makeString("", 0);
 
-    // Check for i32 register (hex to int - same as b32)
-    if (strncmp(word, "i32 ", 4) == 0) {
-        Register *reg = getRegister(word + 4);
+    case OPD_B32:
+        reg = getRegister(op->ref);
         if (reg && reg->value.type == TYPE_HEX) {
-            return hexToInt(&reg->value);
+            return hexToInt(reg->value);
         }
-        v.type = TYPE_NUMBER;
-        v.data.numValue = 0;
-        return v;
-    }
+        break;
 
-    // Check for c26 register (convert to character/string data)
-    if (strncmp(word, "c26 ", 4) == 0) {
-        Register *reg = getRegister(word + 4);
+    case OPD_C26:
+        reg = getRegister(op->ref);
         if (reg) {
             if (reg->value.type == TYPE_NUMBER) {
                 // Convert number to string
-                v.type = TYPE_STRING;
-                snprintf(v.data.strValue, sizeof(v.data.strValue), "%lld", reg->value.data.numValue);
-                return v;
+                char text[32];
+                int len = snprintf(text, sizeof(text), "%lld", reg->value.data.numValue);
+                return makeString(text, len);
+            } else if (reg->value.type == TYPE_FLOAT) {
+                char text[64];
+                int len = snprintf(text, sizeof(text), "%.2f", reg->value.data.floatValue);
+                return makeString(text, len);
             } else if (reg->value.type == TYPE_HEX) {
-                return hexToString(&reg->value);
+                return hexToString(reg->value);
+            } else if (reg->value.type == TYPE_TEXT) {
+                return textToString(reg->value.data.text);
             }
-            return reg->value;
+            return retainValue(reg->value);
         }
-        v.type = TYPE_STRING;
-        strcpy(v.data.strValue, "");
-        return v;
-    }
+        return makeString("", 0);
 
-    // Check for UTF register (UTF-8 conversion - same as string for now)
-    if (strncmp(word, "UTF ", 4) == 0) {
-        Register *reg = getRegister(word + 4);
+    case OPD_UTF:
+        reg = getRegister(op->ref);
         if (reg) {
             if (reg->value.type == TYPE_HEX) {
-                return hexToString(&reg->value);
+                return hexToString(reg->value);
             }
-            return reg->value;
+            return retainValue(reg->value);
         }
-        v.type = TYPE_STRING;
-        strcpy(v.data.strValue, "");
-        return v;
-    }
-
-    // Check for flt register (floating point - store as string representation)
-    if (strncmp(word, "flt ", 4) == 0) {
-        Register *reg = getRegister(word + 4);
-        if (reg && reg->value.type == TYPE_NUMBER) {
-            v.type = TYPE_STRING;
-            double fltVal = (double)reg->value.data.numValue;
-            snprintf(v.data.strValue, sizeof(v.data.strValue), "%.2f", fltVal);
-            return v;
+        return makeString("", 0);
+
+    case OPD_FLT:
+        // Numbers become floats, floats stay, anything else is 0.0
+        reg = getRegister(op->ref);
+        if (reg && isNumeric(reg->value)) return makeFloat(floatOf(reg->value));
+        return makeFloat(0);
+
+    case OPD_FLOAT:
+        return makeFloat(floatLiteral(op));
+
+    case OPD_ARGUMENTS: {
+        long long sum = 0;
+        for (int i = 0; i < state.argCount; i++) sum += state.argStack[state.argBase + i];
+        return makeNumber(sum);
+    }
+
+    case OPD_REGISTER:
+        reg = getRegister(op->ref);
+        if (reg) return retainValue(reg->value);
+        return makeNumber(op->num);
+
+    case OPD_NUMBER:
+        return makeNumber(op->num);
+    }
+
+    return makeNumber(0);
+}
+
+// Numeric value of an operand without touching any string storage
+long long evalNumber(const Operand *op) {
+    if (op->kind == OPD_NUMBER) return op->num;
+    if (op->kind == OPD_REGISTER) {
+        Register *reg = getRegister(op->ref);
+        return reg ? numberOf(reg->value) : op->num;
+    }
+
+    Value v = evalOperand(op);
+    long long num = numberOf(v);
+    releaseValue(v);
+    return num;
+}
+
+// Integer arithmetic shared by expressions: wraps on overflow, and
+// division or modulo by zero gives 0
+long long applyOperator(int kind, long long l, long long r) {
+    switch (kind) {
+    case OPD_ADD: return (long long)((unsigned long long)l + (unsigned long long)r);
+    case OPD_SUB: return (long long)((unsigned long long)l - (unsigned long long)r);
+    case OPD_MUL: return (long long)((unsigned long long)l * (unsigned long long)r);
+    case OPD_DIV:
+        if (r == 0) return 0;
+        if (r == -1) return (long long)(0ULL - (unsigned long long)l);
+        return l / r;
+    case OPD_MOD:
+        if (r == 0 || r == -1) return 0;
+        return l % r;
+    }
+    return 0;
+}
+
+// Float arithmetic for expressions that meet a float: division or modulo
+// by zero gives 0 like the integer form
+double applyFloatOperator(int kind, double l, double r) {
+    switch (kind) {
+    case OPD_ADD: return l + r;
+    case OPD_SUB: return l - r;
+    case OPD_MUL: return l * r;
+    case OPD_DIV: return r == 0 ? 0 : l / r;
+    case OPD_MOD: return r == 0 ? 0 : fmod(l, r);
+    }
+    return 0;
+}
+
+// Operand as arithmetic sees it: numbers and floats as they are, anything
+// else as the number 0
+Value evalArithmetic(const Operand *op) {
+    if (op->kind == OPD_NUMBER) return makeNumber(op->num);
+    if (op->kind == OPD_REGISTER) {
+        Register *reg = getRegister(op->ref);
+        if (!reg) return makeNumber(op->num);
+        return isNumeric(reg->value) ? reg->value : makeNumber(0);
+    }
+
+    Value v = evalOperand(op);
+    if (isNumeric(v)) return v;
+    releaseValue(v);
+    return makeNumber(0);
+}
+
+// Evaluate the postfix expression in operands first..argc-1 for a generic
+// store: integer arithmetic while every input is a number, float
+// arithmetic from the first float on
+Value evaluateValue(const Instr *in, int first) {
+    const Operand *ops = operandAt(&program, in, first);
+    int count = in->argc - first;
+    if (count <= 1) return count == 1 ? evalArithmetic(ops) : makeNumber(0);
+
+    Value small[32];
+    Value *stack = count <= 32 ? small : malloc(count * sizeof(Value));
+    if (!stack) {
+        fprintf(stderr, "Error: Out of memory\n");
+        exit(1);
+    }
+    int top = 0;
+    for (int i = 0; i < count; i++) {
+        const Operand *op = &ops[i];
+        if (op->kind == OPD_NEG) {
+            Value v = stack[top - 1];
+            stack[top - 1] = v.type == TYPE_FLOAT ? makeFloat(-v.data.floatValue)
+                                                  : makeNumber((long long)(0ULL - (unsigned long long)v.data.numValue));
+        } else if (op->kind >= OPD_ADD) {
+            Value l = stack[top - 2], r = stack[top - 1];
+            top--;
+            if (l.type == TYPE_NUMBER && r.type == TYPE_NUMBER) {
+                stack[top - 1] = makeNumber(applyOperator(op->kind, l.data.numValue, r.data.numValue));
+            } else {
+                stack[top - 1] = makeFloat(applyFloatOperator(op->kind, floatOf(l), floatOf(r)));
+            }
+        } else {
+            stack[top++] = evalArithmetic(op);
+        }
+    }
+    Value result = top > 0 ? stack[0] : makeNumber(0);
+    if (stack != small) free(stack);
+    return result;
+}
+
+// Evaluate the postfix expression in operands first..argc-1
+long long evaluateExpression(const Instr *in, int first) {
+    const Operand *ops = operandAt(&program, in, first);
+    int count = in->argc - first;
+    if (count <= 1) return count == 1 ? evalNumber(ops) : 0;
+
+    long long small[32];
+    long long *stack = count <= 32 ? small : malloc(count * sizeof(long long));
+    if (!stack) {
+        fprintf(stderr, "Error: Out of memory\n");
+        exit(1);
+    }
+    int top = 0;
+    for (int i = 0; i < count; i++) {
+        const Operand *op = &ops[i];
+        if (op->kind == OPD_NEG) {
+            stack[top - 1] = (long long)(0ULL - (unsigned long long)stack[top - 1]);
+        } else if (op->kind >= OPD_ADD) {
+            top--;
+            stack[top - 1] = applyOperator(op->kind, stack[top - 1], stack[top]);
+        } else {
+            stack[top++] = evalNumber(op);
         }
-        v.type = TYPE_STRING;
-        strcpy(v.data.strValue, "0.00");
-        return v;
     }
+    long long result = top > 0 ? stack[0] : 0;
+    if (stack != small) free(stack);
+    return result;
+}
+
+void recordOp(int pc, int op) {
+    OpProfile *p = &opProfile;
+    if (pc == p->lastPc + 1 && p->last >= 0) {
+        p->pairs[p->last * OP_COUNT + op]++;
+        if (p->beforeLast >= 0) p->triples[(p->beforeLast * OP_COUNT + p->last) * OP_COUNT + op]++;
+        p->beforeLast = p->last;
+    } else {
+        p->beforeLast = -1;
+    }
+    p->last = op;
+    p->lastPc = pc;
+}
 
-    // Check if it's a register name
-    Register *reg = getRegister(word);
-    if (reg) return reg->value;
+int typeBits(int slot) {
+    Register *reg = getRegister(slot);
+    if (!reg || reg->value.type == TYPE_NUMBER) return T_NUMBER;
+    if (reg->value.type == TYPE_FLOAT) return T_FLOAT;
+    if (reg->value.type == TYPE_VECTOR) return T_VECTOR;
+    if (reg->value.type == TYPE_TEXT) return T_TEXT;
+    return reg->value.type == TYPE_STRING ? T_STRING : T_HEX;
+}
 
-    // Check for special values
-    if (strcmp(word, "ARGUMENTS") == 0) {
-        v.type = TYPE_NUMBER;
-        long long sum = 0;
-        for (int i = 0; i < state.argCount; i++) sum += state.arguments[i];
-        v.data.numValue = sum;
-        return v;
+void recordInstr(int pc, const Instr *in) {
+    ExecProfile *p = &execProfile;
+    if (p->lastCond >= 0) {
+        if (pc != p->condSkip) p->taken[p->lastCond]++;
+        p->lastCond = -1;
     }
+    if (pc >= p->size) return;
 
-    // Try to parse as number
-    v.type = TYPE_NUMBER;
-    v.data.numValue = strtoll(word, NULL, 10);
-    return v;
+    p->counts[pc]++;
+    int op = baseOp(in);
+    if (op == OP_COND || op == OP_TEST) {
+        p->lastCond = pc;
+        p->condSkip = (in->alt >= 0 ? in->alt : in->target) + 1;
+    }
+    for (int k = 0; k < in->argc; k++) {
+        const Operand *arg = operandAt(&program, in, k);
+        if (arg->ref >= 0 && arg->kind != OPD_ROM && arg->kind != OPD_TEXT) p->types[pc] |= typeBits(arg->ref);
+    }
+    if (in->dest >= 0 && op != OP_CALL && op != OP_DEF) p->types[pc] |= typeBits(in->dest);
 }
 
-long long evaluateExpression(const char *expr) {
-    char *plus = strchr(expr, '+');
-    char *minus = strchr(expr, '-');
-    
-    // Find the operator
-    char *op = NULL;
-    char opChar = 0;
-    
-    if (plus && (!minus || plus < minus)) {
-        op = plus;
-        opChar = '+';
-    } else if (minus && (!plus || minus < plus)) {
-        op = minus;
-        opChar = '-';
+// Every instruction passes through here first while a profile is recorded
+void recordDispatch(int pc, const Instr *in) {
+    if (opProfile.path) recordOp(pc, in->op);
+    if (execProfile.path) recordInstr(pc, in);
+}
+
+// Write "index line count taken types" for every instruction that ran
+void writeExecProfile(void) {
+    FILE *f = fopen(execProfile.path, "w");
+    if (!f) {
+        fprintf(stderr, "Error: Cannot write profile '%s'\n", execProfile.path);
+        return;
+    }
+    fprintf(f, "# mits-interp --write-profile: index line count taken types\n");
+    for (int i = 0; i < execProfile.size; i++) {
+        if (execProfile.counts[i] == 0) continue;
+        fprintf(f, "%d %d %lld %lld %d\n", i, program.code[i].line, execProfile.counts[i],
+                execProfile.taken[i], execProfile.types[i]);
+    }
+    fclose(f);
+}
+
+typedef struct {
+    long long count;
+    int ops[3];
+    int length;
+} OpSequence;
+
+int compareSequences(const void *a, const void *b) {
+    long long x = ((const OpSequence *)a)->count, y = ((const OpSequence *)b)->count;
+    return x < y ? 1 : x > y ? -1 : 0;
+}
+
+// Write the profile as "<count> <op> <op> [<op>]" lines, hottest first
+void writeOpProfile(void) {
+    int pairCount = OP_COUNT * OP_COUNT;
+    int total = pairCount + pairCount * OP_COUNT;
+    OpSequence *list = malloc(total * sizeof(OpSequence));
+    FILE *f = fopen(opProfile.path, "w");
+    if (!list || !f) {
+        fprintf(stderr, "Error: Cannot write op profile '%s'\n", opProfile.path);
+        free(list);
+        if (f) fclose(f);
+        return;
+    }
+
+    int count = 0;
+    for (int i = 0; i < total; i++) {
+        long long n = i < pairCount ? opProfile.pairs[i] : opProfile.triples[i - pairCount];
+        if (n == 0) continue;
+        OpSequence *seq = &list[count++];
+        seq->count = n;
+        if (i < pairCount) {
+            seq->length = 2;
+            seq->ops[0] = i / OP_COUNT;
+            seq->ops[1] = i % OP_COUNT;
+        } else {
+            int t = i - pairCount;
+            seq->length = 3;
+            seq->ops[0] = t / pairCount;
+            seq->ops[1] = t / OP_COUNT % OP_COUNT;
+            seq->ops[2] = t % OP_COUNT;
+        }
     }
+    qsort(list, count, sizeof(OpSequence), compareSequences);
 
-    if (!op) {
-        Value v = parseValue(expr);
-        return v.data.numValue;
+    fprintf(f, "# mits-interp --profile-ops: count, then the opcodes that ran back to back\n");
+    for (int i = 0; i < count; i++) {
+        fprintf(f, "%lld", list[i].count);
+        for (int k = 0; k < list[i].length; k++) fprintf(f, " %s", opName(list[i].ops[k]));
+        fprintf(f, "\n");
     }
+    fclose(f);
+    free(list);
+}
+
+// Operand the optimizer proved to be a number literal or a register that
+// only ever holds numbers
+long long numberAt(const Operand *op) {
+    if (op->kind == OPD_NUMBER) return op->num;
+    Register *reg = getRegister(op->ref);
+    return reg ? reg->value.data.numValue : op->num;
+}
 
-    char left[256], right[256];
-    strncpy(left, expr, op - expr);
-    left[op - expr] = '\0';
-    strcpy(right, op + 1);
+// Value of a number-only expression in operands first..argc-1, with the
+// usual shapes done inline
+long long calculate(const Instr *in, int first) {
+    const Operand *ops = operandAt(&program, in, first);
+    int count = in->argc - first;
+    if (count == 1) return numberAt(ops);
+    if (count == 3 && ops[2].kind != OPD_NEG) return applyOperator(ops[2].kind, numberAt(&ops[0]), numberAt(&ops[1]));
+    return evaluateExpression(in, first);
+}
+
+// Store a number into a register that is undefined or holds a number
+void storeNumber(int slot, long long value) {
+    Register *reg = getRegister(slot);
+    if (reg) reg->value.data.numValue = value;
+    else addRegister(slot, makeNumber(value));
+}
 
-    trimWhitespace(left);
-    trimWhitespace(right);
+MemoCache *memoFor(int def) {
+    if (def >= memoCapacity) return NULL;
+    if (memoCaches[def]) return memoCaches[def];
+
+    const Instr *head = &program.code[def];
+    MemoCache *memo = calloc(1, sizeof(MemoCache));
+    int *slots = malloc((head->target - def) * sizeof(int));
+    if (!memo || !slots) {
+        free(memo);
+        free(slots);
+        return NULL;
+    }
+    for (int i = def + 1; i < head->target; i++) {
+        const Instr *in = &program.code[i];
+        int slot = in->dest;
+        if (slot < 0 || in->op == OP_NOP) continue;
+        int seen = 0;
+        for (int k = 0; k < memo->slotCount && !seen; k++) seen = slots[k] == slot;
+        if (!seen) slots[memo->slotCount++] = slot;
+    }
+    memo->slots = slots;
+    memo->keys = malloc(MEMO_ENTRIES * sizeof(long long));
+    memo->filled = calloc(MEMO_ENTRIES, 1);
+    memo->values = malloc((size_t)MEMO_ENTRIES * (memo->slotCount + 1) * sizeof(long long));
+    if (!memo->keys || !memo->filled || !memo->values) {
+        fprintf(stderr, "Error: Out of memory for the call cache\n");
+        exit(1);
+    }
+    memoCaches[def] = memo;
+    return memo;
+}
 
-    long long lval = evaluateExpression(left);
-    long long rval = evaluateExpression(right);
+int memoEntry(long long key) {
+    return (int)(((unsigned long long)key * 0x9E3779B97F4A7C15ULL) >> MEMO_SHIFT);
+}
 
-    return opChar == '+' ? lval + rval : lval - rval;
+// Replay a cached call: 1 if key was cached and its registers are stored
+int recallCall(MemoCache *memo, long long key) {
+    int entry = memoEntry(key);
+    if (!memo->filled[entry] || memo->keys[entry] != key) {
+        memo->misses++;
+        return 0;
+    }
+    const long long *values = memo->values + (size_t)entry * memo->slotCount;
+    for (int k = 0; k < memo->slotCount; k++) {
+        Register *reg = getRegister(memo->slots[k]);
+        if (reg && reg->value.type == TYPE_NUMBER) reg->value.data.numValue = values[k];
+        else addRegister(memo->slots[k], makeNumber(values[k]));
+    }
+    memo->hits++;
+    return 1;
 }
 
-int findMatchingEnd(int startLine) {
-    int depth = 1;
-    for (int i = startLine + 1; i < lineCount; i++) {
-        char word[64];
-        getFirstWord(lines[i], word);
-        if (strcmp(word, "for") == 0 || strcmp(word, "def") == 0 || strcmp(word, "cond") == 0) {
-            depth++;
-        } else if (strcmp(word, "end") == 0) {
-            depth--;
-            if (depth == 0) return i;
+// Cache the registers a call just stored; a call that left anything but
+// numbers (or ran out of registers) is not cached
+void rememberCall(MemoCache *memo, long long key) {
+    int entry = memoEntry(key);
+    long long *values = memo->values + (size_t)entry * memo->slotCount;
+    for (int k = 0; k < memo->slotCount; k++) {
+        Register *reg = getRegister(memo->slots[k]);
+        if (!reg || reg->value.type != TYPE_NUMBER) {
+            memo->filled[entry] = 0;
+            return;
         }
+        values[k] = reg->value.data.numValue;
     }
-    return -1;
+    memo->keys[entry] = key;
+    memo->filled[entry] = 1;
+}
+
+void writeMemoStats(void) {
+    for (int i = 0; i < memoCapacity; i++) {
+        const MemoCache *memo = memoCaches[i];
+        if (!memo) continue;
+        fprintf(stderr, "memo %s: %lld hits, %lld misses\n", slotName(program.code[i].dest), memo->hits,
+                memo->misses);
+    }
+}
+
+// OP_CALC: the register never holds anything but a number, so it is
+// updated in place
+void storeCalc(const Instr *in) {
+    storeNumber(in->dest, calculate(in, 0));
+}
+
+// Guard of OP_GCALC and OP_GTEST: every register the instruction names is
+// undefined or holds a number
+int holdsNumbers(const Instr *in) {
+    Register *reg = getRegister(in->dest);
+    if (reg && reg->value.type != TYPE_NUMBER) return 0;
+    const Operand *args = operandAt(&program, in, 0);
+    for (int k = 0; k < in->argc; k++) {
+        if (args[k].kind != OPD_REGISTER) continue;
+        reg = getRegister(args[k].ref);
+        if (reg && reg->value.type != TYPE_NUMBER) return 0;
+    }
+    return 1;
 }
 
 // WebAssembly helper functions
@@ -620,916 +968,1387 @@ void startWebServer(int port) {
     close(serverSocket);
 }
 
-void executeProgram(int startLine, int endLine);
-
-void executeInstruction(const char *line) {
-    if (state.shouldExit) return;
-    if (strlen(line) == 0 || line[0] == ';') return;
 
-    char lineCopy[MAX_LINE_LENGTH];
-    strcpy(lineCopy, line);
-    stripComments(lineCopy);
-    
-    if (strlen(lineCopy) == 0) return;
-
-    char instruction[64];
-    char *remaining = getFirstWord(lineCopy, instruction);
-
-    if (strcmp(instruction, "mov") == 0) {
-        char dest[64], temp[256];
-        remaining = getFirstWord(remaining, dest);
-        if (!isValidVarName(dest)) return;
-        strcpy(temp, remaining);
-        Value val = parseValue(temp);
-        addRegister(dest, val);
+void printVector(const Vector *vector) {
+    printf("[");
+    for (int i = 0; i < vector->count; i++) {
+        if (i > 0) printf(", ");
+        if (vector->isFloat) printf("%.2f", vector->data.floats[i]);
+        else printf("%lld", vector->data.ints[i]);
     }
+    printf("]");
+}
 
-    else if (strcmp(instruction, "rdl") == 0) {
-        // Parse flags: rdl [-i|-f|-s] <dest>
-        char flag[64] = "";
-        char dest[64];
-        
-        // Check if there's a flag
-        if (remaining[0] == '-') {
-            remaining = getFirstWord(remaining, flag);
-        }
-        
-        remaining = getFirstWord(remaining, dest);
-        if (!isValidVarName(dest)) return;
-        
-        char buffer[512];
-        if (fgets(buffer, sizeof(buffer), stdin) != NULL) {
-            // Remove newline if present
-            int len = strlen(buffer);
-            if (len > 0 && buffer[len-1] == '\n') {
-                buffer[len-1] = '\0';
-            }
-            
-            Value v;
-            
-            if (strcmp(flag, "-i") == 0) {
-                // Read as integer
-                v.type = TYPE_NUMBER;
-                v.data.numValue = strtoll(buffer, NULL, 10);
-            } else if (strcmp(flag, "-f") == 0) {
-                // Read as float (store as string with float formatting)
-                double fval = strtod(buffer, NULL);
-                v.type = TYPE_STRING;
-                snprintf(v.data.strValue, sizeof(v.data.strValue), "%.2f", fval);
+void printText(const Text *text) {
+    printf("\"");
+    writeText(text, stdout);
+    printf("\"");
+}
+
+void printRegisterList(int hasHxd) {
+    for (int i = 0; i < state.regCount; i++) {
+        int slot = state.regOrder[i];
+        Value v = state.registers[slot].value;
+        printf("%s: ", slotName(slot));
+        if (v.type == TYPE_NUMBER) {
+            printf("%lld", v.data.numValue);
+        } else if (v.type == TYPE_FLOAT) {
+            printf("%.2f", v.data.floatValue);
+        } else if (v.type == TYPE_STRING) {
+            if (hasHxd) {
+                printf("\"");
+                for (int j = 0; valueText(v)[j]; j++) {
+                    printf("%02x ", valueBytes(v)[j]);
+                }
+                printf("\"");
             } else {
-                // Default or -s: read as string
-                v.type = TYPE_STRING;
-                strncpy(v.data.strValue, buffer, 511);
+                printf("\"%s\"", valueText(v));
             }
-            
-            addRegister(dest, v);
-        }
-    }
-
-    else if (strcmp(instruction, "char") == 0) {
-        char dest[64], temp[256];
-        remaining = getFirstWord(remaining, dest);
-        if (!isValidVarName(dest)) return;
-        
-        char *start = strchr(remaining, '"');
-        if (start) {
-            start++;
-            char *end = strchr(start, '"');
-            if (end) {
-                *end = '\0';
-                Value v;
-                v.type = TYPE_STRING;
-                strncpy(v.data.strValue, start, 511);
-                addRegister(dest, v);
+        } else if (v.type == TYPE_HEX) {
+            printf("[HEX] ");
+            for (long long j = 0; j < valueLength(v); j++) {
+                printf("%02x ", valueBytes(v)[j]);
             }
+        } else if (v.type == TYPE_VECTOR) {
+            printVector(v.data.vector);
+        } else if (v.type == TYPE_TEXT) {
+            printText(v.data.text);
         }
+        printf("\n");
     }
+}
 
-    else if (strcmp(instruction, "addr") == 0) {
-        char dest[64], expr[256];
-        remaining = getFirstWord(remaining, dest);
-        if (!isValidVarName(dest)) return;
-        strcpy(expr, remaining);
+void executeRead(const Instr *in) {
+    // Decoded form: read -lt [-a] [-hxd] [adr|rom] [args...]
+    if (!(in->mode & READ_LT)) return;
 
-        char *plus = strchr(expr, '+');
-        int isHexConcat = 0;
-        
-        // Check if we're concatenating hex by examining the operands
-        if (plus) {
-            char left[256], right[256];
-            strncpy(left, expr, plus - expr);
-            left[plus - expr] = '\0';
-            strcpy(right, plus + 1);
-            
-            trimWhitespace(left);
-            trimWhitespace(right);
-            
-            Value lval = parseValue(left);
-            Value rval = parseValue(right);
-            
-            // Debug: print what we're working with
-            // printf("DEBUG: addr parsing left='%s' (type=%d, hexLen=%d), right='%s' (type=%d, hexLen=%d)\n", 
-            //        left, lval.type, lval.hexLen, right, rval.type, rval.hexLen);
-            
-            // Hex concatenation if both operands are hex
-            if (lval.type == TYPE_HEX && rval.type == TYPE_HEX) {
-                isHexConcat = 1;
-                Value result;
-                result.type = TYPE_HEX;
-                result.hexLen = 0;
-                
-                if (lval.hexLen > 0) {
-                    memcpy(result.data.hexValue, lval.data.hexValue, lval.hexLen);
-                    result.hexLen = lval.hexLen;
-                }
-                if (rval.hexLen > 0) {
-                    memcpy(result.data.hexValue + result.hexLen, rval.data.hexValue, rval.hexLen);
-                    result.hexLen += rval.hexLen;
+    int hasA = in->mode & READ_ALL;
+    int hasHxd = in->mode & READ_HXD;
+    int argCount = in->argc;
+    const char *args[3];
+    for (int i = 0; i < argCount; i++) {
+        args[i] = poolText(&program, operandAt(&program, in, i)->ref);
+    }
+
+    if (argCount == 0) {
+        // read -lt -a [-hxd] - list all registers
+        printf("=== Registers ===\n");
+        printRegisterList(hasHxd);
+    } else if (strcmp(args[0], "adr") == 0) {
+        if (argCount > 1) {
+            // read -lt adr <register> - show specific register
+            Register *reg = getRegister(findName(&program, args[1]));
+            if (reg) {
+                printf("=== Register %s ===\n", args[1]);
+                if (reg->value.type == TYPE_NUMBER) {
+                    printf("Type: NUMBER\nValue: %lld\n", reg->value.data.numValue);
+                } else if (reg->value.type == TYPE_FLOAT) {
+                    printf("Type: FLOAT\nValue: %.2f\n", reg->value.data.floatValue);
+                } else if (reg->value.type == TYPE_STRING) {
+                    printf("Type: STRING\nValue: \"%s\"", valueText(reg->value));
+                    if (hasHxd) {
+                        printf("\nHex: ");
+                        for (int j = 0; valueText(reg->value)[j]; j++) {
+                            printf("%02x ", (unsigned char)valueText(reg->value)[j]);
+                        }
+                    }
+                    printf("\n");
+                } else if (reg->value.type == TYPE_HEX) {
+                    printf("Type: HEX\nValue: ");
+                    for (long long j = 0; j < valueLength(reg->value); j++) {
+                        printf("%02x ", valueBytes(reg->value)[j]);
+                    }
+                    if (hasHxd) {
+                        printf("\nASCII: ");
+                        for (long long j = 0; j < valueLength(reg->value); j++) {
+                            char c = valueBytes(reg->value)[j];
+                            printf("%c", (c >= 32 && c <= 126) ? c : '.');
+                        }
+                    }
+                    printf("\n");
+                } else if (reg->value.type == TYPE_VECTOR) {
+                    printf("Type: VECTOR\nValue: ");
+                    printVector(reg->value.data.vector);
+                    printf("\n");
+                } else if (reg->value.type == TYPE_TEXT) {
+                    printf("Type: TEXT\nLength: %lld\nValue: ", reg->value.data.text->len);
+                    printText(reg->value.data.text);
+                    printf("\n");
                 }
-                
-                addRegister(dest, result);
+            } else {
+                printf("Register %s not found\n", args[1]);
             }
+        } else if (hasA) {
+            // read -lt -a adr - list all registers (same as no args)
+            printf("=== All Registers ===\n");
+            printRegisterList(hasHxd);
         }
-        
-        if (!isHexConcat) {
-            // Numeric addition
-            long long val = evaluateExpression(expr);
-            Value v;
-            v.type = TYPE_NUMBER;
-            v.data.numValue = val;
-            addRegister(dest, v);
-        }
-    }
-
-    else if (strcmp(instruction, "sda") == 0) {
-        char dest[64];
-        remaining = getFirstWord(remaining, dest);
-        if (!isValidVarName(dest)) return;
-
-        long long sum = 0;
-        if (strncmp(remaining, "ARGUMENTS", 9) == 0) {
-            for (int i = 0; i < state.argCount; i++) sum += state.arguments[i];
-        } else {
-            while (*remaining) {
-                char word[64];
-                remaining = getFirstWord(remaining, word);
-                if (strlen(word) == 0) break;
-                Value v = parseValue(word);
-                sum += v.data.numValue;
+    } else if (strcmp(args[0], "rom") == 0 && argCount > 1) {
+        const char *romFile = args[1];
+
+        if (argCount > 2) {
+            // read -lt rom <file> <key> - show specific ROM entry
+            const char *key = args[2];
+            ROMEntry *entry = getROMEntry(key);
+            if (entry) {
+                printf("=== ROM Entry: %s ===\n", key);
+                if (entry->value.type == TYPE_NUMBER) {
+                    printf("Type: NUMBER\nValue: %lld\n", entry->value.data.numValue);
+                } else if (entry->value.type == TYPE_STRING) {
+                    printf("Type: STRING\nValue: \"%s\"", valueText(entry->value));
+                    if (hasHxd) {
+                        printf("\nHex: ");
+                        for (int j = 0; valueText(entry->value)[j]; j++) {
+                            printf("%02x ", (unsigned char)valueText(entry->value)[j]);
+                        }
+                    }
+                    printf("\n");
+                }
+            } else {
+                printf("ROM entry %s not found\n", key);
+            }
+        } else if (hasA) {
+            // read -lt -a rom <file> - list all ROM entries
+            printf("=== ROM Entries from %s ===\n", romFile);
+            for (int i = 0; i < state.romCount; i++) {
+                printf("%s: ", state.romEntries[i].key);
+                if (state.romEntries[i].value.type == TYPE_NUMBER) {
+                    printf("%lld", state.romEntries[i].value.data.numValue);
+                } else if (state.romEntries[i].value.type == TYPE_STRING) {
+                    if (hasHxd) {
+                        printf("\"");
+                        for (int j = 0; valueText(state.romEntries[i].value)[j]; j++) {
+                            printf("%02x ", (unsigned char)valueText(state.romEntries[i].value)[j]);
+                        }
+                        printf("\"");
+                    } else {
+                        printf("\"%s\"", valueText(state.romEntries[i].value));
+                    }
+                }
+                printf("\n");
             }
         }
-        
-        Value v;
-        v.type = TYPE_NUMBER;
-        v.data.numValue = sum;
-        addRegister(dest, v);
     }
+}
 
-    else if (strcmp(instruction, "subr") == 0) {
-        char dest[64], expr[256];
-        remaining = getFirstWord(remaining, dest);
-        strcpy(expr, remaining);
+void executeRange(int start, int end);
 
-        long long val = evaluateExpression(expr);
-        Value v;
-        v.type = TYPE_NUMBER;
-        v.data.numValue = val;
-        addRegister(dest, v);
-    }
+// Decode an imported assembly file onto the end of the program and run it
+void importAssembly(const char *filepath) {
+    FILE *f = fopen(filepath, "r");
+    if (!f) return;
 
-    else if (strcmp(instruction, "mul") == 0) {
-        char dest[64], expr[256];
-        remaining = getFirstWord(remaining, dest);
-        if (!isValidVarName(dest)) return;
-        strcpy(expr, remaining);
+    int first = program.codeCount;
+    char line[MAX_LINE_LENGTH];
+    int lineNo = 0;
+    while (lineNo < MAX_LINES && fgets(line, MAX_LINE_LENGTH, f)) {
+        trimWhitespace(line);
+        decodeLine(&program, line, ++lineNo);
+    }
+    fclose(f);
 
-        char *mul = strchr(expr, '*');
-        if (mul) {
-            char left[256], right[256];
-            strncpy(left, expr, mul - expr);
-            left[mul - expr] = '\0';
-            strcpy(right, mul + 1);
+    resolveBlocks(&program, first);
+    if (verifyProgram(&program, first, filepath) < 0) return;
+    bindROMOperands();
+    executeRange(first, program.codeCount - 1);
+}
 
-            trimWhitespace(left);
-            trimWhitespace(right);
+void executeReq(const Instr *in) {
+    // Decoded form: req ftype="rom"|"asm"|"bin", "filepath"[, register]
+    if (in->argc < 2) return;
 
-            Value lval = parseValue(left);
-            Value rval = parseValue(right);
+    char ftype[64], filepath[256];
+    snprintf(ftype, sizeof(ftype), "%s", poolText(&program, operandAt(&program, in, 0)->ref));
+    snprintf(filepath, sizeof(filepath), "%s", poolText(&program, operandAt(&program, in, 1)->ref));
 
-            Value v;
-            v.type = TYPE_NUMBER;
-            v.data.numValue = lval.data.numValue * rval.data.numValue;
-            addRegister(dest, v);
+    if (strcmp(ftype, "bin") == 0) {
+        // Mapped again each time, so a file that grew is seen whole
+        if (in->dest >= 0) addRegister(in->dest, mapHex(filepath));
+        return;
+    }
+    if (isFileImported(filepath)) return;
+    if (strcmp(ftype, "rom") == 0) {
+        int count = state.romCount;
+        parseROMFile(filepath);
+        markFileImported(filepath);
+        if (state.romCount > count) rebindMissingROM();
+    } else if (strcmp(ftype, "asm") == 0) {
+        FILE *f = fopen(filepath, "r");
+        if (f) {
+            fclose(f);
+            // Mark first so a file that imports itself is not re-entered
+            markFileImported(filepath);
+            importAssembly(filepath);
         }
     }
+}
 
-    else if (strcmp(instruction, "div") == 0) {
-        char dest[64], expr[256];
-        remaining = getFirstWord(remaining, dest);
-        if (!isValidVarName(dest)) return;
-        strcpy(expr, remaining);
-
-        char *div = strchr(expr, '/');
-        if (div) {
-            char left[256], right[256];
-            strncpy(left, expr, div - expr);
-            left[div - expr] = '\0';
-            strcpy(right, div + 1);
-
-            trimWhitespace(left);
-            trimWhitespace(right);
+void executeWasm(const Instr *in) {
+    const Operand *args = operandAt(&program, in, 0);
+
+    if (in->mode == WASM_NEW_PAGE) {
+        // New page: wasm -np page="name"
+        const char *pageName = poolText(&program, args[0].ref);
+        if (wasmState.pageCount < MAX_WASM_PAGES) {
+            snprintf(wasmState.pages[wasmState.pageCount].name, 64, "%s", pageName);
+            wasmState.pages[wasmState.pageCount].elementCount = 0;
+            wasmState.pageCount++;
+            printf("[WASM] Page created: %s\n", pageName);
+        }
+    }
+    else if (in->mode == WASM_NEW_ELEMENT) {
+        // New element: wasm -ne type="h1" txt="..." id="..." class="..." style="..."
+        WasmElement elem = {0};
+        snprintf(elem.type, sizeof(elem.type), "%s", poolText(&program, args[0].ref));
+        if (args[1].kind == OPD_TEXT) {
+            snprintf(elem.txt, sizeof(elem.txt), "%s", poolText(&program, args[1].ref));
+        } else {
+            // txt=reg: what the register holds now, as str add would write it
+            Text *text = newText();
+            Value v = evalOperand(&args[1]);
+            appendValue(text, v);
+            releaseValue(v);
+            long long len = flattenText(text, (unsigned char *)elem.txt, sizeof(elem.txt) - 1);
+            elem.txt[len] = '\0';
+            releaseText(text);
+        }
+        snprintf(elem.id, sizeof(elem.id), "%s", poolText(&program, args[2].ref));
+        snprintf(elem.class, sizeof(elem.class), "%s", poolText(&program, args[3].ref));
+        snprintf(elem.style, sizeof(elem.style), "%s", poolText(&program, args[4].ref));
 
-            Value lval = parseValue(left);
-            Value rval = parseValue(right);
+        printf("[WASM] Element created: <%s id=\"%s\">\n", elem.type, elem.id);
 
-            Value v;
-            v.type = TYPE_NUMBER;
-            v.data.numValue = rval.data.numValue != 0 ? lval.data.numValue / rval.data.numValue : 0;
-            addRegister(dest, v);
+        // Store in element registry (attach to current/default page if exists)
+        if (wasmState.pageCount > 0) {
+            WasmPage *currentPage = &wasmState.pages[wasmState.pageCount - 1];
+            if (currentPage->elementCount < MAX_WASM_ELEMENTS) {
+                currentPage->elements[currentPage->elementCount++] = elem;
+            }
+        } else if (wasmState.pageCount < MAX_WASM_PAGES) {
+            // Create default page if none exists
+            strcpy(wasmState.pages[wasmState.pageCount].name, "default");
+            wasmState.pages[wasmState.pageCount].elements[0] = elem;
+            wasmState.pages[wasmState.pageCount].elementCount = 1;
+            wasmState.pageCount++;
         }
     }
+    else if (in->mode == WASM_ATTACH) {
+        // Attach element: wasm -ae id="elemid" page="pagename"
+        printf("[WASM] Attaching '%s' to page '%s'\n",
+               poolText(&program, args[0].ref), poolText(&program, args[1].ref));
+    }
+    else if (in->mode == WASM_OPEN_PORT) {
+        // Open port: wasm -op port_number -ap page="name"
+        int port = atoi(poolText(&program, args[0].ref));
+        snprintf(wasmState.activePage, sizeof(wasmState.activePage), "%s", poolText(&program, args[1].ref));
+        wasmState.webPort = port;
+
+        printf("[WASM] Starting web server on port %d\n", port);
+        startWebServer(port);
+    }
+    else if (in->mode == WASM_NEW_SCRIPT) {
+        // New script: wasm -ns ftype="clang" id="scriptid" exec => { C code }
+        // For now, skip JS and just support C compilation
+        printf("[WASM] Script registration - JS skipped, C only\n");
+    }
+}
 
-    else if (strcmp(instruction, "mod") == 0) {
-        char dest[64], expr[256];
-        remaining = getFirstWord(remaining, dest);
-        if (!isValidVarName(dest)) return;
-        strcpy(expr, remaining);
+void executeRdl(const Instr *in) {
+    char buffer[512];
+    if (fgets(buffer, sizeof(buffer), stdin) == NULL) return;
 
-        char *mod = strchr(expr, '%');
-        if (mod) {
-            char left[256], right[256];
-            strncpy(left, expr, mod - expr);
-            left[mod - expr] = '\0';
-            strcpy(right, mod + 1);
+    // Remove newline if present
+    int len = strlen(buffer);
+    if (len > 0 && buffer[len-1] == '\n') {
+        buffer[len-1] = '\0';
+    }
 
-            trimWhitespace(left);
-            trimWhitespace(right);
+    Value v;
+    if (in->mode == RDL_INT) {
+        // Read as integer
+        v = makeNumber(strtoll(buffer, NULL, 10));
+    } else if (in->mode == RDL_FLOAT) {
+        v = makeFloat(strtod(buffer, NULL));
+    } else {
+        // Default or -s: read as string
+        v = makeString(buffer, strlen(buffer));
+    }
 
-            Value lval = parseValue(left);
-            Value rval = parseValue(right);
+    addRegister(in->dest, v);
+}
 
-            Value v;
-            v.type = TYPE_NUMBER;
-            v.data.numValue = rval.data.numValue != 0 ? lval.data.numValue % rval.data.numValue : 0;
-            addRegister(dest, v);
+void executeAddr(const Instr *in) {
+    if (in->mode == ADDR_CONCAT) {
+        const Operand *args = operandAt(&program, in, 0);
+        Value lval = evalOperand(&args[0]);
+        Value rval = evalOperand(&args[1]);
+
+        // Hex concatenation if both operands are hex
+        if (lval.type == TYPE_HEX && rval.type == TYPE_HEX) {
+            long long left = valueLength(lval), right = valueLength(rval);
+            unsigned char *bytes;
+            Value joined = reserveHex(left + right, &bytes);
+            if (left) memcpy(bytes, valueBytes(lval), left);
+            if (right) memcpy(bytes + left, valueBytes(rval), right);
+            releaseValue(lval);
+            releaseValue(rval);
+
+            addRegister(in->dest, joined);
+            return;
         }
+        releaseValue(lval);
+        releaseValue(rval);
     }
 
-    else if (strcmp(instruction, "vga") == 0) {
-        Value val = parseValue(remaining);
-        
-        if (val.type == TYPE_NUMBER) {
-            printf("%lld\n", val.data.numValue);
-        } else if (val.type == TYPE_STRING) {
-            printf("%s\n", val.data.strValue);
-        } else if (val.type == TYPE_HEX) {
-            for (int i = 0; i < val.hexLen; i++) {
-                printf("%02x", val.data.hexValue[i]);
-                if (i < val.hexLen - 1) printf(" ");
-            }
-            printf("\n");
-        }
+    // Numeric addition
+    addRegister(in->dest, evaluateValue(in, in->mode == ADDR_CONCAT ? 2 : 0));
+}
+
+// The generic mov, addr, subr, mul, div and mod a failed guard falls back to
+void executeStore(const Instr *in, int op) {
+    switch (op) {
+    case OP_MOV:
+        addRegister(in->dest, evalOperand(operandAt(&program, in, 0)));
+        break;
+    case OP_ADDR:
+        executeAddr(in);
+        break;
+    default:
+        addRegister(in->dest, evaluateValue(in, 0));
+        break;
     }
+}
 
-    else if (strcmp(instruction, "exec") == 0) {
-        if (strncmp(remaining, "sys=help", 8) == 0) {
-            printf("mov, char, hex, addr, subr, mul, div, mod, vga, exec, cond, for, sda, def, req, read\n");
-        } else {
-            Value val = parseValue(remaining);
-            if (val.type == TYPE_NUMBER && val.data.numValue <= 255) {
-                state.exitCode = val.data.numValue;
-                state.shouldExit = 1;
-            }
+void executeVga(const Instr *in) {
+    Value v = evalOperand(operandAt(&program, in, 0));
+
+    if (v.type == TYPE_NUMBER) {
+        printf("%lld\n", v.data.numValue);
+    } else if (v.type == TYPE_FLOAT) {
+        printf("%.2f\n", v.data.floatValue);
+    } else if (v.type == TYPE_STRING) {
+        printf("%s\n", valueText(v));
+    } else if (v.type == TYPE_HEX) {
+        long long len = valueLength(v);
+        for (long long i = 0; i < len; i++) {
+            printf("%02x", valueBytes(v)[i]);
+            if (i + 1 < len) printf(" ");
         }
+        printf("\n");
+    } else if (v.type == TYPE_VECTOR) {
+        printVector(v.data.vector);
+        printf("\n");
+    } else if (v.type == TYPE_TEXT) {
+        // Straight from the pieces, never joined into one buffer
+        writeText(v.data.text, stdout);
+        printf("\n");
     }
+    releaseValue(v);
+}
 
-    else if (strcmp(instruction, "read") == 0) {
-        // Parse: read -lt [-a] [-hxd] [adr|rom] [args...]
-        char args[10][256];
-        int argCount = 0;
-        
-        // Tokenize arguments
-        char tmpRemaining[MAX_LINE_LENGTH];
-        strcpy(tmpRemaining, remaining);
-        char *token = strtok(tmpRemaining, " ");
-        while (token && argCount < 10) {
-            strcpy(args[argCount++], token);
-            token = strtok(NULL, " ");
-        }
-        
-        if (argCount < 1) return;
-        
-        // Check for -lt flag
-        int hasLt = 0;
-        int hasA = 0;
-        int hasHxd = 0;
-        int startIdx = 0;
-        
-        for (int i = 0; i < argCount; i++) {
-            if (strcmp(args[i], "-lt") == 0) {
-                hasLt = 1;
-                startIdx = i + 1;
-            } else if (strcmp(args[i], "-a") == 0) {
-                hasA = 1;
-            } else if (strcmp(args[i], "-hxd") == 0) {
-                hasHxd = 1;
-            }
-        }
-        
-        if (!hasLt) return;
-        
-        // Determine the command type
-        int cmdIdx = startIdx;
-        while (cmdIdx < argCount && (strcmp(args[cmdIdx], "-a") == 0 || strcmp(args[cmdIdx], "-hxd") == 0)) {
-            cmdIdx++;
-        }
-        
-        if (cmdIdx >= argCount) {
-            // read -lt -a [-hxd] - list all registers
-            printf("=== Registers ===\n");
-            for (int i = 0; i < state.regCount; i++) {
-                printf("%s: ", state.registers[i].name);
-                if (state.registers[i].value.type == TYPE_NUMBER) {
-                    printf("%lld", state.registers[i].value.data.numValue);
-                } else if (state.registers[i].value.type == TYPE_STRING) {
-                    if (hasHxd) {
-                        printf("\"");
-                        for (int j = 0; state.registers[i].value.data.strValue[j]; j++) {
-                            printf("%02x ", (unsigned char)state.registers[i].value.data.strValue[j]);
-                        }
-                        printf("\"");
-                    } else {
-                        printf("\"%s\"", state.registers[i].value.data.strValue);
-                    }
-                } else if (state.registers[i].value.type == TYPE_HEX) {
-                    printf("[HEX] ");
-                    for (int j = 0; j < state.registers[i].value.hexLen; j++) {
-                        printf("%02x ", state.registers[i].value.data.hexValue[j]);
-                    }
-                }
-                printf("\n");
-            }
-        } else if (strcmp(args[cmdIdx], "adr") == 0) {
-            if (cmdIdx + 1 < argCount) {
-                // read -lt adr <register> - show specific register
-                Register *reg = getRegister(args[cmdIdx + 1]);
-                if (reg) {
-                    printf("=== Register %s ===\n", args[cmdIdx + 1]);
-                    if (reg->value.type == TYPE_NUMBER) {
-                        printf("Type: NUMBER\nValue: %lld\n", reg->value.data.numValue);
-                    } else if (reg->value.type == TYPE_STRING) {
-                        printf("Type: STRING\nValue: \"%s\"", reg->value.data.strValue);
-                        if (hasHxd) {
-                            printf("\nHex: ");
-                            for (int j = 0; reg->value.data.strValue[j]; j++) {
-                                printf("%02x ", (unsigned char)reg->value.data.strValue[j]);
-                            }
-                        }
-                        printf("\n");
-                    } else if (reg->value.type == TYPE_HEX) {
-                        printf("Type: HEX\nValue: ");
-                        for (int j = 0; j < reg->value.hexLen; j++) {
-                            printf("%02x ", reg->value.data.hexValue[j]);
-                        }
-                        if (hasHxd) {
-                            printf("\nASCII: ");
-                            for (int j = 0; j < reg->value.hexLen; j++) {
-                                char c = reg->value.data.hexValue[j];
-                                printf("%c", (c >= 32 && c <= 126) ? c : '.');
-                            }
-                        }
-                        printf("\n");
-                    }
-                } else {
-                    printf("Register %s not found\n", args[cmdIdx + 1]);
-                }
-            } else if (hasA) {
-                // read -lt -a adr - list all registers (same as no args)
-                printf("=== All Registers ===\n");
-                for (int i = 0; i < state.regCount; i++) {
-                    printf("%s: ", state.registers[i].name);
-                    if (state.registers[i].value.type == TYPE_NUMBER) {
-                        printf("%lld", state.registers[i].value.data.numValue);
-                    } else if (state.registers[i].value.type == TYPE_STRING) {
-                        if (hasHxd) {
-                            printf("\"");
-                            for (int j = 0; state.registers[i].value.data.strValue[j]; j++) {
-                                printf("%02x ", (unsigned char)state.registers[i].value.data.strValue[j]);
-                            }
-                            printf("\"");
-                        } else {
-                            printf("\"%s\"", state.registers[i].value.data.strValue);
-                        }
-                    } else if (state.registers[i].value.type == TYPE_HEX) {
-                        printf("[HEX] ");
-                        for (int j = 0; j < state.registers[i].value.hexLen; j++) {
-                            printf("%02x ", state.registers[i].value.data.hexValue[j]);
-                        }
-                    }
-                    printf("\n");
-                }
-            }
-        } else if (strcmp(args[cmdIdx], "rom") == 0) {
-            if (cmdIdx + 1 < argCount) {
-                char *romFile = args[cmdIdx + 1];
-                
-                if (cmdIdx + 2 < argCount) {
-                    // read -lt rom <file> <key> - show specific ROM entry
-                    char *key = args[cmdIdx + 2];
-                    ROMEntry *entry = getROMEntry(key);
-                    if (entry) {
-                        printf("=== ROM Entry: %s ===\n", key);
-                        if (entry->value.type == TYPE_NUMBER) {
-                            printf("Type: NUMBER\nValue: %lld\n", entry->value.data.numValue);
-                        } else if (entry->value.type == TYPE_STRING) {
-                            printf("Type: STRING\nValue: \"%s\"", entry->value.data.strValue);
-                            if (hasHxd) {
-                                printf("\nHex: ");
-                                for (int j = 0; entry->value.data.strValue[j]; j++) {
-                                    printf("%02x ", (unsigned char)entry->value.data.strValue[j]);
-                                }
-                            }
-                            printf("\n");
-                        }
-                    } else {
-                        printf("ROM entry %s not found\n", key);
-                    }
-                } else if (hasA) {
-                    // read -lt -a rom <file> - list all ROM entries
-                    printf("=== ROM Entries from %s ===\n", romFile);
-                    for (int i = 0; i < state.romCount; i++) {
-                        printf("%s: ", state.romEntries[i].key);
-                        if (state.romEntries[i].value.type == TYPE_NUMBER) {
-                            printf("%lld", state.romEntries[i].value.data.numValue);
-                        } else if (state.romEntries[i].value.type == TYPE_STRING) {
-                            if (hasHxd) {
-                                printf("\"");
-                                for (int j = 0; state.romEntries[i].value.data.strValue[j]; j++) {
-                                    printf("%02x ", (unsigned char)state.romEntries[i].value.data.strValue[j]);
-                                }
-                                printf("\"");
-                            } else {
-                                printf("\"%s\"", state.romEntries[i].value.data.strValue);
-                            }
-                        }
-                        printf("\n");
-                    }
-                }
-            }
-        }
+// Is the destination register the only other holder of vector value v,
+// so the instruction may change it in place
+int ownsVector(const Instr *in, Value v) {
+    Register *reg = getRegister(in->dest);
+    return v.type == TYPE_VECTOR && v.data.vector->refs == 2 && reg &&
+           reg->value.type == TYPE_VECTOR && reg->value.data.vector == v.data.vector;
+}
+
+// The vector an operand reads, or an empty one if it holds anything else
+Value evalVector(const Operand *op) {
+    Value v = evalOperand(op);
+    if (v.type == TYPE_VECTOR) return v;
+    releaseValue(v);
+    return makeVector(newVector(0, 0));
+}
+
+// A vector vec set and vec push may change: v itself when nothing but the
+// destination register holds it, else a copy. Takes over v.
+Vector *writableVector(const Instr *in, Value v) {
+    if (ownsVector(in, v)) return v.data.vector;
+    Vector *copy = copyVector(v.data.vector, 0, v.data.vector->count);
+    releaseValue(v);
+    return copy;
+}
+
+// Element index of a vector as a number or float
+Value vectorElement(const Vector *vector, int index) {
+    return vector->isFloat ? makeFloat(vector->data.floats[index]) : makeNumber(vector->data.ints[index]);
+}
+
+// vec add and vec mul: elementwise over two vectors, as long as the shorter
+// one, or every element of one vector with a number. A float on either
+// side gives a float vector; without a vector the result is empty.
+Value combineVectors(const Instr *in) {
+    const Operand *args = operandAt(&program, in, 0);
+    Value a = evalOperand(&args[0]);
+    Value b = evalOperand(&args[1]);
+    if (a.type != TYPE_VECTOR) {
+        Value swap = a;
+        a = b;
+        b = swap;
+    }
+    if (a.type != TYPE_VECTOR) {
+        releaseValue(a);
+        releaseValue(b);
+        return makeVector(newVector(0, 0));
+    }
+    if (b.type != TYPE_VECTOR && !isNumeric(b)) {
+        releaseValue(b);
+        b = makeNumber(0);
     }
 
-    else if (strcmp(instruction, "req") == 0) {
-        // Parse: req ftype="rom"|"asm", "filepath"
-        char ftype[64] = "";
-        char filepath[256] = "";
-        
-        // Extract ftype
-        char *ftypeStart = strchr(remaining, '"');
-        if (ftypeStart) {
-            ftypeStart++;
-            char *ftypeEnd = strchr(ftypeStart, '"');
-            if (ftypeEnd) {
-                strncpy(ftype, ftypeStart, ftypeEnd - ftypeStart);
-                ftype[ftypeEnd - ftypeStart] = '\0';
-                remaining = ftypeEnd + 1;
+    Vector *left = a.data.vector;
+    Vector *right = b.type == TYPE_VECTOR ? b.data.vector : NULL;
+    int isFloat = left->isFloat || (right ? right->isFloat : b.type == TYPE_FLOAT);
+    int count = right && right->count < left->count ? right->count : left->count;
+    Vector *out = ownsVector(in, a) && left->isFloat == isFloat ? left : newVector(isFloat, count);
+
+    if (isFloat) {
+        double *leftScratch, *rightScratch = NULL;
+        const double *x = floatElements(left, &leftScratch);
+        const double *y = right ? floatElements(right, &rightScratch) : NULL;
+        combineFloats(in->mode, out->data.floats, x, y, right ? 0 : floatOf(b), count);
+        free(leftScratch);
+        free(rightScratch);
+    } else {
+        combineInts(in->mode, out->data.ints, left->data.ints, right ? right->data.ints : NULL,
+                    right ? 0 : b.data.numValue, count);
+    }
+    out->count = count;
+    releaseValue(b);
+    if (out == left) return a;
+    releaseValue(a);
+    return makeVector(out);
+}
+
+// vec dot: the sum of the products of two vectors' elements, as far as the
+// shorter one goes
+Value dotVectors(const Instr *in) {
+    const Operand *args = operandAt(&program, in, 0);
+    Value a = evalVector(&args[0]);
+    Value b = evalVector(&args[1]);
+    Vector *left = a.data.vector, *right = b.data.vector;
+    int count = left->count < right->count ? left->count : right->count;
+    Value result;
+    if (left->isFloat || right->isFloat) {
+        double *leftScratch, *rightScratch;
+        const double *x = floatElements(left, &leftScratch);
+        const double *y = floatElements(right, &rightScratch);
+        result = makeFloat(dotFloats(x, y, count));
+        free(leftScratch);
+        free(rightScratch);
+    } else {
+        result = makeNumber(dotInts(left->data.ints, right->data.ints, count));
+    }
+    releaseValue(a);
+    releaseValue(b);
+    return result;
+}
+
+// vec sum, min and max; an empty vector gives 0
+Value reduceVector(const Instr *in) {
+    Value a = evalVector(operandAt(&program, in, 0));
+    Vector *vector = a.data.vector;
+    Value result = makeNumber(0);
+    if (in->mode == VEC_SUM) {
+        result = vector->isFloat ? makeFloat(sumFloats(vector->data.floats, vector->count))
+                                 : makeNumber(sumInts(vector->data.ints, vector->count));
+    } else if (vector->count > 0) {
+        result = vector->isFloat ? makeFloat(extremeFloats(in->mode, vector->data.floats, vector->count))
+                                 : makeNumber(extremeInts(in->mode, vector->data.ints, vector->count));
+    }
+    releaseValue(a);
+    return result;
+}
+
+// vec dest, operation, operands... Operands that should be vectors and
+// are not count as empty vectors; anything but a vector, number or float
+// where a number belongs counts as 0
+void executeVec(const Instr *in) {
+    const Operand *args = operandAt(&program, in, 0);
+    Value result;
+
+    switch (in->mode) {
+    case VEC_FILL: {
+        long long count = evalNumber(&args[0]);
+        Value v = evalArithmetic(&args[1]);
+        count = count < 0 ? 0 : count > MAX_VECTOR_LENGTH ? MAX_VECTOR_LENGTH : count;
+        Vector *vector = newVector(v.type == TYPE_FLOAT, count);
+        long long bits = v.data.numValue;
+        if (v.type == TYPE_FLOAT) memcpy(&bits, &v.data.floatValue, sizeof(bits));
+        fillVector(vector, bits, count);
+        result = makeVector(vector);
+        break;
+    }
+
+    case VEC_ADD:
+    case VEC_MUL:
+        result = combineVectors(in);
+        break;
+
+    case VEC_DOT:
+        result = dotVectors(in);
+        break;
+
+    case VEC_SUM:
+    case VEC_MIN:
+    case VEC_MAX:
+        result = reduceVector(in);
+        break;
+
+    case VEC_SLICE: {
+        // Start and count are clamped to the elements there are
+        Value a = evalVector(&args[0]);
+        Vector *vector = a.data.vector;
+        long long start = evalNumber(&args[1]);
+        long long count = evalNumber(&args[2]);
+        start = start < 0 ? 0 : start > vector->count ? vector->count : start;
+        count = count < 0 ? 0 : count > vector->count - start ? vector->count - start : count;
+        result = makeVector(copyVector(vector, start, count));
+        releaseValue(a);
+        break;
+    }
+
+    case VEC_GET: {
+        // Out of range reads 0
+        Value a = evalVector(&args[0]);
+        long long index = evalNumber(&args[1]);
+        Vector *vector = a.data.vector;
+        result = index >= 0 && index < vector->count ? vectorElement(vector, index) : makeNumber(0);
+        releaseValue(a);
+        break;
+    }
+
+    case VEC_SET:
+    case VEC_PUSH: {
+        // A float going into an integer vector turns every element into a
+        // float; out of range set and push past the limit change nothing
+        Vector *vector = writableVector(in, evalVector(&args[0]));
+        long long index = in->mode == VEC_SET ? evalNumber(&args[1]) : vector->count;
+        Value v = evalArithmetic(&args[in->mode == VEC_SET ? 2 : 1]);
+        int fits = in->mode == VEC_SET ? index >= 0 && index < vector->count : index < MAX_VECTOR_LENGTH;
+        if (fits) {
+            if (v.type == TYPE_FLOAT) promoteVector(vector);
+            if (in->mode == VEC_PUSH) {
+                reserveVector(vector, index + 1);
+                vector->count++;
             }
+            if (vector->isFloat) vector->data.floats[index] = floatOf(v);
+            else vector->data.ints[index] = v.data.numValue;
         }
-        
-        // Extract filepath
-        char *pathStart = strchr(remaining, '"');
-        if (pathStart) {
-            pathStart++;
-            char *pathEnd = strchr(pathStart, '"');
-            if (pathEnd) {
-                strncpy(filepath, pathStart, pathEnd - pathStart);
-                filepath[pathEnd - pathStart] = '\0';
-            }
+        result = makeVector(vector);
+        break;
+    }
+
+    case VEC_LEN: {
+        Value a = evalVector(&args[0]);
+        result = makeNumber(a.data.vector->count);
+        releaseValue(a);
+        break;
+    }
+
+    default:
+        // Reported by verifyProgram before the run
+        return;
+    }
+    addRegister(in->dest, result);
+}
+
+// The hex value an operand reads, or an empty one if it holds anything else
+Value evalHex(const Operand *op) {
+    Value v = evalOperand(op);
+    if (v.type == TYPE_HEX) return v;
+    releaseValue(v);
+    return makeHex(NULL, 0);
+}
+
+// buf find: where the needle, a hex value or a number for a single byte,
+// first turns up at or after start; -1 when it does not
+Value findInHex(const Instr *in) {
+    const Operand *args = operandAt(&program, in, 0);
+    Value a = evalHex(&args[0]);
+    Value needle = evalOperand(&args[1]);
+    long long start = evalNumber(&args[2]);
+    unsigned char byte;
+    const unsigned char *bytes = NULL;
+    long long len = 0;
+    if (needle.type == TYPE_HEX) {
+        bytes = valueBytes(needle);
+        len = valueLength(needle);
+    } else if (isNumeric(needle) && numberOf(needle) >= 0 && numberOf(needle) <= 255) {
+        byte = (unsigned char)numberOf(needle);
+        bytes = &byte;
+        len = 1;
+    }
+    long long at = -1;
+    if (bytes && start <= valueLength(a)) at = findBytes(valueBytes(a), valueLength(a), bytes, len, start < 0 ? 0 : start);
+    releaseValue(a);
+    releaseValue(needle);
+    return makeNumber(at);
+}
+
+// buf dest, operation, operands... Operands that should be hex values and
+// are not count as empty ones; the digests also take strings
+void executeBuf(const Instr *in) {
+    const Operand *args = operandAt(&program, in, 0);
+    Value result;
+
+    switch (in->mode) {
+    case BUF_XOR:
+    case BUF_AND:
+    case BUF_OR: {
+        // As long as the shorter operand
+        Value a = evalHex(&args[0]);
+        Value b = evalHex(&args[1]);
+        unsigned char *bytes;
+        long long len = valueLength(a) < valueLength(b) ? valueLength(a) : valueLength(b);
+        result = reserveHex(len, &bytes);
+        combineBytes(in->mode, bytes, valueBytes(a), valueBytes(b), len);
+        releaseValue(a);
+        releaseValue(b);
+        break;
+    }
+
+    case BUF_CMP: {
+        // -1, 0 or 1 by the first differing byte, unsigned, then by length
+        Value a = evalHex(&args[0]);
+        Value b = evalHex(&args[1]);
+        long long aLen = valueLength(a), bLen = valueLength(b);
+        long long len = aLen < bLen ? aLen : bLen;
+        long long at = firstDifference(valueBytes(a), valueBytes(b), len);
+        int order = at < len ? (valueBytes(a)[at] > valueBytes(b)[at]) - (valueBytes(a)[at] < valueBytes(b)[at])
+                             : (aLen > bLen) - (aLen < bLen);
+        result = makeNumber(order);
+        releaseValue(a);
+        releaseValue(b);
+        break;
+    }
+
+    case BUF_FIND:
+        result = findInHex(in);
+        break;
+
+    case BUF_COUNT: {
+        Value a = evalHex(&args[0]);
+        result = makeNumber(countBits(valueBytes(a), valueLength(a)));
+        releaseValue(a);
+        break;
+    }
+
+    case BUF_CRC:
+    case BUF_XXH:
+    case BUF_SHA: {
+        // Over the bytes of a hex value or a string
+        Value a = evalOperand(&args[0]);
+        long long len = hasBlob(a) ? valueLength(a) : 0;
+        unsigned char digest[SHA_SIZE];
+        if (in->mode == BUF_CRC) crc32c(valueBytes(a), len, digest);
+        else if (in->mode == BUF_XXH) xxh64(valueBytes(a), len, digest);
+        else sha256(valueBytes(a), len, digest);
+        result = makeHex(digest, in->mode == BUF_CRC ? CRC_SIZE : in->mode == BUF_XXH ? XXH_SIZE : SHA_SIZE);
+        releaseValue(a);
+        break;
+    }
+
+    case BUF_SLICE: {
+        // Shares the bytes; start and count are clamped to the bytes there are
+        Value a = evalHex(&args[0]);
+        long long start = evalNumber(&args[1]);
+        long long count = evalNumber(&args[2]);
+        long long len = valueLength(a);
+        start = start < 0 ? 0 : start > len ? len : start;
+        count = count < 0 ? 0 : count > len - start ? len - start : count;
+        result = sliceHex(a, start, count);
+        releaseValue(a);
+        break;
+    }
+
+    case BUF_LEN: {
+        Value a = evalHex(&args[0]);
+        result = makeNumber(valueLength(a));
+        releaseValue(a);
+        break;
+    }
+
+    default:
+        // Reported by verifyProgram before the run
+        return;
+    }
+    addRegister(in->dest, result);
+}
+
+// Is the destination register the only other holder of text value v, so
+// str add may append to it in place
+int ownsText(const Instr *in, Value v) {
+    Register *reg = getRegister(in->dest);
+    return v.type == TYPE_TEXT && v.data.text->refs == 2 && reg &&
+           reg->value.type == TYPE_TEXT && reg->value.data.text == v.data.text;
+}
+
+// str dest, operation, operands... add appends its second operand to its
+// first, taken as text; see appendValue
+void executeStr(const Instr *in) {
+    const Operand *args = operandAt(&program, in, 0);
+    Value result;
+
+    switch (in->mode) {
+    case STR_NEW:
+        result = makeText(newText());
+        break;
+
+    case STR_ADD: {
+        // Both operands are held first, so a text added to itself is
+        // never owned
+        Value a = evalOperand(&args[0]);
+        Value b = evalOperand(&args[1]);
+        if (ownsText(in, a)) {
+            result = a;
+        } else {
+            // A text a goes in shared, without copying its bytes
+            result = makeText(newText());
+            appendValue(result.data.text, a);
+            releaseValue(a);
         }
-        
-        // Process import
-        if (strlen(ftype) > 0 && strlen(filepath) > 0) {
-            if (strcmp(ftype, "rom") == 0) {
-                if (!isFileImported(filepath)) {
-                    parseROMFile(filepath);
-                    markFileImported(filepath);
-                }
-            } else if (strcmp(ftype, "asm") == 0) {
-                if (!isFileImported(filepath)) {
-                    // Load and execute imported assembly
-                    FILE *f = fopen(filepath, "r");
-                    if (f) {
-                        char tmpLines[MAX_LINES][MAX_LINE_LENGTH];
-                        int tmpLineCount = 0;
-                        while (tmpLineCount < MAX_LINES && fgets(tmpLines[tmpLineCount], MAX_LINE_LENGTH, f)) {
-                            trimWhitespace(tmpLines[tmpLineCount]);
-                            tmpLineCount++;
-                        }
-                        fclose(f);
-                        
-                        // Execute imported assembly (skip _start if present)
-                        for (int j = 0; j < tmpLineCount; j++) {
-                            if (strcmp(tmpLines[j], "_start:") == 0) continue;
-                            if (strlen(tmpLines[j]) == 0 || tmpLines[j][0] == ';') continue;
-                            executeInstruction(tmpLines[j]);
-                        }
-                        markFileImported(filepath);
-                    }
-                }
-            }
+        appendValue(result.data.text, b);
+        releaseValue(b);
+        break;
+    }
+
+    case STR_LEN: {
+        // Bytes in a text, string or hex value; anything else is 0
+        Value a = evalOperand(&args[0]);
+        result = makeNumber(a.type == TYPE_TEXT ? a.data.text->len : hasBlob(a) ? valueLength(a) : 0);
+        releaseValue(a);
+        break;
+    }
+
+    default:
+        // Reported by verifyProgram before the run
+        return;
+    }
+    addRegister(in->dest, result);
+}
+
+void executeExec(const Instr *in) {
+    if (in->mode == EXEC_HELP) {
+        printf("mov, char, hex, addr, subr, mul, div, mod, vga, exec, cond, for, sda, def, req, read, vec, buf, str\n");
+        return;
+    }
+
+    Value v = evalOperand(operandAt(&program, in, 0));
+    if (v.type == TYPE_NUMBER && v.data.numValue <= 255) {
+        state.exitCode = v.data.numValue;
+        state.shouldExit = 1;
+    }
+    releaseValue(v);
+}
+
+int compareNumbers(int mode, long long l, long long r);
+int compareFloats(int mode, double l, double r);
+
+int evaluateCondition(const Instr *in) {
+    // cond a OP b - numbers and floats compare by value, strings by their
+    // bytes; anything else is false
+    Value left = evalOperand(operandAt(&program, in, 0));
+    Value right = evalOperand(operandAt(&program, in, 1));
+    int result = 0;
+    if (left.type == TYPE_NUMBER && right.type == TYPE_NUMBER) {
+        result = compareNumbers(in->mode, left.data.numValue, right.data.numValue);
+    } else if (isNumeric(left) && isNumeric(right)) {
+        result = compareFloats(in->mode, floatOf(left), floatOf(right));
+    } else if (left.type == TYPE_STRING && right.type == TYPE_STRING) {
+        if (in->mode == CMP_EQ) result = sameString(left, right);
+        else if (in->mode == CMP_NE) result = !sameString(left, right);
+        else result = compareNumbers(in->mode, orderStrings(left, right), 0);
+    }
+    releaseValue(left);
+    releaseValue(right);
+    return result;
+}
+
+int compareNumbers(int mode, long long l, long long r) {
+    switch (mode) {
+    case CMP_LT: return l < r;
+    case CMP_GT: return l > r;
+    case CMP_LE: return l <= r;
+    case CMP_GE: return l >= r;
+    case CMP_EQ: return l == r;
+    case CMP_NE: return l != r;
+    }
+    return 0;
+}
+
+int compareFloats(int mode, double l, double r) {
+    switch (mode) {
+    case CMP_LT: return l < r;
+    case CMP_GT: return l > r;
+    case CMP_LE: return l <= r;
+    case CMP_GE: return l >= r;
+    case CMP_EQ: return l == r;
+    case CMP_NE: return l != r;
+    }
+    return 0;
+}
+
+// Run the for loop at pc as native code. Every register the loop touches
+// must hold a number or still be undefined (which reads as 0, like the
+// interpreter). Returns the instruction after the loop, or -1 to interpret.
+int runNativeLoop(int pc) {
+    if (pc >= jitCapacity) {
+        int capacity = jitCapacity ? jitCapacity : 64;
+        while (capacity <= pc) capacity *= 2;
+        JitLoop **loops = realloc(jitLoops, capacity * sizeof(JitLoop *));
+        if (!loops) return -1;
+        jitLoops = loops;
+        char *tried = realloc(jitTried, capacity);
+        if (!tried) return -1;
+        jitTried = tried;
+        memset(jitLoops + jitCapacity, 0, (capacity - jitCapacity) * sizeof(JitLoop *));
+        memset(jitTried + jitCapacity, 0, capacity - jitCapacity);
+        jitCapacity = capacity;
+    }
+    if (!jitTried[pc]) {
+        jitTried[pc] = 1;
+        jitLoops[pc] = jitCompileLoop(&program, pc);
+    }
+
+    JitLoop *loop = jitLoops[pc];
+    if (!loop) return -1;
+
+    int undefinedWrites = 0;
+    for (int i = 0; i < loop->slotCount; i++) {
+        Register *reg = getRegister(loop->slots[i]);
+        if (reg && reg->value.type != TYPE_NUMBER) return -1;
+        loop->frame[i] = reg ? reg->value.data.numValue : 0;
+    }
+    for (int j = 0; j < loop->writeCount; j++) {
+        if (!getRegister(loop->slots[loop->writes[j]])) undefinedWrites++;
+        loop->frame[loop->flagBase + j] = 0;
+    }
+    loop->frame[loop->flagBase + loop->writeCount] = 0;
+    // Registers past the limit would be dropped mid-loop; let the interpreter do that
+    if (state.regCount + undefinedWrites > MAX_REGISTERS) return -1;
+
+    loop->entry(loop->frame);
+
+    // Write back in first-store order so new registers list as they would
+    long long *flags = loop->frame + loop->flagBase;
+    long long stored = flags[loop->writeCount];
+    for (long long order = 1; order <= stored; order++) {
+        for (int j = 0; j < loop->writeCount; j++) {
+            if (flags[j] != order) continue;
+            int index = loop->writes[j];
+            addRegister(loop->slots[index], makeNumber(loop->frame[index]));
+            break;
         }
     }
+    return program.code[pc].target + 1;
+}
 
-    else if (strcmp(instruction, "wasm") == 0) {
-        char flag[64] = "";
-        remaining = getFirstWord(remaining, flag);
-        
-        if (strcmp(flag, "-np") == 0) {
-            // New page: wasm -np page="name"
-            char pageSpec[256];
-            remaining = getFirstWord(remaining, pageSpec);
-            
-            char pageName[64] = "";
-            char *pageVal = strchr(pageSpec, '"');
-            if (pageVal) {
-                pageVal++;
-                char *pageEnd = strchr(pageVal, '"');
-                if (pageEnd) {
-                    strncpy(pageName, pageVal, pageEnd - pageVal);
-                    pageName[pageEnd - pageVal] = '\0';
-                    
-                    if (wasmState.pageCount < MAX_WASM_PAGES) {
-                        strcpy(wasmState.pages[wasmState.pageCount].name, pageName);
-                        wasmState.pages[wasmState.pageCount].elementCount = 0;
-                        wasmState.pageCount++;
-                        printf("[WASM] Page created: %s\n", pageName);
-                    }
-                }
-            }
+// Instruction dispatch. With MITS_COMPUTED_GOTO (set by the Makefile for
+// GCC/Clang) every handler jumps straight to the next handler through a
+// label table, giving each opcode its own indirect branch. Otherwise the
+// same handlers become the cases of one switch that every handler jumps
+// back to. Only exec and req can stop the program, so they alone check
+// state.shouldExit.
+#ifdef MITS_COMPUTED_GOTO
+#define TARGET(op) op##_handler:
+#define DISPATCH() do { \
+        if (pc > limit) goto done; \
+        in = &program.code[pc]; \
+        goto *table[in->op]; \
+    } while (0)
+#else
+#define TARGET(op) case op:
+#define DISPATCH() goto dispatch
+#endif
+
+#define NEXT() do { pc++; DISPATCH(); } while (0)
+#define JUMP(to) do { pc = (to); DISPATCH(); } while (0)
+
+// Handler bodies shared with the superinstructions that end in them
+#define RUN_TEST() do { \
+        const Operand *args = operandAt(&program, in, 0); \
+        if (compareNumbers(in->mode, numberAt(&args[0]), numberAt(&args[1]))) NEXT(); \
+        JUMP((in->alt >= 0 ? in->alt : in->target) + 1); \
+    } while (0)
+
+#define RUN_END() do { \
+        LoopState *loop = &loops[in->depth]; \
+        if (in->target >= 0 && loop->header == in->target) { \
+            if (loop->current < loop->last) { \
+                loop->current++; \
+                /* The index usually still holds a number: update it in place */ \
+                Register *index = getRegister(loop->slot); \
+                if (index && index->value.type == TYPE_NUMBER) index->value.data.numValue = loop->current; \
+                else addRegister(loop->slot, makeNumber(loop->current)); \
+                JUMP(in->target + 1); \
+            } \
+            loop->header = -1; \
+        } \
+        NEXT(); \
+    } while (0)
+
+// Leave the running def: the caller's arguments and loop states come
+// back and execution resumes after the call
+#define RETURN_FROM_CALL() do { \
+        const CallFrame *frame = &state.frames[--state.frameCount]; \
+        if (frame->memo) rememberCall(frame->memo, frame->memoKey); \
+        state.loopTop = loops - state.loopStack; \
+        state.argTop = state.argBase; \
+        state.argBase = frame->argBase; \
+        state.argCount = frame->argCount; \
+        loops = state.loopStack + frame->loopBase; \
+        if (state.frameCount == frameBase) limit = end; \
+        JUMP(frame->returnPc); \
+    } while (0)
+
+// Run decoded instructions start..end, following the links made by
+// resolveBlocks. Each nesting depth owns one loop state, so nested blocks
+// need no recursion. A def call takes a fresh set of loop states from the
+// loop stack and may run code past end (a def from an imported file).
+void executeRange(int start, int end) {
+#ifdef MITS_COMPUTED_GOTO
+    static void *const handlers[OP_COUNT] = {
+        [OP_NOP] = &&OP_NOP_handler,
+        [OP_MOV] = &&OP_MOV_handler,
+        [OP_RDL] = &&OP_RDL_handler,
+        [OP_CHAR] = &&OP_CHAR_handler,
+        [OP_ADDR] = &&OP_ADDR_handler,
+        [OP_SUBR] = &&OP_SUBR_handler,
+        [OP_MUL] = &&OP_MUL_handler,
+        [OP_DIV] = &&OP_DIV_handler,
+        [OP_MOD] = &&OP_MOD_handler,
+        [OP_SDA] = &&OP_SDA_handler,
+        [OP_VGA] = &&OP_VGA_handler,
+        [OP_EXEC] = &&OP_EXEC_handler,
+        [OP_READ] = &&OP_READ_handler,
+        [OP_REQ] = &&OP_REQ_handler,
+        [OP_WASM] = &&OP_WASM_handler,
+        [OP_VEC] = &&OP_VEC_handler,
+        [OP_BUF] = &&OP_BUF_handler,
+        [OP_STR] = &&OP_STR_handler,
+        [OP_FOR] = &&OP_FOR_handler,
+        [OP_COND] = &&OP_COND_handler,
+        [OP_ELSE] = &&OP_ELSE_handler,
+        [OP_END] = &&OP_END_handler,
+        [OP_DEF] = &&OP_DEF_handler,
+        [OP_CALL] = &&OP_CALL_handler,
+        [OP_RET] = &&OP_RET_handler,
+        [OP_CALC] = &&OP_CALC_handler,
+        [OP_TEST] = &&OP_TEST_handler,
+        [OP_CALC2] = &&OP_CALC2_handler,
+        [OP_CALC3] = &&OP_CALC3_handler,
+        [OP_CALC_TEST] = &&OP_CALC_TEST_handler,
+        [OP_CALC_END] = &&OP_CALC_END_handler,
+        [OP_TEST_CALC] = &&OP_TEST_CALC_handler,
+        [OP_GCALC] = &&OP_GCALC_handler,
+        [OP_GTEST] = &&OP_GTEST_handler,
+        [OP_INVALID] = &&OP_INVALID_handler,
+    };
+    // Recording a profile sends every opcode through a counting handler first
+    static void *const profiled[OP_COUNT] = { [0 ... OP_COUNT - 1] = &&PROFILE_handler };
+    void *const *table = opProfile.path || execProfile.path ? profiled : handlers;
+#endif
+
+    int frameBase = state.frameCount;
+    int loopBase = state.loopTop;
+    int frameSize = program.maxDepth + 1;
+    if (loopBase + frameSize > MAX_LOOP_STATES) {
+        fprintf(stderr, "Error: Blocks nested too deeply\n");
+        return;
+    }
+    LoopState *loops = state.loopStack + loopBase;
+    for (int i = 0; i < frameSize; i++) loops[i].header = -1;
+    state.loopTop += frameSize;
+
+    int pc = start;
+    int limit = end;
+    const Instr *in;
+
+#ifdef MITS_COMPUTED_GOTO
+    DISPATCH();
+    {
+    PROFILE_handler:
+        recordDispatch(pc, in);
+        goto *handlers[in->op];
+#else
+dispatch:
+    if (pc > limit) goto done;
+    in = &program.code[pc];
+    if (opProfile.path || execProfile.path) recordDispatch(pc, in);
+
+    {
+        switch (in->op) {
+#endif
+
+        TARGET(OP_NOP)
+            // Labels and blank lines
+            NEXT();
+
+        TARGET(OP_INVALID)
+            // Reported by verifyProgram before the run
+            NEXT();
+
+        TARGET(OP_MOV)
+            addRegister(in->dest, evalOperand(operandAt(&program, in, 0)));
+            NEXT();
+
+        TARGET(OP_RDL)
+            executeRdl(in);
+            NEXT();
+
+        TARGET(OP_CHAR) {
+            const char *text = poolText(&program, operandAt(&program, in, 0)->ref);
+            addRegister(in->dest, makeString(text, strlen(text)));
+            NEXT();
         }
-        else if (strcmp(flag, "-ne") == 0) {
-            // New element: wasm -ne type="h1" txt="..." id="..." class="..." style="..."
-            char elemData[512];
-            strcpy(elemData, remaining);
-            
-            WasmElement elem = {0};
-            
-            // Parse type="..."
-            char *typeStart = strstr(elemData, "type=\"");
-            if (typeStart) {
-                typeStart += 6;
-                char *typeEnd = strchr(typeStart, '"');
-                if (typeEnd) {
-                    strncpy(elem.type, typeStart, typeEnd - typeStart);
-                    elem.type[typeEnd - typeStart] = '\0';
-                }
-            }
-            
-            // Parse txt="..."
-            char *txtStart = strstr(elemData, "txt=\"");
-            if (txtStart) {
-                txtStart += 5;
-                char *txtEnd = strchr(txtStart, '"');
-                if (txtEnd) {
-                    strncpy(elem.txt, txtStart, txtEnd - txtStart);
-                    elem.txt[txtEnd - txtStart] = '\0';
-                }
-            }
-            
-            // Parse id="..."
-            char *idStart = strstr(elemData, "id=\"");
-            if (idStart) {
-                idStart += 4;
-                char *idEnd = strchr(idStart, '"');
-                if (idEnd) {
-                    strncpy(elem.id, idStart, idEnd - idStart);
-                    elem.id[idEnd - idStart] = '\0';
-                }
-            }
-            
-            // Parse class="..."
-            char *classStart = strstr(elemData, "class=\"");
-            if (classStart) {
-                classStart += 7;
-                char *classEnd = strchr(classStart, '"');
-                if (classEnd) {
-                    strncpy(elem.class, classStart, classEnd - classStart);
-                    elem.class[classEnd - classStart] = '\0';
-                }
-            }
-            
-            // Parse style="..."
-            char *styleStart = strstr(elemData, "style=\"");
-            if (styleStart) {
-                styleStart += 7;
-                char *styleEnd = strchr(styleStart, '"');
-                if (styleEnd) {
-                    strncpy(elem.style, styleStart, styleEnd - styleStart);
-                    elem.style[styleEnd - styleStart] = '\0';
-                }
-            }
-            
-            printf("[WASM] Element created: <%s id=\"%s\">\n", elem.type, elem.id);
-            
-            // Store in element registry (attach to current/default page if exists)
-            if (wasmState.pageCount > 0) {
-                WasmPage *currentPage = &wasmState.pages[wasmState.pageCount - 1];
-                if (currentPage->elementCount < MAX_WASM_ELEMENTS) {
-                    currentPage->elements[currentPage->elementCount++] = elem;
-                }
-            } else {
-                // Create default page if none exists
-                if (wasmState.pageCount < MAX_WASM_PAGES) {
-                    strcpy(wasmState.pages[wasmState.pageCount].name, "default");
-                    wasmState.pages[wasmState.pageCount].elementCount = 0;
-                    if (wasmState.pages[wasmState.pageCount].elementCount < MAX_WASM_ELEMENTS) {
-                        wasmState.pages[wasmState.pageCount].elements[0] = elem;
-                        wasmState.pages[wasmState.pageCount].elementCount = 1;
-                    }
-                    wasmState.pageCount++;
-                }
+
+        TARGET(OP_ADDR)
+            executeAddr(in);
+            NEXT();
+
+        TARGET(OP_SUBR)
+        TARGET(OP_MUL)
+        TARGET(OP_DIV)
+        TARGET(OP_MOD)
+            addRegister(in->dest, evaluateValue(in, 0));
+            NEXT();
+
+        TARGET(OP_CALC)
+            storeCalc(in);
+            NEXT();
+
+        TARGET(OP_CALC2)
+            storeCalc(in);
+            storeCalc(in + 1);
+            pc += 2;
+            DISPATCH();
+
+        TARGET(OP_CALC3)
+            storeCalc(in);
+            storeCalc(in + 1);
+            storeCalc(in + 2);
+            pc += 3;
+            DISPATCH();
+
+        TARGET(OP_CALC_TEST)
+            storeCalc(in++);
+            pc++;
+            RUN_TEST();
+
+        TARGET(OP_CALC_END)
+            storeCalc(in++);
+            pc++;
+            RUN_END();
+
+        TARGET(OP_TEST_CALC) {
+            const Operand *args = operandAt(&program, in, 0);
+            if (!compareNumbers(in->mode, numberAt(&args[0]), numberAt(&args[1]))) {
+                JUMP((in->alt >= 0 ? in->alt : in->target) + 1);
             }
+            storeCalc(in + 1);
+            pc += 2;
+            DISPATCH();
         }
-        else if (strcmp(flag, "-ae") == 0) {
-            // Attach element: wasm -ae id="elemid" page="pagename"
-            char idSpec[256];
-            remaining = getFirstWord(remaining, idSpec);
-            
-            char pageSpec[256];
-            remaining = getFirstWord(remaining, pageSpec);
-            
-            char elemId[64] = "";
-            char *idVal = strchr(idSpec, '"');
-            if (idVal) {
-                idVal++;
-                char *idEnd = strchr(idVal, '"');
-                if (idEnd) {
-                    strncpy(elemId, idVal, idEnd - idVal);
-                    elemId[idEnd - idVal] = '\0';
-                }
-            }
-            
-            char pageName[64] = "";
-            char *pageVal = strchr(pageSpec, '"');
-            if (pageVal) {
-                pageVal++;
-                char *pageEnd = strchr(pageVal, '"');
-                if (pageEnd) {
-                    strncpy(pageName, pageVal, pageEnd - pageVal);
-                    pageName[pageEnd - pageVal] = '\0';
-                }
+
+        TARGET(OP_GCALC)
+            if (holdsNumbers(in)) {
+                int first = in->target == OP_ADDR && in->mode == ADDR_CONCAT ? 2 : 0;
+                storeNumber(in->dest, calculate(in, first));
+            } else {
+                executeStore(in, in->target);
             }
-            
-            printf("[WASM] Attaching '%s' to page '%s'\n", elemId, pageName);
-        }
-        else if (strcmp(flag, "-op") == 0) {
-            // Open port: wasm -op port_number -ap page="name"
-            char portStr[64];
-            remaining = getFirstWord(remaining, portStr);
-            
-            char apFlag[64] = "";
-            remaining = getFirstWord(remaining, apFlag);
-            
-            char pageSpec[256];
-            remaining = getFirstWord(remaining, pageSpec);
-            
-            char pageName[64] = "";
-            char *pageVal = strchr(pageSpec, '"');
-            if (pageVal) {
-                pageVal++;
-                char *pageEnd = strchr(pageVal, '"');
-                if (pageEnd) {
-                    strncpy(pageName, pageVal, pageEnd - pageVal);
-                    pageName[pageEnd - pageVal] = '\0';
-                }
+            NEXT();
+
+        TARGET(OP_SDA) {
+            long long sum = 0;
+            if (in->mode == SDA_ARGUMENTS) {
+                for (int i = 0; i < state.argCount; i++) sum += state.argStack[state.argBase + i];
+            } else {
+                const Operand *args = operandAt(&program, in, 0);
+                for (int i = 0; i < in->argc; i++) sum += evalNumber(&args[i]);
             }
-            
-            int port = atoi(portStr);
-            strcpy(wasmState.activePage, pageName);
-            wasmState.webPort = port;
-            
-            printf("[WASM] Starting web server on port %d\n", port);
-            startWebServer(port);
+            addRegister(in->dest, makeNumber(sum));
+            NEXT();
         }
-        else if (strcmp(flag, "-ns") == 0) {
-            // New script: wasm -ns ftype="clang" id="scriptid" exec => { C code }
-            // For now, skip JS and just support C compilation
-            printf("[WASM] Script registration - JS skipped, C only\n");
-        }
-    }
-}
 
-void executeProgram(int startLine, int endLine) {
-    for (int i = startLine; i <= endLine && !state.shouldExit; i++) {
-        char *line = lines[i];
-        if (strlen(line) == 0 || line[0] == ';') continue;
-        
-        // Skip label lines (label: format, but not "exec:" or "something: ...")
-        if (line[strlen(line) - 1] == ':') {
-            // Only skip if it's a label (starts right after whitespace with text then :)
-            char temp[512];
-            strcpy(temp, line);
-            trimWhitespace(temp);
-            if (strchr(temp, ' ') == NULL) {
-                // No space, so it's just "label:"
-                continue;
+        TARGET(OP_VGA)
+            executeVga(in);
+            NEXT();
+
+        TARGET(OP_EXEC)
+            executeExec(in);
+            if (state.shouldExit) goto done;
+            NEXT();
+
+        TARGET(OP_READ)
+            executeRead(in);
+            NEXT();
+
+        TARGET(OP_REQ)
+            // An imported file may exit the whole program
+            executeReq(in);
+            if (state.shouldExit) goto done;
+            NEXT();
+
+        TARGET(OP_WASM)
+            executeWasm(in);
+            NEXT();
+
+        TARGET(OP_VEC)
+            executeVec(in);
+            NEXT();
+
+        TARGET(OP_BUF)
+            executeBuf(in);
+            NEXT();
+
+        TARGET(OP_STR)
+            executeStr(in);
+            NEXT();
+
+        TARGET(OP_FOR) {
+            // for mov index, start, end, exec: ... end
+            LoopState *loop = &loops[in->depth];
+            loop->header = -1;
+
+            if (jitEnabled) {
+                int next = runNativeLoop(pc);
+                if (next >= 0) JUMP(next);
             }
+
+            // A header that cannot run leaves its body to execute once
+            if (in->mode != FOR_OK) NEXT();
+
+            Value start_val = evalOperand(operandAt(&program, in, 0));
+            Value end_val = evalOperand(operandAt(&program, in, 1));
+            int numeric = start_val.type == TYPE_NUMBER && end_val.type == TYPE_NUMBER;
+            releaseValue(start_val);
+            releaseValue(end_val);
+            if (!numeric) NEXT();
+
+            if (start_val.data.numValue > end_val.data.numValue) JUMP(in->target + 1);
+
+            loop->header = pc;
+            loop->slot = in->dest;
+            loop->current = start_val.data.numValue;
+            loop->last = end_val.data.numValue;
+            addRegister(in->dest, makeNumber(loop->current));
+            NEXT();
         }
 
-        char instruction[64];
-        getFirstWord(line, instruction);
+        TARGET(OP_END)
+            RUN_END();
 
-        if (strcmp(instruction, "for") == 0) {
-            // Parse: for mov index, start, end, exec: ... end
-            char line_copy[512];
-            strcpy(line_copy, line);
-            
-            // Skip "for " to get "mov index, start, end, exec:"
-            char *for_part = line_copy + 4;
-            
-            // Find exec: to separate the declaration from exec:
-            char *exec_marker = strstr(for_part, ", exec:");
-            if (exec_marker) {
-                *exec_marker = '\0'; // Terminate at ", exec:"
-                trimWhitespace(for_part);
-                
-                // Now for_part contains "mov index, start, end"
-                // Need to parse: mov VAR, START, END
-                char for_copy[256];
-                strcpy(for_copy, for_part);
-                
-                // Replace commas with spaces for tokenization
-                for (int c = 0; c < (int)strlen(for_copy); c++) {
-                    if (for_copy[c] == ',') for_copy[c] = ' ';
-                }
-                
-                char *mov_word = strtok(for_copy, " ");
-                char *var_name = strtok(NULL, " ");
-                char *start_str = strtok(NULL, " ");
-                char *end_str = strtok(NULL, " ");
-                
-                if (mov_word && var_name && start_str && end_str && strcmp(mov_word, "mov") == 0) {
-                    if (isValidVarName(var_name)) {
-                        Value start_val = parseValue(start_str);
-                        Value end_val = parseValue(end_str);
-                        
-                        if (start_val.type == TYPE_NUMBER && end_val.type == TYPE_NUMBER) {
-                            long long start = start_val.data.numValue;
-                            long long end = end_val.data.numValue;
-                            
-                            int for_end = findMatchingEnd(i);
-                            
-                            // Execute for loop
-                            for (long long loop_val = start; loop_val <= end; loop_val++) {
-                                // Set loop variable
-                                Value loop_value;
-                                loop_value.type = TYPE_NUMBER;
-                                loop_value.data.numValue = loop_val;
-                                addRegister(var_name, loop_value);
-                                
-                                // Execute body using executeProgram for nested construct support
-                                executeProgram(i + 1, for_end - 1);
-                                
-                                if (state.shouldExit) break;
-                            }
-                            
-                            i = for_end;
-                        }
-                    }
-                }
-            }
-        } else if (strcmp(instruction, "cond") == 0) {
-            // Parse conditional: cond a OP b, exec: ... end
-            // Supports: <, >, <=, >=, ==, !=
-            char line_copy[512];
-            strcpy(line_copy, line);
-            
-            // Remove leading "cond "
-            char *cond_part = line_copy + 5;
-            
-            // Find comma
-            char *comma = strchr(cond_part, ',');
-            if (comma) {
-                *comma = '\0'; // Terminate at comma
-                
-                // Now cond_part contains "a OP b"
-                trimWhitespace(cond_part);
-                
-                // Tokenize to get left, op, right
-                char cond_copy[256];
-                strcpy(cond_copy, cond_part);
-                
-                char *left_str = strtok(cond_copy, " ");
-                char *op = strtok(NULL, " ");
-                char *right_str = strtok(NULL, " ");
-                
-                if (left_str && op && right_str) {
-                    Value left = parseValue(left_str);
-                    Value right = parseValue(right_str);
-                    
-                    int cond_true = 0;
-                    if (left.type == TYPE_NUMBER && right.type == TYPE_NUMBER) {
-                        long long l = left.data.numValue;
-                        long long r = right.data.numValue;
-                        
-                        if (strcmp(op, "<") == 0) cond_true = (l < r);
-                        else if (strcmp(op, ">") == 0) cond_true = (l > r);
-                        else if (strcmp(op, "<=") == 0) cond_true = (l <= r);
-                        else if (strcmp(op, ">=") == 0) cond_true = (l >= r);
-                        else if (strcmp(op, "==") == 0) cond_true = (l == r);
-                        else if (strcmp(op, "!=") == 0) cond_true = (l != r);
-                    }
-                    
-                    int end_line = findMatchingEnd(i);
-                    int else_line = -1;
-                    
-                    // Look for else block (line must be exactly "else")
-                    for (int j = i + 1; j < end_line; j++) {
-                        if (strcmp(lines[j], "else") == 0) {
-                            else_line = j;
-                            break;
-                        }
-                    }
-                    
-                    if (cond_true) {
-                        // Execute lines from i+1 until "else" or "end"
-                        for (int j = i + 1; j < end_line; j++) {
-                            if (strcmp(lines[j], "else") == 0) break;
-                            if (strcmp(lines[j], "exec:") == 0) continue;
-                            if (lines[j][0] == '\0') continue;
-                            
-                            executeInstruction(lines[j]);
-                            if (state.shouldExit) break;
-                        }
-                    } else if (else_line != -1) {
-                        // Execute lines from else_line+1 until "end"
-                        for (int j = else_line + 1; j < end_line; j++) {
-                            if (strcmp(lines[j], "end") == 0) break;
-                            if (lines[j][0] == '\0') continue;
-                            
-                            executeInstruction(lines[j]);
-                            if (state.shouldExit) break;
-                        }
-                    }
-                    
-                    i = end_line;
+        TARGET(OP_COND)
+            // cond a OP b, exec: ... [else ...] end
+            if (in->mode == CMP_MALFORMED || evaluateCondition(in)) NEXT();
+            JUMP((in->alt >= 0 ? in->alt : in->target) + 1);
 
+        TARGET(OP_TEST)
+            RUN_TEST();
 
+        TARGET(OP_GTEST)
+            if (holdsNumbers(in)) RUN_TEST();
+            if (evaluateCondition(in)) NEXT();
+            JUMP((in->alt >= 0 ? in->alt : in->target) + 1);
 
+        TARGET(OP_ELSE)
+            // Reached at the end of the taken branch; a malformed cond runs both
+            if (in->alt >= 0 && program.code[in->alt].mode != CMP_MALFORMED) JUMP(in->target + 1);
+            NEXT();
+
+        TARGET(OP_DEF)
+            // Skip function definitions
+            JUMP(in->target + 1);
+
+        TARGET(OP_CALL) {
+            // exec name, arguments...: arguments are numbers, read by ARGUMENTS
+            const Instr *def = &program.code[in->target];
+            int count = def->mode & DEF_ARGUMENTS ? in->argc - 1 : 0;
+            if (count > MAX_ARGS) count = MAX_ARGS;
+            frameSize = program.maxDepth + 1;
+            if (state.frameCount == MAX_CALL_DEPTH || state.argTop + count > MAX_ARG_STACK ||
+                state.loopTop + frameSize > MAX_LOOP_STATES) {
+                fprintf(stderr, "Error: Call stack overflow in '%s'\n", slotName(def->dest));
+                state.exitCode = 1;
+                state.shouldExit = 1;
+                goto done;
+            }
 
+            const Operand *args = operandAt(&program, in, 1);
+            long long *values = state.argStack + state.argTop;
+            for (int i = 0; i < count; i++) values[i] = evalNumber(&args[i]);
 
-                }
+            // A memoized def sees its arguments only as their sum
+            MemoCache *memo = def->mode & DEF_MEMO ? memoFor(in->target) : NULL;
+            long long key = 0;
+            if (memo) {
+                for (int i = 0; i < count; i++) key = (long long)((unsigned long long)key + values[i]);
+                if (recallCall(memo, key)) NEXT();
             }
 
-        } else if (strcmp(instruction, "def") == 0) {
-            // Skip function definitions
-            i = findMatchingEnd(i);
-        } else {
-            executeInstruction(line);
+            CallFrame *frame = &state.frames[state.frameCount++];
+            frame->returnPc = pc + 1;
+            frame->memo = memo;
+            frame->memoKey = key;
+            frame->argBase = state.argBase;
+            frame->argCount = state.argCount;
+            frame->loopBase = loops - state.loopStack;
+            state.argBase = state.argTop;
+            state.argCount = count;
+            state.argTop += count;
+
+            loops = state.loopStack + state.loopTop;
+            for (int i = 0; i < frameSize; i++) loops[i].header = -1;
+            state.loopTop += frameSize;
+            limit = program.codeCount - 1;
+            JUMP(in->target + 1);
         }
+
+        TARGET(OP_RET)
+            // End of a def; reached without a call it is just an end
+            if (state.frameCount == frameBase) NEXT();
+            RETURN_FROM_CALL();
+
+#ifndef MITS_COMPUTED_GOTO
+        default:
+            NEXT();
+        }
+#endif
     }
-}
 
-int main(int argc, char *argv[]) {
-    if (argc < 2) {
-        fprintf(stderr, "Usage: %s <input.s> [rom.data]\n", argv[0]);
-        return 1;
+done:
+    // A def left unterminated returns when it runs off the program
+    if (state.frameCount > frameBase && !state.shouldExit) RETURN_FROM_CALL();
+
+    // exec stopped the program mid-call; drop what this range pushed
+    if (state.frameCount > frameBase) {
+        state.argBase = state.frames[frameBase].argBase;
+        state.argCount = state.frames[frameBase].argCount;
+        state.frameCount = frameBase;
     }
+    state.argTop = state.argBase + state.argCount;
+    state.loopTop = loopBase;
+}
 
-    // Parse ROM file (optional)
-    if (argc >= 3) {
-        parseROMFile(argv[2]);
+#undef RETURN_FROM_CALL
+#undef RUN_TEST
+#undef RUN_END
+#undef TARGET
+#undef DISPATCH
+#undef NEXT
+#undef JUMP
+
+int main(int argc, char *argv[]) {
+    // Options may appear anywhere; the rest are <input> [rom.data]
+    const char *files[2] = {NULL, NULL};
+    int fileCount = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--jit") == 0) {
+            jitEnabled = 1;
+        } else if (strcmp(argv[i], "--profile-ops") == 0 && i + 1 < argc) {
+            opProfile.path = argv[++i];
+        } else if (strcmp(argv[i], "--write-profile") == 0 && i + 1 < argc) {
+            execProfile.path = argv[++i];
+        } else if (strcmp(argv[i], "--memo-stats") == 0) {
+            memoStats = 1;
+        } else if (strcmp(argv[i], "--simd") == 0 && i + 1 < argc) {
+            const char *level = argv[++i];
+            simdLimit = strcmp(level, "scalar") == 0 ? SIMD_SCALAR : strcmp(level, "sse2") == 0 ? SIMD_SSE2 : SIMD_AVX2;
+        } else if (fileCount < 2) {
+            files[fileCount++] = argv[i];
+        }
     }
 
-    // Read assembly file
-    FILE *in = fopen(argv[1], "r");
-    if (!in) {
-        fprintf(stderr, "Error: Cannot open input file '%s'\n", argv[1]);
+    if (fileCount < 1) {
+        fprintf(stderr, "Usage: %s [--jit] [--profile-ops file] [--write-profile file] [--memo-stats] [--simd scalar|sse2|avx2] <input.s|module> [rom.data]\n", argv[0]);
         return 1;
     }
+    if (jitEnabled && !jitAvailable()) {
+        fprintf(stderr, "Warning: --jit is not supported on this platform, interpreting instead\n");
+        jitEnabled = 0;
+    }
+    if (jitEnabled && (opProfile.path || execProfile.path)) {
+        // Native loops never reach the profiling hooks
+        fprintf(stderr, "Warning: --jit is off while profiling, so every instruction is counted\n");
+        jitEnabled = 0;
+    }
+    selectDigests(selectSimd(simdLimit));
 
-    while (lineCount < MAX_LINES && fgets(lines[lineCount], MAX_LINE_LENGTH, in)) {
-        trimWhitespace(lines[lineCount]);
-        lineCount++;
+    // Parse ROM file (optional)
+    if (files[1]) {
+        parseROMFile(files[1]);
     }
-    fclose(in);
 
-    // Find _start label
+    // A compiled module is mapped as-is; anything else is assembly text
     int startIdx = -1;
-    for (int i = 0; i < lineCount; i++) {
-        if (strcmp(lines[i], "_start:") == 0) {
-            startIdx = i + 1;
-            break;
+    int loaded = loadModule(&program, &startIdx, files[0]);
+    if (loaded < 0) return 1;
+
+    if (!loaded) {
+        FILE *in = fopen(files[0], "r");
+        if (!in) {
+            fprintf(stderr, "Error: Cannot open input file '%s'\n", files[0]);
+            return 1;
         }
+
+        char line[MAX_LINE_LENGTH];
+        while (program.codeCount < MAX_LINES && fgets(line, MAX_LINE_LENGTH, in)) {
+            trimWhitespace(line);
+            int index = decodeLine(&program, line, program.codeCount + 1);
+
+            // Find _start label
+            if (startIdx == -1 && strcmp(line, "_start:") == 0) {
+                startIdx = index + 1;
+            }
+        }
+        fclose(in);
+        resolveBlocks(&program, 0);
     }
 
     if (startIdx == -1) {
         fprintf(stderr, "Error: Missing _start: label\n");
         return 1;
     }
+    if (verifyProgram(&program, 0, files[0]) < 0) return 1;
+
+    if (opProfile.path) {
+        opProfile.pairs = calloc(OP_COUNT * OP_COUNT, sizeof(long long));
+        opProfile.triples = calloc(OP_COUNT * OP_COUNT * OP_COUNT, sizeof(long long));
+        if (!opProfile.pairs || !opProfile.triples) {
+            fprintf(stderr, "Error: Out of memory for the op profile\n");
+            return 1;
+        }
+    }
+
+    if (execProfile.path) {
+        execProfile.size = program.codeCount;
+        execProfile.counts = calloc(program.codeCount + 1, sizeof(long long));
+        execProfile.taken = calloc(program.codeCount + 1, sizeof(long long));
+        execProfile.types = calloc(program.codeCount + 1, 1);
+        if (!execProfile.counts || !execProfile.taken || !execProfile.types) {
+            fprintf(stderr, "Error: Out of memory for the profile\n");
+            return 1;
+        }
+    }
+
+    bindROMOperands();
+    for (int i = 0; i < program.codeCount && !memoCaches; i++) {
+        if (program.code[i].op == OP_DEF && (program.code[i].mode & DEF_MEMO)) {
+            memoCapacity = program.codeCount;
+            memoCaches = calloc(memoCapacity, sizeof(MemoCache *));
+            if (!memoCaches) memoCapacity = 0;
+        }
+    }
 
     // Execute program
-    executeProgram(startIdx, lineCount - 1);
+    executeRange(startIdx, program.codeCount - 1);
+    if (opProfile.path) writeOpProfile();
+    if (execProfile.path) writeExecProfile();
+    if (memoStats) writeMemoStats();
 
     if (state.exitCode != 0) {
         printf("program finished with: code %d\n", state.exitCode);
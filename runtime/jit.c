@@ -0,0 +1,540 @@
+#include "jit.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <sys/mman.h>
+
+// A for with constant bounds and a straight-line body is unrolled when it
+// runs at most UNROLL_TRIPS times and the copies stay within UNROLL_SIZE
+// instructions
+#define UNROLL_TRIPS 8
+#define UNROLL_SIZE 32
+
+// x86-64 registers used by the generated code
+enum { RAX, RCX, RDX, RBX };
+
+typedef struct {
+    unsigned char *code;
+    int size;
+    int capacity;
+    int *labels;            // code offset of each instruction, header..end+1
+    int *fixups;            // (rel32 offset, instruction index) pairs
+    int fixupCount;
+    int fixupCapacity;
+    int *frameIndex;        // register slot -> frame entry, -1 if unused
+    int *flagIndex;         // register slot -> write flag, -1 if never written
+    int *counters;          // instruction -> counter pair of a for, -1 otherwise
+    int sequence;           // frame index of the first-store counter
+    int first;
+    int failed;
+} Emitter;
+
+static void emitByte(Emitter *e, int byte) {
+    if (e->size == e->capacity) {
+        int capacity = e->capacity ? e->capacity * 2 : 4096;
+        unsigned char *code = realloc(e->code, capacity);
+        if (!code) {
+            e->failed = 1;
+            e->size = 0;
+            return;
+        }
+        e->code = code;
+        e->capacity = capacity;
+    }
+    e->code[e->size++] = byte;
+}
+
+static void emitBytes(Emitter *e, const char *bytes, int count) {
+    for (int i = 0; i < count; i++) emitByte(e, (unsigned char)bytes[i]);
+}
+
+static void emit32(Emitter *e, long long value) {
+    for (int i = 0; i < 4; i++) emitByte(e, (value >> (8 * i)) & 0xff);
+}
+
+static void emit64(Emitter *e, long long value) {
+    for (int i = 0; i < 8; i++) emitByte(e, (value >> (8 * i)) & 0xff);
+}
+
+static void patch32(Emitter *e, int at, int value) {
+    if (e->failed) return;
+    for (int i = 0; i < 4; i++) e->code[at + i] = (value >> (8 * i)) & 0xff;
+}
+
+// Emit a jump opcode with an empty rel32 and return where the rel32 lives
+static int emitJump(Emitter *e, const char *opcode, int count) {
+    emitBytes(e, opcode, count);
+    int at = e->size;
+    emit32(e, 0);
+    return at;
+}
+
+// Point a jump emitted by emitJump at the current position
+static void landJump(Emitter *e, int at) {
+    patch32(e, at, e->size - (at + 4));
+}
+
+// Jump to the start of instruction index, resolved once every label is known
+static void jumpTo(Emitter *e, const char *opcode, int count, int index) {
+    int at = emitJump(e, opcode, count);
+    if (e->fixupCount == e->fixupCapacity) {
+        int capacity = e->fixupCapacity ? e->fixupCapacity * 2 : 64;
+        int *fixups = realloc(e->fixups, capacity * 2 * sizeof(int));
+        if (!fixups) {
+            e->failed = 1;
+            return;
+        }
+        e->fixups = fixups;
+        e->fixupCapacity = capacity;
+    }
+    e->fixups[2 * e->fixupCount] = at;
+    e->fixups[2 * e->fixupCount + 1] = index;
+    e->fixupCount++;
+}
+
+// mov reg, [rbx + index*8] / mov [rbx + index*8], reg
+static void loadFrame(Emitter *e, int reg, int index) {
+    emitBytes(e, "\x48\x8b", 2);
+    emitByte(e, 0x83 | (reg << 3));
+    emit32(e, index * 8);
+}
+
+static void storeFrame(Emitter *e, int reg, int index) {
+    emitBytes(e, "\x48\x89", 2);
+    emitByte(e, 0x83 | (reg << 3));
+    emit32(e, index * 8);
+}
+
+static void loadOperand(Emitter *e, int reg, const Operand *op) {
+    if (op->kind == OPD_REGISTER) {
+        loadFrame(e, reg, e->frameIndex[op->ref]);
+    } else if (op->num >= -2147483648LL && op->num <= 2147483647LL) {
+        // mov reg, imm32 (sign-extended)
+        emitBytes(e, "\x48\xc7", 2);
+        emitByte(e, 0xc0 | reg);
+        emit32(e, op->num);
+    } else {
+        // mov reg, imm64
+        emitByte(e, 0x48);
+        emitByte(e, 0xb8 | reg);
+        emit64(e, op->num);
+    }
+}
+
+// Store rax into a register. The first store to each register also
+// numbers its flag, so the caller can define new registers in the order
+// the interpreter would have.
+static void storeRegister(Emitter *e, int slot) {
+    storeFrame(e, RAX, e->frameIndex[slot]);
+    emitBytes(e, "\x48\x83\xbb", 3);             // cmp qword [rbx + flag], 0
+    emit32(e, e->flagIndex[slot] * 8);
+    emitByte(e, 0);
+    int stored = emitJump(e, "\x0f\x85", 2);      // jne
+    loadFrame(e, RDX, e->sequence);
+    emitBytes(e, "\x48\xff\xc2", 3);             // inc rdx
+    storeFrame(e, RDX, e->sequence);
+    storeFrame(e, RDX, e->flagIndex[slot]);
+    landJump(e, stored);
+}
+
+// rax = rax / rcx or rax % rcx; dividing by zero gives 0 like the
+// interpreter, and -1 is handled without idiv so LLONG_MIN cannot trap
+static void emitDivide(Emitter *e, int modulo) {
+    emitBytes(e, "\x48\x85\xc9", 3);                // test rcx, rcx
+    int byZero = emitJump(e, "\x0f\x84", 2);        // jz
+    emitBytes(e, "\x48\x83\xf9\xff", 4);            // cmp rcx, -1
+    int byMinusOne = emitJump(e, "\x0f\x84", 2);    // je
+    emitBytes(e, "\x48\x99", 2);                    // cqo
+    emitBytes(e, "\x48\xf7\xf9", 3);                // idiv rcx
+    if (modulo) emitBytes(e, "\x48\x89\xd0", 3);    // mov rax, rdx
+    int done = emitJump(e, "\xe9", 1);
+
+    landJump(e, byMinusOne);
+    if (modulo) {
+        emitBytes(e, "\x31\xc0", 2);                // xor eax, eax
+    } else {
+        emitBytes(e, "\x48\xf7\xd8", 3);            // neg rax
+    }
+    int done2 = emitJump(e, "\xe9", 1);
+
+    landJump(e, byZero);
+    emitBytes(e, "\x31\xc0", 2);                    // xor eax, eax
+    landJump(e, done);
+    landJump(e, done2);
+}
+
+// Operands the JIT can read straight from the frame or as an immediate
+static int isSimple(const Operand *op) {
+    return op->kind == OPD_NUMBER || (op->kind == OPD_REGISTER && op->num == 0);
+}
+
+static int allSimple(const Program *prog, const Instr *in, int first) {
+    for (int i = first; i < in->argc; i++) {
+        if (!isSimple(operandAt(prog, in, i))) return 0;
+    }
+    return 1;
+}
+
+// Expression operands: simple leaves plus the arithmetic operators
+static int isExpression(const Program *prog, const Instr *in, int first) {
+    for (int i = first; i < in->argc; i++) {
+        const Operand *op = operandAt(prog, in, i);
+        if (op->kind < OPD_ADD && !isSimple(op)) return 0;
+    }
+    return 1;
+}
+
+// Evaluate a postfix expression into rax. Pending left operands wait on
+// the machine stack; the emitted code makes no calls, so its alignment
+// does not matter.
+static void emitExpression(Emitter *e, const Operand *ops, int count) {
+    for (int i = 0; i < count; i++) {
+        const Operand *op = &ops[i];
+        switch (op->kind) {
+        case OPD_NEG:
+            emitBytes(e, "\x48\xf7\xd8", 3);        // neg rax
+            continue;
+        case OPD_ADD:
+        case OPD_SUB:
+        case OPD_MUL:
+        case OPD_DIV:
+        case OPD_MOD:
+            emitBytes(e, "\x48\x89\xc1", 3);        // mov rcx, rax
+            emitByte(e, 0x58);                      // pop rax
+            break;
+        default:
+            if (i > 0) emitByte(e, 0x50);           // push rax
+            loadOperand(e, RAX, op);
+            continue;
+        }
+
+        if (op->kind == OPD_ADD) {
+            emitBytes(e, "\x48\x01\xc8", 3);        // add rax, rcx
+        } else if (op->kind == OPD_SUB) {
+            emitBytes(e, "\x48\x29\xc8", 3);        // sub rax, rcx
+        } else if (op->kind == OPD_MUL) {
+            emitBytes(e, "\x48\x0f\xaf\xc1", 4);    // imul rax, rcx
+        } else {
+            emitDivide(e, op->kind == OPD_MOD);
+        }
+    }
+}
+
+// Check that every instruction in header..end is one the JIT handles
+static int isCompilable(const Program *prog, int header, int end) {
+    for (int i = header; i <= end; i++) {
+        const Instr *in = &prog->code[i];
+        switch (baseOp(in)) {
+        case OP_NOP:
+            break;
+        case OP_MOV:
+            if (in->argc != 1 || !allSimple(prog, in, 0)) return 0;
+            break;
+        case OP_ADDR:
+        case OP_SUBR:
+        case OP_MUL:
+        case OP_DIV:
+        case OP_MOD:
+        case OP_CALC: {
+            int first = in->op == OP_ADDR && in->mode == ADDR_CONCAT ? 2 : 0;
+            if (in->argc <= first || !isExpression(prog, in, first)) return 0;
+            break;
+        }
+        case OP_SDA:
+            if (in->mode != SDA_LIST || !allSimple(prog, in, 0)) return 0;
+            break;
+        case OP_FOR:
+            if (in->mode != FOR_OK || in->argc != 2 || !allSimple(prog, in, 0)) return 0;
+            if (in->target <= i || in->target > end || prog->code[in->target].op != OP_END) return 0;
+            break;
+        case OP_COND:
+        case OP_TEST:
+            if (in->mode == CMP_NONE || in->mode == CMP_MALFORMED) return 0;
+            if (in->argc != 2 || !allSimple(prog, in, 0)) return 0;
+            if (in->target <= i || in->target > end) return 0;
+            break;
+        case OP_ELSE:
+            if (in->alt < header || in->target > end) return 0;
+            break;
+        case OP_END:
+            if (in->target < header) return 0;
+            break;
+        default:
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void addSlot(int *frameIndex, int *slots, int *count, int slot) {
+    if (frameIndex[slot] < 0) {
+        frameIndex[slot] = *count;
+        slots[(*count)++] = slot;
+    }
+}
+
+// Number of copies to unroll the for at index i into, 0 to keep it a loop
+static int unrollCount(const Program *prog, int i) {
+    const Instr *in = &prog->code[i];
+    if (in->op != OP_FOR) return 0;
+    const Operand *first = operandAt(prog, in, 0);
+    const Operand *last = operandAt(prog, in, 1);
+    if (first->kind != OPD_NUMBER || last->kind != OPD_NUMBER || first->num > last->num) return 0;
+    unsigned long long span = (unsigned long long)last->num - (unsigned long long)first->num;
+    if (span >= UNROLL_TRIPS) return 0;
+
+    int trips = (int)span + 1;
+    int size = in->target - i - 1;
+    if (size * trips > UNROLL_SIZE) return 0;
+    for (int j = i + 1; j < in->target; j++) {
+        switch (baseOp(&prog->code[j])) {
+        case OP_NOP:
+        case OP_MOV:
+        case OP_ADDR:
+        case OP_SUBR:
+        case OP_MUL:
+        case OP_DIV:
+        case OP_MOD:
+        case OP_SDA:
+        case OP_CALC:
+            break;
+        default:
+            return 0;
+        }
+    }
+    return trips;
+}
+
+static void emitInstruction(Emitter *e, const Program *prog, int i);
+
+// Emit the body of the for at index i once per value of its register.
+// Nothing can jump into a straight-line body, so its copies need no labels.
+static void emitUnrolled(Emitter *e, const Program *prog, int i, int trips) {
+    const Instr *in = &prog->code[i];
+    long long value = operandAt(prog, in, 0)->num;
+    for (int k = 0; k < trips; k++) {
+        Operand index = { .kind = OPD_NUMBER, .ref = -1, .num = value + k };
+        loadOperand(e, RAX, &index);
+        storeRegister(e, in->dest);
+        for (int j = i + 1; j < in->target; j++) emitInstruction(e, prog, j);
+    }
+}
+
+static void emitInstruction(Emitter *e, const Program *prog, int i) {
+    const Instr *in = &prog->code[i];
+    const Operand *args = in->argc ? operandAt(prog, in, 0) : NULL;
+
+    switch (baseOp(in)) {
+    case OP_MOV:
+        loadOperand(e, RAX, &args[0]);
+        storeRegister(e, in->dest);
+        break;
+
+    case OP_ADDR:
+    case OP_SUBR:
+    case OP_MUL:
+    case OP_DIV:
+    case OP_MOD:
+    case OP_CALC: {
+        // Numeric registers never take addr's hex concatenation path
+        int first = in->op == OP_ADDR && in->mode == ADDR_CONCAT ? 2 : 0;
+        emitExpression(e, args + first, in->argc - first);
+        storeRegister(e, in->dest);
+        break;
+    }
+
+    case OP_SDA:
+        emitBytes(e, "\x31\xc0", 2);                // xor eax, eax
+        for (int k = 0; k < in->argc; k++) {
+            loadOperand(e, RCX, &args[k]);
+            emitBytes(e, "\x48\x01\xc8", 3);        // add rax, rcx
+        }
+        storeRegister(e, in->dest);
+        break;
+
+    case OP_FOR: {
+        // An empty range skips the loop without touching its register
+        int counter = e->counters[i - e->first];
+        loadOperand(e, RAX, &args[0]);
+        loadOperand(e, RCX, &args[1]);
+        emitBytes(e, "\x48\x39\xc8", 3);            // cmp rax, rcx
+        jumpTo(e, "\x0f\x8f", 2, in->target + 1);   // jg
+        storeFrame(e, RAX, counter);
+        storeFrame(e, RCX, counter + 1);
+        storeRegister(e, in->dest);
+        break;
+    }
+
+    case OP_END: {
+        const Instr *opener = &prog->code[in->target];
+        if (opener->op != OP_FOR) break;
+
+        // Step the counter and reload the loop register, as the interpreter does
+        int counter = e->counters[in->target - e->first];
+        loadFrame(e, RAX, counter);
+        emitBytes(e, "\x48\x3b\x83", 3);            // cmp rax, [rbx + last]
+        emit32(e, (counter + 1) * 8);
+        jumpTo(e, "\x0f\x8d", 2, i + 1);            // jge
+        emitBytes(e, "\x48\xff\xc0", 3);            // inc rax
+        storeFrame(e, RAX, counter);
+        storeRegister(e, opener->dest);
+        jumpTo(e, "\xe9", 1, in->target + 1);
+        break;
+    }
+
+    case OP_COND:
+    case OP_TEST: {
+        // Jump past the then-branch when the comparison fails
+        static const unsigned char skip[] = {
+            [CMP_LT] = 0x8d, [CMP_GT] = 0x8e, [CMP_LE] = 0x8f,     // jge, jle, jg
+            [CMP_GE] = 0x8c, [CMP_EQ] = 0x85, [CMP_NE] = 0x84,     // jl, jne, je
+        };
+        const char jcc[2] = { 0x0f, (char)skip[in->mode] };
+        loadOperand(e, RAX, &args[0]);
+        loadOperand(e, RCX, &args[1]);
+        emitBytes(e, "\x48\x39\xc8", 3);            // cmp rax, rcx
+        jumpTo(e, jcc, 2, (in->alt >= 0 ? in->alt : in->target) + 1);
+        break;
+    }
+
+    case OP_ELSE:
+        jumpTo(e, "\xe9", 1, in->target + 1);
+        break;
+
+    default:
+        break;
+    }
+}
+
+int jitAvailable(void) {
+    return 1;
+}
+
+JitLoop *jitCompileLoop(const Program *prog, int header) {
+    const Instr *head = &prog->code[header];
+    int end = head->target;
+    if (head->op != OP_FOR || end >= prog->codeCount || prog->code[end].op != OP_END) return NULL;
+    if (!isCompilable(prog, header, end)) return NULL;
+
+    int count = end - header + 1;
+    Emitter e;
+    memset(&e, 0, sizeof(e));
+    e.first = header;
+    e.labels = malloc((count + 1) * sizeof(int));
+    e.counters = malloc(count * sizeof(int));
+    e.frameIndex = malloc(prog->nameCount * sizeof(int));
+    e.flagIndex = malloc(prog->nameCount * sizeof(int));
+    JitLoop *loop = calloc(1, sizeof(JitLoop));
+    if (loop) {
+        loop->slots = malloc(prog->nameCount * sizeof(int));
+        loop->writes = malloc(prog->nameCount * sizeof(int));
+    }
+    if (!e.labels || !e.counters || !e.frameIndex || !e.flagIndex || !loop || !loop->slots || !loop->writes) {
+        e.failed = 1;
+        goto finish;
+    }
+
+    // Give every register the loop touches a frame entry, then counters
+    // for each for, then a flag for each register it stores to
+    for (int s = 0; s < prog->nameCount; s++) {
+        e.frameIndex[s] = -1;
+        e.flagIndex[s] = -1;
+    }
+    int loops = 0;
+    for (int i = header; i <= end; i++) {
+        const Instr *in = &prog->code[i];
+        for (int k = 0; k < in->argc; k++) {
+            const Operand *op = operandAt(prog, in, k);
+            if (op->kind == OPD_REGISTER) addSlot(e.frameIndex, loop->slots, &loop->slotCount, op->ref);
+        }
+        if (in->dest >= 0 && in->op != OP_NOP) {
+            addSlot(e.frameIndex, loop->slots, &loop->slotCount, in->dest);
+            if (e.flagIndex[in->dest] < 0) {
+                e.flagIndex[in->dest] = loop->writeCount;
+                loop->writes[loop->writeCount++] = e.frameIndex[in->dest];
+            }
+        }
+        e.counters[i - header] = in->op == OP_FOR ? loops++ : -1;
+    }
+    for (int i = 0; i < count; i++) {
+        if (e.counters[i] >= 0) e.counters[i] = loop->slotCount + 2 * e.counters[i];
+    }
+    loop->flagBase = loop->slotCount + 2 * loops;
+    for (int s = 0; s < prog->nameCount; s++) {
+        if (e.flagIndex[s] >= 0) e.flagIndex[s] += loop->flagBase;
+    }
+    e.sequence = loop->flagBase + loop->writeCount;
+    loop->frame = calloc(e.sequence + 1, sizeof(long long));
+    if (!loop->frame) {
+        e.failed = 1;
+        goto finish;
+    }
+
+    emitByte(&e, 0x53);                             // push rbx
+    emitBytes(&e, "\x48\x89\xfb", 3);               // mov rbx, rdi
+    for (int i = header; i <= end; i++) {
+        e.labels[i - header] = e.size;
+        int trips = unrollCount(prog, i);
+        if (trips == 0) {
+            emitInstruction(&e, prog, i);
+            continue;
+        }
+        emitUnrolled(&e, prog, i, trips);
+        int close = prog->code[i].target;
+        while (i < close) e.labels[++i - header] = e.size;
+    }
+    e.labels[count] = e.size;
+    emitByte(&e, 0x5b);                             // pop rbx
+    emitByte(&e, 0xc3);                             // ret
+
+    for (int f = 0; f < e.fixupCount; f++) {
+        int at = e.fixups[2 * f];
+        patch32(&e, at, e.labels[e.fixups[2 * f + 1] - header] - (at + 4));
+    }
+
+    if (!e.failed) {
+        void *code = mmap(NULL, e.size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (code == MAP_FAILED) {
+            e.failed = 1;
+        } else {
+            memcpy(code, e.code, e.size);
+            if (mprotect(code, e.size, PROT_READ | PROT_EXEC) != 0) {
+                munmap(code, e.size);
+                e.failed = 1;
+            } else {
+                loop->entry = (JitEntry)code;
+            }
+        }
+    }
+
+finish:
+    free(e.code);
+    free(e.labels);
+    free(e.fixups);
+    free(e.counters);
+    free(e.frameIndex);
+    free(e.flagIndex);
+    if (e.failed && loop) {
+        free(loop->slots);
+        free(loop->writes);
+        free(loop->frame);
+        free(loop);
+        loop = NULL;
+    }
+    return loop;
+}
+
+#else
+
+int jitAvailable(void) {
+    return 0;
+}
+
+JitLoop *jitCompileLoop(const Program *prog, int header) {
+    (void)prog;
+    (void)header;
+    return NULL;
+}
+
+#endif
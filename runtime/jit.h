@@ -0,0 +1,38 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include "decode.h"
+
+// Native x86-64 code for numeric for loops (mits-interp --jit). A loop is
+// compiled only when everything between its header and its end is one of
+// mov, addr, subr, mul, div, mod, sda, numeric cond/else, nested for and
+// end, with plain number or register operands. Anything else is left to
+// the interpreter. Small loops with constant bounds and a straight-line
+// body are unrolled.
+
+// Compiled loop body; frame holds the loop's registers and counters
+typedef void (*JitEntry)(long long *frame);
+
+// Frame layout: slotCount register values, two counters per for loop
+// (current, last), one flag per register the loop may store to, then the
+// number of registers stored so far. A flag stays 0 until its register is
+// first stored, then holds that running count (1 for the first, ...).
+typedef struct {
+    JitEntry entry;
+    int *slots;             // register slot held in each frame entry
+    int slotCount;
+    int *writes;            // frame entries the loop may store to, in program order
+    int writeCount;
+    int flagBase;           // frame index of the first write flag; the
+                            // store count follows the last flag
+    long long *frame;
+} JitLoop;
+
+// Return 1 if this build can emit native code
+int jitAvailable(void);
+
+// Compile the for loop whose header is at index header; NULL if the loop
+// uses anything the JIT does not handle
+JitLoop *jitCompileLoop(const Program *prog, int header);
+
+#endif // JIT_H
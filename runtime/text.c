@@ -0,0 +1,167 @@
+#include "text.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define TEXT_CHUNK_MIN 64
+#define TEXT_CHUNK_MAX (1 << 20)
+// Texts whose pieces hold fewer bytes than this on average are copied
+// rather than shared, which also keeps the number of pieces in check
+#define TEXT_SHARE_MIN 256
+
+static void *allocateText(void *data, size_t size) {
+    void *grown = realloc(data, size);
+    if (!grown) {
+        fprintf(stderr, "Error: Out of memory\n");
+        exit(1);
+    }
+    return grown;
+}
+
+Text *newText(void) {
+    Text *text = allocateText(NULL, sizeof(Text));
+    text->refs = 1;
+    text->len = 0;
+    text->chunkSize = 0;
+    text->count = 0;
+    text->capacity = 0;
+    text->pieces = NULL;
+    return text;
+}
+
+void releaseText(Text *text) {
+    if (--text->refs > 0) return;
+    for (int i = 0; i < text->count; i++) {
+        TextChunk *chunk = text->pieces[i].chunk;
+        if (--chunk->refs == 0) free(chunk);
+    }
+    free(text->pieces);
+    free(text);
+}
+
+// Add len bytes of chunk from start, joining them to the last piece when
+// they follow on from it
+static void addPiece(Text *text, TextChunk *chunk, long long start, long long len) {
+    text->len += len;
+    TextPiece *last = text->count ? &text->pieces[text->count - 1] : NULL;
+    if (last && last->chunk == chunk && last->start + last->len == start) {
+        last->len += len;
+        return;
+    }
+    if (text->count == text->capacity) {
+        text->capacity = text->capacity ? text->capacity * 2 : 4;
+        text->pieces = allocateText(text->pieces, (size_t)text->capacity * sizeof(TextPiece));
+    }
+    chunk->refs++;
+    text->pieces[text->count++] = (TextPiece){chunk, start, len};
+}
+
+void appendBytes(Text *text, const unsigned char *bytes, long long len) {
+    if (len > MAX_TEXT_LENGTH - text->len) len = MAX_TEXT_LENGTH - text->len;
+    if (len <= 0) return;
+
+    // Fill the room after the last piece, if no other text has used it
+    TextPiece *last = text->count ? &text->pieces[text->count - 1] : NULL;
+    if (last && last->start + last->len == last->chunk->used) {
+        TextChunk *chunk = last->chunk;
+        long long count = chunk->capacity - chunk->used < len ? chunk->capacity - chunk->used : len;
+        memcpy(chunk->bytes + chunk->used, bytes, count);
+        chunk->used += count;
+        last->len += count;
+        text->len += count;
+        bytes += count;
+        len -= count;
+        if (len == 0) return;
+    }
+
+    long long capacity = text->chunkSize * 2;
+    capacity = capacity < TEXT_CHUNK_MIN ? TEXT_CHUNK_MIN : capacity > TEXT_CHUNK_MAX ? TEXT_CHUNK_MAX : capacity;
+    if (capacity < len) capacity = len;
+    text->chunkSize = capacity;
+    TextChunk *chunk = allocateText(NULL, sizeof(TextChunk) + capacity);
+    chunk->refs = 0;
+    chunk->used = len;
+    chunk->capacity = capacity;
+    memcpy(chunk->bytes, bytes, len);
+    addPiece(text, chunk, 0, len);
+}
+
+void appendNumber(Text *text, long long num) {
+    static const char pairs[] =
+        "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+        "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+    // Two digits per division
+    char digits[24];
+    int at = sizeof(digits);
+    unsigned long long rest = num < 0 ? 0ULL - (unsigned long long)num : (unsigned long long)num;
+    while (rest >= 100) {
+        at -= 2;
+        memcpy(digits + at, pairs + rest % 100 * 2, 2);
+        rest /= 100;
+    }
+    if (rest >= 10) {
+        at -= 2;
+        memcpy(digits + at, pairs + rest * 2, 2);
+    } else {
+        digits[--at] = (char)('0' + rest);
+    }
+    if (num < 0) digits[--at] = '-';
+    appendBytes(text, (const unsigned char *)digits + at, sizeof(digits) - at);
+}
+
+void appendText(Text *text, const Text *other) {
+    // Pieces are read by index: adding to text itself may move them
+    int count = other->count;
+    int share = other->len >= TEXT_SHARE_MIN * (long long)count;
+    // Chunks keep growing as they would have in other
+    if (share && text->chunkSize < other->chunkSize) text->chunkSize = other->chunkSize;
+    for (int i = 0; i < count && text->len < MAX_TEXT_LENGTH; i++) {
+        TextPiece piece = other->pieces[i];
+        if (piece.len > MAX_TEXT_LENGTH - text->len) piece.len = MAX_TEXT_LENGTH - text->len;
+        if (share) addPiece(text, piece.chunk, piece.start, piece.len);
+        else appendBytes(text, piece.chunk->bytes + piece.start, piece.len);
+    }
+}
+
+void appendValue(Text *text, Value v) {
+    switch (v.type) {
+    case TYPE_NUMBER:
+        appendNumber(text, v.data.numValue);
+        break;
+    case TYPE_FLOAT: {
+        // Room for every digit of the largest double
+        char digits[320];
+        int len = snprintf(digits, sizeof(digits), "%.2f", v.data.floatValue);
+        appendBytes(text, (const unsigned char *)digits, len);
+        break;
+    }
+    case TYPE_STRING:
+    case TYPE_HEX:
+        if (hasBlob(v)) appendBytes(text, valueBytes(v), valueLength(v));
+        break;
+    case TYPE_TEXT:
+        appendText(text, v.data.text);
+        break;
+    default:
+        // Vectors add nothing
+        break;
+    }
+}
+
+void writeText(const Text *text, FILE *out) {
+    for (int i = 0; i < text->count; i++) {
+        const TextPiece *piece = &text->pieces[i];
+        fwrite(piece->chunk->bytes + piece->start, 1, piece->len, out);
+    }
+}
+
+long long flattenText(const Text *text, unsigned char *out, long long max) {
+    long long done = 0;
+    for (int i = 0; i < text->count && done < max; i++) {
+        const TextPiece *piece = &text->pieces[i];
+        long long count = piece->len < max - done ? piece->len : max - done;
+        memcpy(out + done, piece->chunk->bytes + piece->start, count);
+        done += count;
+    }
+    return done;
+}
@@ -0,0 +1,38 @@
+#ifndef TEXT_H
+#define TEXT_H
+
+#include "value.h"
+#include <stdio.h>
+
+// Storage behind str. A text is a list of pieces of chunks; appending
+// bytes fills the last chunk in place and then starts a new one twice its
+// size, up to a fixed chunk size, so appends cost amortized O(1) per byte.
+// Another text goes in by sharing its pieces' chunks, unless it is small
+// enough that copying its bytes is cheaper. A text grows to at most
+// MAX_TEXT_LENGTH bytes and drops what goes past that.
+
+// New empty text with refs 1
+Text *newText(void);
+
+// Drop one reference to a text
+void releaseText(Text *text);
+
+void appendBytes(Text *text, const unsigned char *bytes, long long len);
+
+// Decimal digits of num
+void appendNumber(Text *text, long long num);
+
+// The bytes of other, which may be text itself
+void appendText(Text *text, const Text *other);
+
+// The raw bytes of a string, hex or text value, a number in decimal, or a
+// float to two places. Vectors add nothing.
+void appendValue(Text *text, Value v);
+
+// Write every byte of a text to out
+void writeText(const Text *text, FILE *out);
+
+// Copy the first max bytes of a text to out; returns how many there were
+long long flattenText(const Text *text, unsigned char *out, long long max);
+
+#endif // TEXT_H
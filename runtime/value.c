@@ -0,0 +1,242 @@
+#include "value.h"
+#include "vector.h"
+#include "text.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define INTERN_MIN_CAPACITY 256
+
+// Live string blobs by hash; capacity is a power of two
+static Blob **internTable = NULL;
+static unsigned int internCapacity = 0;
+static unsigned int internCount = 0;
+
+// A blob whose bytes live elsewhere, or in storage of extra bytes
+static Blob *newBlob(size_t extra) {
+    Blob *blob = malloc(sizeof(Blob) + extra);
+    if (!blob) {
+        fprintf(stderr, "Error: Out of memory\n");
+        exit(1);
+    }
+    blob->refs = 1;
+    blob->hash = 0;
+    blob->len = 0;
+    blob->next = NULL;
+    blob->owner = NULL;
+    blob->bytes = blob->storage;
+    return blob;
+}
+
+// A blob with len bytes of storage, copied from bytes unless that is NULL
+static Blob *allocateBlob(const void *bytes, long long len) {
+    Blob *blob = newBlob((size_t)len + 1);
+    blob->len = len;
+    if (bytes) memcpy(blob->storage, bytes, len);
+    blob->storage[len] = '\0';
+    return blob;
+}
+
+static void freeBlob(Blob *blob) {
+    if (blob->owner) {
+        if (--blob->owner->refs == 0) freeBlob(blob->owner);
+    } else if (blob->bytes != blob->storage) {
+        munmap((void *)blob->bytes, blob->len);
+    }
+    free(blob);
+}
+
+// FNV-1a
+static unsigned int hashBytes(const unsigned char *bytes, int len) {
+    unsigned int hash = 2166136261u;
+    for (int i = 0; i < len; i++) {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static void growInternTable(void) {
+    unsigned int capacity = internCapacity ? internCapacity * 2 : INTERN_MIN_CAPACITY;
+    Blob **table = calloc(capacity, sizeof(Blob *));
+    if (!table) {
+        fprintf(stderr, "Error: Out of memory\n");
+        exit(1);
+    }
+    for (unsigned int i = 0; i < internCapacity; i++) {
+        Blob *blob = internTable[i];
+        while (blob) {
+            Blob *next = blob->next;
+            blob->next = table[blob->hash & (capacity - 1)];
+            table[blob->hash & (capacity - 1)] = blob;
+            blob = next;
+        }
+    }
+    free(internTable);
+    internTable = table;
+    internCapacity = capacity;
+}
+
+// The string blob for these bytes, shared if one is alive
+static Blob *internString(const char *text, int len) {
+    unsigned int hash = hashBytes((const unsigned char *)text, len);
+    if (internCapacity) {
+        for (Blob *blob = internTable[hash & (internCapacity - 1)]; blob; blob = blob->next) {
+            if (blob->hash == hash && blob->len == len && memcmp(blob->bytes, text, len) == 0) {
+                blob->refs++;
+                return blob;
+            }
+        }
+    }
+    if (internCount >= internCapacity) growInternTable();
+
+    Blob *blob = allocateBlob(text, len);
+    blob->hash = hash;
+    blob->next = internTable[hash & (internCapacity - 1)];
+    internTable[hash & (internCapacity - 1)] = blob;
+    internCount++;
+    return blob;
+}
+
+static void forgetString(Blob *blob) {
+    Blob **link = &internTable[blob->hash & (internCapacity - 1)];
+    while (*link != blob) link = &(*link)->next;
+    *link = blob->next;
+    internCount--;
+}
+
+Value makeNumber(long long num) {
+    Value v;
+    v.type = TYPE_NUMBER;
+    v.len = 0;
+    v.data.numValue = num;
+    return v;
+}
+
+Value makeFloat(double num) {
+    Value v;
+    v.type = TYPE_FLOAT;
+    v.len = 0;
+    v.data.floatValue = num;
+    return v;
+}
+
+Value makeString(const char *text, int len) {
+    if (len > MAX_STRING_LENGTH) len = MAX_STRING_LENGTH;
+    Value v;
+    v.type = TYPE_STRING;
+    v.len = len > 0 ? len : 0;
+    v.data.blob = len > 0 ? internString(text, len) : NULL;
+    return v;
+}
+
+// What Value.len keeps for a hex value of len bytes
+static unsigned int cachedLength(long long len) {
+    return len < UINT_MAX ? (unsigned int)len : UINT_MAX;
+}
+
+Value makeHex(const unsigned char *bytes, long long len) {
+    Value v;
+    v.type = TYPE_HEX;
+    v.len = len > 0 ? cachedLength(len) : 0;
+    v.data.blob = len > 0 ? allocateBlob(bytes, len) : NULL;
+    return v;
+}
+
+Value reserveHex(long long len, unsigned char **bytes) {
+    Value v = makeHex(NULL, len);
+    *bytes = hasBlob(v) ? v.data.blob->storage : NULL;
+    return v;
+}
+
+Value mapHex(const char *path) {
+    Value v = makeHex(NULL, 0);
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        fprintf(stderr, "Error: Cannot open binary file '%s'\n", path);
+        if (fd >= 0) close(fd);
+        return v;
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        return v;
+    }
+
+    void *image = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (image == MAP_FAILED) {
+        fprintf(stderr, "Error: Cannot map binary file '%s'\n", path);
+        return v;
+    }
+    // Binary files are mostly scanned front to back
+    madvise(image, st.st_size, MADV_SEQUENTIAL);
+
+    Blob *blob = newBlob(0);
+    blob->len = st.st_size;
+    blob->bytes = image;
+    v.len = cachedLength(st.st_size);
+    v.data.blob = blob;
+    return v;
+}
+
+Value sliceHex(Value hex, long long start, long long count) {
+    if (count == 0) return makeHex(NULL, 0);
+    if (start == 0 && count == valueLength(hex)) return retainValue(hex);
+    // Slices of slices share the first owner, so chains never form
+    Blob *source = hex.data.blob;
+    Blob *blob = newBlob(0);
+    blob->owner = source->owner ? source->owner : source;
+    blob->owner->refs++;
+    blob->bytes = source->bytes + start;
+    blob->len = count;
+    Value v;
+    v.type = TYPE_HEX;
+    v.len = cachedLength(count);
+    v.data.blob = blob;
+    return v;
+}
+
+Value makeVector(Vector *vector) {
+    Value v;
+    v.type = TYPE_VECTOR;
+    v.len = 0;
+    v.data.vector = vector;
+    return v;
+}
+
+Value makeText(Text *text) {
+    Value v;
+    v.type = TYPE_TEXT;
+    v.len = 0;
+    v.data.text = text;
+    return v;
+}
+
+void releaseValue(Value v) {
+    if (v.type == TYPE_VECTOR) {
+        if (--v.data.vector->refs == 0) freeVector(v.data.vector);
+        return;
+    }
+    if (v.type == TYPE_TEXT) {
+        releaseText(v.data.text);
+        return;
+    }
+    if (!hasBlob(v)) return;
+    if (--v.data.blob->refs == 0) {
+        if (v.type == TYPE_STRING) forgetString(v.data.blob);
+        freeBlob(v.data.blob);
+    }
+}
+
+int orderStrings(Value a, Value b) {
+    if (sameString(a, b)) return 0;
+    unsigned int shorter = a.len < b.len ? a.len : b.len;
+    int order = shorter ? memcmp(valueBytes(a), valueBytes(b), shorter) : 0;
+    if (order) return order;
+    return (a.len > b.len) - (a.len < b.len);
+}
@@ -0,0 +1,187 @@
+#ifndef VALUE_H
+#define VALUE_H
+
+#include <limits.h>
+
+#define MAX_STRING_LENGTH 511
+#define MAX_VECTOR_LENGTH (1 << 24)
+#define MAX_TEXT_LENGTH (1LL << 30)
+
+typedef enum {
+    TYPE_NUMBER,
+    TYPE_STRING,
+    TYPE_HEX,
+    TYPE_FLOAT,
+    TYPE_VECTOR,
+    TYPE_TEXT
+} ValueType;
+
+// Reference-counted storage for string and hex bytes. Most blobs keep
+// their bytes in storage, NUL-terminated so string values can be handed
+// straight to printf. String blobs are interned: equal strings share one
+// blob, found through hash and len and chained with next in the intern
+// table. A hex blob may instead show a read-only file mapping of len bytes
+// (req ftype="bin"), or part of the bytes of its owner (buf slice); those
+// bytes are not NUL-terminated.
+typedef struct Blob {
+    int refs;
+    unsigned int hash;          // strings only
+    long long len;              // bytes held, shown or mapped
+    struct Blob *next;          // strings only
+    struct Blob *owner;         // slices only
+    const unsigned char *bytes; // storage, the mapping or inside the owner
+    unsigned char storage[];
+} Blob;
+
+// Reference-counted elements of a vector value: 64-bit integers, or
+// doubles once a float went in. A vector shared by several values is never
+// changed; see vector.h.
+typedef struct {
+    int refs;
+    int isFloat;
+    int count;
+    int capacity;
+    union {
+        long long *ints;
+        double *floats;
+    } data;
+} Vector;
+
+// Reference-counted bytes behind texts. Texts show ranges of the first
+// used bytes, which never change again; the text whose last range ends at
+// used may append past it in place.
+typedef struct {
+    int refs;
+    long long used;
+    long long capacity;
+    unsigned char bytes[];
+} TextChunk;
+
+typedef struct {
+    TextChunk *chunk;
+    long long start;
+    long long len;
+} TextPiece;
+
+// Reference-counted text builder behind str: a rope of pieces of shared
+// chunks, so a large text goes into another one without copying its
+// bytes. Like a vector, a text shared by several values is never changed;
+// see text.h.
+typedef struct {
+    int refs;
+    long long len;          // bytes in all pieces
+    long long chunkSize;    // capacity of the last chunk made
+    int count;
+    int capacity;
+    TextPiece *pieces;
+} Text;
+
+// 16-byte tagged value: numbers and floats are immediate, strings and hex
+// point at a shared Blob, vectors at a shared Vector and texts at a shared
+// Text. An empty string or hex value has no blob at all; a vector or text
+// value always has its Vector or Text.
+typedef struct {
+    unsigned int type;      // ValueType
+    unsigned int len;       // byte length, or UINT_MAX when the blob holds it
+    union {
+        long long numValue;
+        double floatValue;
+        Blob *blob;
+        Vector *vector;
+        Text *text;
+    } data;
+} Value;
+
+// Build a number value
+Value makeNumber(long long num);
+
+// Build a float value
+Value makeFloat(double num);
+
+// Build a string value from len bytes of text, sharing the blob of an
+// equal string that is still alive
+Value makeString(const char *text, int len);
+
+// Build a hex value from len raw bytes
+Value makeHex(const unsigned char *bytes, long long len);
+
+// Build a hex value of len bytes that are not set yet; *bytes is where
+// they go
+Value reserveHex(long long len, unsigned char **bytes);
+
+// Map a file read-only into a hex value without copying it; an empty hex
+// value, with a message, if it cannot be mapped
+Value mapHex(const char *path);
+
+// count bytes of a hex value from start, sharing its bytes; the caller
+// keeps its reference to hex and start + count must fit in it
+Value sliceHex(Value hex, long long start, long long count);
+
+// Build a vector value; it takes over the reference to vector
+Value makeVector(Vector *vector);
+
+// Build a text value; it takes over the reference to text
+Value makeText(Text *text);
+
+// Drop one reference to the storage behind a value
+void releaseValue(Value v);
+
+// Does the value keep its bytes in a blob
+static inline int hasBlob(Value v) {
+    return (v.type == TYPE_STRING || v.type == TYPE_HEX) && v.data.blob;
+}
+
+// Byte length of a string or hex value. Value.len keeps it for values
+// under 4 GB, so only longer hex values read it from their blob.
+static inline long long valueLength(Value v) {
+    return v.len == UINT_MAX ? v.data.blob->len : v.len;
+}
+
+// Take another reference to the storage behind a value
+static inline Value retainValue(Value v) {
+    if (hasBlob(v)) v.data.blob->refs++;
+    else if (v.type == TYPE_VECTOR) v.data.vector->refs++;
+    else if (v.type == TYPE_TEXT) v.data.text->refs++;
+    return v;
+}
+
+// Number or float, the values arithmetic works on
+static inline int isNumeric(Value v) {
+    return v.type == TYPE_NUMBER || v.type == TYPE_FLOAT;
+}
+
+// A float truncated toward zero, saturating at the ends of the range; NaN is 0
+static inline long long floatToNumber(double num) {
+    if (num != num) return 0;
+    if (num <= -9223372036854775808.0) return LLONG_MIN;
+    if (num >= 9223372036854775808.0) return LLONG_MAX;
+    return (long long)num;
+}
+
+// Numeric view of a value; floats are truncated, strings and hex read as 0
+static inline long long numberOf(Value v) {
+    if (v.type == TYPE_NUMBER) return v.data.numValue;
+    return v.type == TYPE_FLOAT ? floatToNumber(v.data.floatValue) : 0;
+}
+
+// Floating view of a number or float value
+static inline double floatOf(Value v) {
+    return v.type == TYPE_FLOAT ? v.data.floatValue : (double)v.data.numValue;
+}
+
+// Raw bytes of a string or hex value, "" when empty
+static inline const char *valueText(Value v) {
+    return hasBlob(v) ? (const char *)v.data.blob->bytes : "";
+}
+
+// Equality of two string values; interning makes it a pointer compare
+static inline int sameString(Value a, Value b) {
+    return a.data.blob == b.data.blob;
+}
+
+// Byte order of two string values: negative, 0 or positive
+int orderStrings(Value a, Value b);
+
+#define valueBytes(v) ((const unsigned char *)valueText(v))
+
+#endif // VALUE_H
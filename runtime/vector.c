@@ -0,0 +1,357 @@
+#include "vector.h"
+#include "decode.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define MITS_X86_SIMD
+#include <immintrin.h>
+#define AVX2 __attribute__((target("avx2")))
+#endif
+
+int simdLevel = SIMD_SCALAR;
+
+int selectSimd(int limit) {
+    int level = SIMD_SCALAR;
+#ifdef MITS_X86_SIMD
+    // SSE2 is part of x86-64 itself
+    __builtin_cpu_init();
+    level = __builtin_cpu_supports("avx2") ? SIMD_AVX2 : SIMD_SSE2;
+#endif
+    simdLevel = level < limit ? level : limit;
+    return simdLevel;
+}
+
+static void *allocateElements(void *elements, int capacity) {
+    // Integers and doubles are both 8 bytes
+    void *grown = realloc(elements, (size_t)capacity * 8);
+    if (!grown) {
+        fprintf(stderr, "Error: Out of memory\n");
+        exit(1);
+    }
+    return grown;
+}
+
+Vector *newVector(int isFloat, int count) {
+    Vector *vector = malloc(sizeof(Vector));
+    if (!vector) {
+        fprintf(stderr, "Error: Out of memory\n");
+        exit(1);
+    }
+    vector->refs = 1;
+    vector->isFloat = isFloat;
+    vector->count = count;
+    vector->capacity = count > 4 ? count : 4;
+    vector->data.ints = allocateElements(NULL, vector->capacity);
+    return vector;
+}
+
+Vector *copyVector(const Vector *vector, int start, int count) {
+    Vector *copy = newVector(vector->isFloat, count);
+    memcpy(copy->data.ints, vector->data.ints + start, (size_t)count * 8);
+    return copy;
+}
+
+void freeVector(Vector *vector) {
+    free(vector->data.ints);
+    free(vector);
+}
+
+void reserveVector(Vector *vector, int count) {
+    if (count <= vector->capacity) return;
+    int capacity = vector->capacity;
+    while (capacity < count) capacity = capacity < MAX_VECTOR_LENGTH / 2 ? capacity * 2 : MAX_VECTOR_LENGTH;
+    vector->data.ints = allocateElements(vector->data.ints, capacity);
+    vector->capacity = capacity;
+}
+
+// No 64-bit integer to double conversion before AVX-512 either
+static void intsToFloats(double *out, const long long *a, int count) {
+    for (int i = 0; i < count; i++) out[i] = (double)a[i];
+}
+
+void promoteVector(Vector *vector) {
+    if (vector->isFloat) return;
+    double *floats = allocateElements(NULL, vector->capacity);
+    intsToFloats(floats, vector->data.ints, vector->count);
+    free(vector->data.ints);
+    vector->data.floats = floats;
+    vector->isFloat = 1;
+}
+
+const double *floatElements(const Vector *vector, double **scratch) {
+    *scratch = NULL;
+    if (vector->isFloat) return vector->data.floats;
+    *scratch = allocateElements(NULL, vector->count > 0 ? vector->count : 1);
+    intsToFloats(*scratch, vector->data.ints, vector->count);
+    return *scratch;
+}
+
+// Each SIMD kernel handles a whole number of registers and returns how
+// many elements it did; the plain loop after it finishes the rest
+
+#ifdef MITS_X86_SIMD
+AVX2 static int fillAvx2(long long *out, long long bits, int count) {
+    __m256i v = _mm256_set1_epi64x(bits);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) _mm256_storeu_si256((__m256i *)(out + i), v);
+    return i;
+}
+
+static int fillSse2(long long *out, long long bits, int count) {
+    __m128i v = _mm_set1_epi64x(bits);
+    int i = 0;
+    for (; i + 2 <= count; i += 2) _mm_storeu_si128((__m128i *)(out + i), v);
+    return i;
+}
+
+AVX2 static int addIntsAvx2(long long *out, const long long *a, const long long *b, long long scalar, int count) {
+    __m256i s = _mm256_set1_epi64x(scalar);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(a + i));
+        __m256i y = b ? _mm256_loadu_si256((const __m256i *)(b + i)) : s;
+        _mm256_storeu_si256((__m256i *)(out + i), _mm256_add_epi64(x, y));
+    }
+    return i;
+}
+
+static int addIntsSse2(long long *out, const long long *a, const long long *b, long long scalar, int count) {
+    __m128i s = _mm_set1_epi64x(scalar);
+    int i = 0;
+    for (; i + 2 <= count; i += 2) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i y = b ? _mm_loadu_si128((const __m128i *)(b + i)) : s;
+        _mm_storeu_si128((__m128i *)(out + i), _mm_add_epi64(x, y));
+    }
+    return i;
+}
+
+AVX2 static int combineFloatsAvx2(int op, double *out, const double *a, const double *b, double scalar, int count) {
+    __m256d s = _mm256_set1_pd(scalar);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256d x = _mm256_loadu_pd(a + i);
+        __m256d y = b ? _mm256_loadu_pd(b + i) : s;
+        _mm256_storeu_pd(out + i, op == VEC_ADD ? _mm256_add_pd(x, y) : _mm256_mul_pd(x, y));
+    }
+    return i;
+}
+
+static int combineFloatsSse2(int op, double *out, const double *a, const double *b, double scalar, int count) {
+    __m128d s = _mm_set1_pd(scalar);
+    int i = 0;
+    for (; i + 2 <= count; i += 2) {
+        __m128d x = _mm_loadu_pd(a + i);
+        __m128d y = b ? _mm_loadu_pd(b + i) : s;
+        _mm_storeu_pd(out + i, op == VEC_ADD ? _mm_add_pd(x, y) : _mm_mul_pd(x, y));
+    }
+    return i;
+}
+
+AVX2 static int sumIntsAvx2(const long long *a, int count, long long *sum) {
+    __m256i acc = _mm256_setzero_si256();
+    int i = 0;
+    for (; i + 4 <= count; i += 4) acc = _mm256_add_epi64(acc, _mm256_loadu_si256((const __m256i *)(a + i)));
+    long long lanes[4];
+    _mm256_storeu_si256((__m256i *)lanes, acc);
+    for (int j = 0; j < 4; j++) *sum = (long long)((unsigned long long)*sum + (unsigned long long)lanes[j]);
+    return i;
+}
+
+static int sumIntsSse2(const long long *a, int count, long long *sum) {
+    __m128i acc = _mm_setzero_si128();
+    int i = 0;
+    for (; i + 2 <= count; i += 2) acc = _mm_add_epi64(acc, _mm_loadu_si128((const __m128i *)(a + i)));
+    long long lanes[2];
+    _mm_storeu_si128((__m128i *)lanes, acc);
+    for (int j = 0; j < 2; j++) *sum = (long long)((unsigned long long)*sum + (unsigned long long)lanes[j]);
+    return i;
+}
+
+// Float sums and dot products keep the four lanes in memory between the
+// kernel and the plain loop, so both add in the same order
+AVX2 static int sumFloatsAvx2(const double *a, const double *b, int count, double *lanes) {
+    __m256d acc = _mm256_loadu_pd(lanes);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256d x = _mm256_loadu_pd(a + i);
+        if (b) x = _mm256_mul_pd(x, _mm256_loadu_pd(b + i));
+        acc = _mm256_add_pd(acc, x);
+    }
+    _mm256_storeu_pd(lanes, acc);
+    return i;
+}
+
+static int sumFloatsSse2(const double *a, const double *b, int count, double *lanes) {
+    __m128d low = _mm_loadu_pd(lanes), high = _mm_loadu_pd(lanes + 2);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128d x = _mm_loadu_pd(a + i), y = _mm_loadu_pd(a + i + 2);
+        if (b) {
+            x = _mm_mul_pd(x, _mm_loadu_pd(b + i));
+            y = _mm_mul_pd(y, _mm_loadu_pd(b + i + 2));
+        }
+        low = _mm_add_pd(low, x);
+        high = _mm_add_pd(high, y);
+    }
+    _mm_storeu_pd(lanes, low);
+    _mm_storeu_pd(lanes + 2, high);
+    return i;
+}
+
+// 64-bit compares arrived with SSE4.2, so integer min and max use AVX2 only
+AVX2 static int extremeIntsAvx2(int op, const long long *a, int count, long long *best) {
+    __m256i m = _mm256_set1_epi64x(*best);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(a + i));
+        __m256i take = op == VEC_MIN ? _mm256_cmpgt_epi64(m, x) : _mm256_cmpgt_epi64(x, m);
+        m = _mm256_blendv_epi8(m, x, take);
+    }
+    long long lanes[4];
+    _mm256_storeu_si256((__m256i *)lanes, m);
+    for (int j = 0; j < 4; j++) {
+        if (op == VEC_MIN ? lanes[j] < *best : lanes[j] > *best) *best = lanes[j];
+    }
+    return i;
+}
+
+// minpd and maxpd keep their second operand unless the first one wins the
+// comparison, the same rule as pickFloat
+AVX2 static int extremeFloatsAvx2(int op, const double *a, int count, double *lanes) {
+    __m256d m = _mm256_loadu_pd(lanes);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256d x = _mm256_loadu_pd(a + i);
+        m = op == VEC_MIN ? _mm256_min_pd(x, m) : _mm256_max_pd(x, m);
+    }
+    _mm256_storeu_pd(lanes, m);
+    return i;
+}
+
+static int extremeFloatsSse2(int op, const double *a, int count, double *lanes) {
+    __m128d low = _mm_loadu_pd(lanes), high = _mm_loadu_pd(lanes + 2);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128d x = _mm_loadu_pd(a + i), y = _mm_loadu_pd(a + i + 2);
+        low = op == VEC_MIN ? _mm_min_pd(x, low) : _mm_max_pd(x, low);
+        high = op == VEC_MIN ? _mm_min_pd(y, high) : _mm_max_pd(y, high);
+    }
+    _mm_storeu_pd(lanes, low);
+    _mm_storeu_pd(lanes + 2, high);
+    return i;
+}
+#endif
+
+void fillVector(Vector *vector, long long bits, int count) {
+    reserveVector(vector, count);
+    long long *out = vector->data.ints;
+    int i = 0;
+#ifdef MITS_X86_SIMD
+    if (simdLevel == SIMD_AVX2) i = fillAvx2(out, bits, count);
+    else if (simdLevel == SIMD_SSE2) i = fillSse2(out, bits, count);
+#endif
+    for (; i < count; i++) out[i] = bits;
+    vector->count = count;
+}
+
+void combineInts(int op, long long *out, const long long *a, const long long *b, long long scalar, int count) {
+    int i = 0;
+    if (op == VEC_ADD) {
+#ifdef MITS_X86_SIMD
+        if (simdLevel == SIMD_AVX2) i = addIntsAvx2(out, a, b, scalar, count);
+        else if (simdLevel == SIMD_SSE2) i = addIntsSse2(out, a, b, scalar, count);
+#endif
+        for (; i < count; i++) {
+            out[i] = (long long)((unsigned long long)a[i] + (unsigned long long)(b ? b[i] : scalar));
+        }
+    } else {
+        for (; i < count; i++) {
+            out[i] = (long long)((unsigned long long)a[i] * (unsigned long long)(b ? b[i] : scalar));
+        }
+    }
+}
+
+void combineFloats(int op, double *out, const double *a, const double *b, double scalar, int count) {
+    int i = 0;
+#ifdef MITS_X86_SIMD
+    if (simdLevel == SIMD_AVX2) i = combineFloatsAvx2(op, out, a, b, scalar, count);
+    else if (simdLevel == SIMD_SSE2) i = combineFloatsSse2(op, out, a, b, scalar, count);
+#endif
+    for (; i < count; i++) {
+        double y = b ? b[i] : scalar;
+        out[i] = op == VEC_ADD ? a[i] + y : a[i] * y;
+    }
+}
+
+long long sumInts(const long long *a, int count) {
+    long long sum = 0;
+    int i = 0;
+#ifdef MITS_X86_SIMD
+    if (simdLevel == SIMD_AVX2) i = sumIntsAvx2(a, count, &sum);
+    else if (simdLevel == SIMD_SSE2) i = sumIntsSse2(a, count, &sum);
+#endif
+    for (; i < count; i++) sum = (long long)((unsigned long long)sum + (unsigned long long)a[i]);
+    return sum;
+}
+
+long long dotInts(const long long *a, const long long *b, int count) {
+    unsigned long long sum = 0;
+    for (int i = 0; i < count; i++) sum += (unsigned long long)a[i] * (unsigned long long)b[i];
+    return (long long)sum;
+}
+
+// Sum of a[i], or of a[i] * b[i] when b is set, in four lanes
+static double sumLanes(const double *a, const double *b, int count) {
+    double lanes[4] = {0, 0, 0, 0};
+    int i = 0;
+#ifdef MITS_X86_SIMD
+    if (simdLevel == SIMD_AVX2) i = sumFloatsAvx2(a, b, count, lanes);
+    else if (simdLevel == SIMD_SSE2) i = sumFloatsSse2(a, b, count, lanes);
+#endif
+    for (; i < count; i++) {
+        double x = b ? a[i] * b[i] : a[i];
+        lanes[i & 3] += x;
+    }
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+double sumFloats(const double *a, int count) {
+    return sumLanes(a, NULL, count);
+}
+
+double dotFloats(const double *a, const double *b, int count) {
+    return sumLanes(a, b, count);
+}
+
+long long extremeInts(int op, const long long *a, int count) {
+    long long best = a[0];
+    int i = 0;
+#ifdef MITS_X86_SIMD
+    if (simdLevel == SIMD_AVX2) i = extremeIntsAvx2(op, a, count, &best);
+#endif
+    for (; i < count; i++) {
+        if (op == VEC_MIN ? a[i] < best : a[i] > best) best = a[i];
+    }
+    return best;
+}
+
+static double pickFloat(int op, double x, double best) {
+    if (op == VEC_MIN) return x < best ? x : best;
+    return x > best ? x : best;
+}
+
+double extremeFloats(int op, const double *a, int count) {
+    double lanes[4] = {a[0], a[0], a[0], a[0]};
+    int i = 0;
+#ifdef MITS_X86_SIMD
+    if (simdLevel == SIMD_AVX2) i = extremeFloatsAvx2(op, a, count, lanes);
+    else if (simdLevel == SIMD_SSE2) i = extremeFloatsSse2(op, a, count, lanes);
+#endif
+    for (; i < count; i++) lanes[i & 3] = pickFloat(op, a[i], lanes[i & 3]);
+    double best = lanes[0];
+    for (int j = 1; j < 4; j++) best = pickFloat(op, lanes[j], best);
+    return best;
+}
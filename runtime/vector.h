@@ -0,0 +1,58 @@
+#ifndef VECTOR_H
+#define VECTOR_H
+
+#include "value.h"
+
+// Storage and bulk kernels behind vec. The kernels run at the widest SIMD
+// level the CPU offers (AVX2, SSE2 or plain C), picked once by selectSimd,
+// and every level gives bit-identical results: integer arithmetic wraps,
+// and float sums and dot products always add in four interleaved lanes
+// (element i goes to lane i % 4, the lanes combine as (0 + 1) + (2 + 3)).
+// Integer multiplies stay scalar; x86 has no 64-bit SIMD multiply before
+// AVX-512.
+
+enum { SIMD_SCALAR, SIMD_SSE2, SIMD_AVX2 };
+
+// Level in use; the hex kernels in bytes.c follow it too
+extern int simdLevel;
+
+// Use the best level this CPU supports, at most limit; returns the level
+int selectSimd(int limit);
+
+// New vector holding count elements that are not set yet, with refs 1
+Vector *newVector(int isFloat, int count);
+
+// Copy of count elements of a vector from start on, with refs 1
+Vector *copyVector(const Vector *vector, int start, int count);
+
+void freeVector(Vector *vector);
+
+// Make room for count elements
+void reserveVector(Vector *vector, int count);
+
+// Turn integer elements into doubles
+void promoteVector(Vector *vector);
+
+// The elements of a vector as doubles: its own array, or a converted copy
+// left in *scratch for the caller to free
+const double *floatElements(const Vector *vector, double **scratch);
+
+// Set count elements to value, given as the bits of a long long or double
+void fillVector(Vector *vector, long long bits, int count);
+
+// out[i] = a[i] op b[i], or a[i] op scalar when b is NULL; op is VEC_ADD
+// or VEC_MUL. out may be a.
+void combineInts(int op, long long *out, const long long *a, const long long *b, long long scalar, int count);
+void combineFloats(int op, double *out, const double *a, const double *b, double scalar, int count);
+
+long long sumInts(const long long *a, int count);
+double sumFloats(const double *a, int count);
+long long dotInts(const long long *a, const long long *b, int count);
+double dotFloats(const double *a, const double *b, int count);
+
+// Smallest (VEC_MIN) or largest (VEC_MAX) of count >= 1 elements. Float
+// NaNs are passed over, except that a NaN first element is the result.
+long long extremeInts(int op, const long long *a, int count);
+double extremeFloats(int op, const double *a, int count);
+
+#endif // VECTOR_H
@@ -0,0 +1,921 @@
+; buf at every SIMD level: tests/run.bash runs this with --simd scalar,
+; sse2 and avx2 and compares each run with buf.expected. Lengths sit
+; around the 16-byte SSE2 and 32-byte AVX2 widths so both the vector
+; loops and their scalar tails are covered.
+_start:
+char tmp, "T"
+mov hab, hex=tmp
+char tmp, "~"
+mov hob, hex=tmp
+char tmp, "The quick brown"
+mov hac, hex=tmp
+char tmp, "~~ sphinx of bl"
+mov hoc, hex=tmp
+char tmp, "The quick brown "
+mov had, hex=tmp
+char tmp, "~~ sphinx of bla"
+mov hod, hex=tmp
+char tmp, "The quick brown f"
+mov hae, hex=tmp
+char tmp, "~~ sphinx of blac"
+mov hoe, hex=tmp
+char tmp, "The quick brown fox jumps over "
+mov haf, hex=tmp
+char tmp, "~~ sphinx of black quartz. judg"
+mov hof, hex=tmp
+char tmp, "The quick brown fox jumps over t"
+mov hag, hex=tmp
+char tmp, "~~ sphinx of black quartz. judge"
+mov hog, hex=tmp
+char tmp, "The quick brown fox jumps over th"
+mov hah, hex=tmp
+char tmp, "~~ sphinx of black quartz. judge "
+mov hoh, hex=tmp
+char tmp, "The quick brown fox jumps over the lazy dog: PACK MY BOX WITH F"
+mov hai, hex=tmp
+char tmp, "~~ sphinx of black quartz. judge my vow: 0123456789 ~~ HOW VEXI"
+mov hoi, hex=tmp
+char tmp, "The quick brown fox jumps over the lazy dog: PACK MY BOX WITH FI"
+mov haj, hex=tmp
+char tmp, "~~ sphinx of black quartz. judge my vow: 0123456789 ~~ HOW VEXIN"
+mov hoj, hex=tmp
+char tmp, "The quick brown fox jumps over the lazy dog: PACK MY BOX WITH FIV"
+mov hak, hex=tmp
+char tmp, "~~ sphinx of black quartz. judge my vow: 0123456789 ~~ HOW VEXING"
+mov hok, hex=tmp
+; xor, and, or go as far as the shorter operand
+buf res, xor, hab, hoc
+vga res
+buf res, and, hab, hoc
+vga res
+buf res, or, hab, hoc
+vga res
+buf res, xor, hac, hod
+vga res
+buf res, and, hac, hod
+vga res
+buf res, or, hac, hod
+vga res
+buf res, xor, had, hoe
+vga res
+buf res, and, had, hoe
+vga res
+buf res, or, had, hoe
+vga res
+buf res, xor, hae, hof
+vga res
+buf res, and, hae, hof
+vga res
+buf res, or, hae, hof
+vga res
+buf res, xor, haf, hog
+vga res
+buf res, and, haf, hog
+vga res
+buf res, or, haf, hog
+vga res
+buf res, xor, hag, hoh
+vga res
+buf res, and, hag, hoh
+vga res
+buf res, or, hag, hoh
+vga res
+buf res, xor, hah, hoi
+vga res
+buf res, and, hah, hoi
+vga res
+buf res, or, hah, hoi
+vga res
+buf res, xor, hai, hoj
+vga res
+buf res, and, hai, hoj
+vga res
+buf res, or, hai, hoj
+vga res
+buf res, xor, haj, hok
+vga res
+buf res, and, haj, hok
+vga res
+buf res, or, haj, hok
+vga res
+buf res, xor, hak, hob
+vga res
+buf res, and, hak, hob
+vga res
+buf res, or, hak, hob
+vga res
+; cmp: equal, differing first or last byte, prefixes
+buf res, cmp, hab, hab
+vga res
+buf res, cmp, hab, hob
+vga res
+char tmp, "#"
+mov lst, hex=tmp
+buf res, cmp, hab, lst
+vga res
+buf res, cmp, lst, hab
+vga res
+buf res, cmp, hac, hac
+vga res
+buf res, cmp, hac, hoc
+vga res
+buf res, cmp, hab, hac
+vga res
+char tmp, "The quick brow#"
+mov lst, hex=tmp
+buf res, cmp, hac, lst
+vga res
+buf res, cmp, lst, hac
+vga res
+buf res, cmp, had, had
+vga res
+buf res, cmp, had, hod
+vga res
+buf res, cmp, hac, had
+vga res
+char tmp, "The quick brown#"
+mov lst, hex=tmp
+buf res, cmp, had, lst
+vga res
+buf res, cmp, lst, had
+vga res
+buf res, cmp, hae, hae
+vga res
+buf res, cmp, hae, hoe
+vga res
+buf res, cmp, had, hae
+vga res
+char tmp, "The quick brown #"
+mov lst, hex=tmp
+buf res, cmp, hae, lst
+vga res
+buf res, cmp, lst, hae
+vga res
+buf res, cmp, haf, haf
+vga res
+buf res, cmp, haf, hof
+vga res
+buf res, cmp, hae, haf
+vga res
+char tmp, "The quick brown fox jumps over#"
+mov lst, hex=tmp
+buf res, cmp, haf, lst
+vga res
+buf res, cmp, lst, haf
+vga res
+buf res, cmp, hag, hag
+vga res
+buf res, cmp, hag, hog
+vga res
+buf res, cmp, haf, hag
+vga res
+char tmp, "The quick brown fox jumps over #"
+mov lst, hex=tmp
+buf res, cmp, hag, lst
+vga res
+buf res, cmp, lst, hag
+vga res
+buf res, cmp, hah, hah
+vga res
+buf res, cmp, hah, hoh
+vga res
+buf res, cmp, hag, hah
+vga res
+char tmp, "The quick brown fox jumps over t#"
+mov lst, hex=tmp
+buf res, cmp, hah, lst
+vga res
+buf res, cmp, lst, hah
+vga res
+buf res, cmp, hai, hai
+vga res
+buf res, cmp, hai, hoi
+vga res
+buf res, cmp, hah, hai
+vga res
+char tmp, "The quick brown fox jumps over the lazy dog: PACK MY BOX WITH #"
+mov lst, hex=tmp
+buf res, cmp, hai, lst
+vga res
+buf res, cmp, lst, hai
+vga res
+buf res, cmp, haj, haj
+vga res
+buf res, cmp, haj, hoj
+vga res
+buf res, cmp, hai, haj
+vga res
+char tmp, "The quick brown fox jumps over the lazy dog: PACK MY BOX WITH F#"
+mov lst, hex=tmp
+buf res, cmp, haj, lst
+vga res
+buf res, cmp, lst, haj
+vga res
+buf res, cmp, hak, hak
+vga res
+buf res, cmp, hak, hok
+vga res
+buf res, cmp, haj, hak
+vga res
+char tmp, "The quick brown fox jumps over the lazy dog: PACK MY BOX WITH FI#"
+mov lst, hex=tmp
+buf res, cmp, hak, lst
+vga res
+buf res, cmp, lst, hak
+vga res
+; find: single bytes, two bytes and longer needles, at the start,
+; the end and past the vector widths
+char tmp, "T"
+mov ned, hex=tmp
+buf res, find, hak, ned, 0
+vga res
+buf res, find, hak, ned, 1
+vga res
+buf res, find, hak, ned, 17
+vga res
+buf res, find, hak, ned, 33
+vga res
+char tmp, "n"
+mov ned, hex=tmp
+buf res, find, hak, ned, 0
+vga res
+buf res, find, hak, ned, 1
+vga res
+buf res, find, hak, ned, 17
+vga res
+buf res, find, hak, ned, 33
+vga res
+char tmp, " "
+mov ned, hex=tmp
+buf res, find, hak, ned, 0
+vga res
+buf res, find, hak, ned, 1
+vga res
+buf res, find, hak, ned, 17
+vga res
+buf res, find, hak, ned, 33
+vga res
+char tmp, "f"
+mov ned, hex=tmp
+buf res, find, hak, ned, 0
+vga res
+buf res, find, hak, ned, 1
+vga res
+buf res, find, hak, ned, 17
+vga res
+buf res, find, hak, ned, 33
+vga res
+char tmp, "t"
+mov ned, hex=tmp
+buf res, find, hak, ned, 0
+vga res
+buf res, find, hak, ned, 1
+vga res
+buf res, find, hak, ned, 17
+vga res
+buf res, find, hak, ned, 33
+vga res
+char tmp, "h"
+mov ned, hex=tmp
+buf res, find, hak, ned, 0
+vga res
+buf res, find, hak, ned, 1
+vga res
+buf res, find, hak, ned, 17
+vga res
+buf res, find, hak, ned, 33
+vga res
+char tmp, "V"
+mov ned, hex=tmp
+buf res, find, hak, ned, 0
+vga res
+buf res, find, hak, ned, 1
+vga res
+buf res, find, hak, ned, 17
+vga res
+buf res, find, hak, ned, 33
+vga res
+char tmp, "Th"
+mov ned, hex=tmp
+buf res, find, hak, ned, 0
+vga res
+buf res, find, hak, ned, 1
+vga res
+buf res, find, hak, ned, 17
+vga res
+buf res, find, hak, ned, 33
+vga res
+char tmp, "n "
+mov ned, hex=tmp
+buf res, find, hak, ned, 0
+vga res
+buf res, find, hak, ned, 1
+vga res
+buf res, find, hak, ned, 17
+vga res
+buf res, find, hak, ned, 33
+vga res
+char tmp, " f"
+mov ned, hex=tmp
+buf res, find, hak, ned, 0
+vga res
+buf res, find, hak, ned, 1
+vga res
+buf res, find, hak, ned, 17
+vga res
+buf res, find, hak, ned, 33
+vga res
+char tmp, "fo"
+mov ned, hex=tmp
+buf res, find, hak, ned, 0
+vga res
+buf res, find, hak, ned, 1
+vga res
+buf res, find, hak, ned, 17
+vga res
+buf res, find, hak, ned, 33
+vga res
+char tmp, "th"
+mov ned, hex=tmp
+buf res, find, hak, ned, 0
+vga res
+buf res, find, hak, ned, 1
+vga res
+buf res, find, hak, ned, 17
+vga res
+buf res, find, hak, ned, 33
+vga res
+char tmp, "he"
+mov ned, hex=tmp
+buf res, find, hak, ned, 0
+vga res
+buf res, find, hak, ned, 1
+vga res
+buf res, find, hak, ned, 17
+vga res
+buf res, find, hak, ned, 33
+vga res
+char tmp, "IV"
+mov ned, hex=tmp
+buf res, find, hak, ned, 0
+vga res
+buf res, find, hak, ned, 1
+vga res
+buf res, find, hak, ned, 17
+vga res
+buf res, find, hak, ned, 33
+vga res
+char tmp, "The"
+mov ned, hex=tmp
+buf res, find, hak, ned, 0
+vga res
+buf res, find, hak, ned, 1
+vga res
+buf res, find, hak, ned, 17
+vga res
+buf res, find, hak, ned, 33
+vga res
+char tmp, "n f"
+mov ned, hex=tmp
+buf res, find, hak, ned, 0
+vga res
+buf res, find, hak, ned, 1
+vga res
+buf res, find, hak, ned, 17
+vga res
+buf res, find, hak, ned, 33
+vga res
+char tmp, " fo"
+mov ned, hex=tmp
+buf res, find, hak, ned, 0
+vga res
+buf res, find, hak, ned, 1
+vga res
+buf res, find, hak, ned, 17
+vga res
+buf res, find, hak, ned, 33
+vga res
+char tmp, "fox"
+mov ned, hex=tmp
+buf res, find, hak, ned, 0
+vga res
+buf res, find, hak, ned, 1
+vga res
+buf res, find, hak, ned, 17
+vga res
+buf res, find, hak, ned, 33
+vga res
+char tmp, "the"
+mov ned, hex=tmp
+buf res, find, hak, ned, 0
+vga res
+buf res, find, hak, ned, 1
+vga res
+buf res, find, hak, ned, 17
+vga res
+buf res, find, hak, ned, 33
+vga res
+char tmp, "he "
+mov ned, hex=tmp
+buf res, find, hak, ned, 0
+vga res
+buf res, find, hak, ned, 1
+vga res
+buf res, find, hak, ned, 17
+vga res
+buf res, find, hak, ned, 33
+vga res
+char tmp, "FIV"
+mov ned, hex=tmp
+buf res, find, hak, ned, 0
+vga res
+buf res, find, hak, ned, 1
+vga res
+buf res, find, hak, ned, 17
+vga res
+buf res, find, hak, ned, 33
+vga res
+char tmp, "The q"
+mov ned, hex=tmp
+buf res, find, hak, ned, 0
+vga res
+buf res, find, hak, ned, 1
+vga res
+buf res, find, hak, ned, 17
+vga res
+buf res, find, hak, ned, 33
+vga res
+char tmp, "n fox"
+mov ned, hex=tmp
+buf res, find, hak, ned, 0
+vga res
+buf res, find, hak, ned, 1
+vga res
+buf res, find, hak, ned, 17
+vga res
+buf res, find, hak, ned, 33
+vga res
+char tmp, " fox "
+mov ned, hex=tmp
+buf res, find, hak, ned, 0
+vga res
+buf res, find, hak, ned, 1
+vga res
+buf res, find, hak, ned, 17
+vga res
+buf res, find, hak, ned, 33
+vga res
+char tmp, "fox j"
+mov ned, hex=tmp
+buf res, find, hak, ned, 0
+vga res
+buf res, find, hak, ned, 1
+vga res
+buf res, find, hak, ned, 17
+vga res
+buf res, find, hak, ned, 33
+vga res
+char tmp, "the l"
+mov ned, hex=tmp
+buf res, find, hak, ned, 0
+vga res
+buf res, find, hak, ned, 1
+vga res
+buf res, find, hak, ned, 17
+vga res
+buf res, find, hak, ned, 33
+vga res
+char tmp, "he la"
+mov ned, hex=tmp
+buf res, find, hak, ned, 0
+vga res
+buf res, find, hak, ned, 1
+vga res
+buf res, find, hak, ned, 17
+vga res
+buf res, find, hak, ned, 33
+vga res
+char tmp, "H FIV"
+mov ned, hex=tmp
+buf res, find, hak, ned, 0
+vga res
+buf res, find, hak, ned, 1
+vga res
+buf res, find, hak, ned, 17
+vga res
+buf res, find, hak, ned, 33
+vga res
+char tmp, "The quick brown "
+mov ned, hex=tmp
+buf res, find, hak, ned, 0
+vga res
+buf res, find, hak, ned, 1
+vga res
+buf res, find, hak, ned, 17
+vga res
+buf res, find, hak, ned, 33
+vga res
+char tmp, "n fox jumps over"
+mov ned, hex=tmp
+buf res, find, hak, ned, 0
+vga res
+buf res, find, hak, ned, 1
+vga res
+buf res, find, hak, ned, 17
+vga res
+buf res, find, hak, ned, 33
+vga res
+char tmp, " fox jumps over "
+mov ned, hex=tmp
+buf res, find, hak, ned, 0
+vga res
+buf res, find, hak, ned, 1
+vga res
+buf res, find, hak, ned, 17
+vga res
+buf res, find, hak, ned, 33
+vga res
+char tmp, "fox jumps over t"
+mov ned, hex=tmp
+buf res, find, hak, ned, 0
+vga res
+buf res, find, hak, ned, 1
+vga res
+buf res, find, hak, ned, 17
+vga res
+buf res, find, hak, ned, 33
+vga res
+char tmp, "the lazy dog: PA"
+mov ned, hex=tmp
+buf res, find, hak, ned, 0
+vga res
+buf res, find, hak, ned, 1
+vga res
+buf res, find, hak, ned, 17
+vga res
+buf res, find, hak, ned, 33
+vga res
+char tmp, "he lazy dog: PAC"
+mov ned, hex=tmp
+buf res, find, hak, ned, 0
+vga res
+buf res, find, hak, ned, 1
+vga res
+buf res, find, hak, ned, 17
+vga res
+buf res, find, hak, ned, 33
+vga res
+char tmp, " MY BOX WITH FIV"
+mov ned, hex=tmp
+buf res, find, hak, ned, 0
+vga res
+buf res, find, hak, ned, 1
+vga res
+buf res, find, hak, ned, 17
+vga res
+buf res, find, hak, ned, 33
+vga res
+char tmp, "The quick brown f"
+mov ned, hex=tmp
+buf res, find, hak, ned, 0
+vga res
+buf res, find, hak, ned, 1
+vga res
+buf res, find, hak, ned, 17
+vga res
+buf res, find, hak, ned, 33
+vga res
+char tmp, "n fox jumps over "
+mov ned, hex=tmp
+buf res, find, hak, ned, 0
+vga res
+buf res, find, hak, ned, 1
+vga res
+buf res, find, hak, ned, 17
+vga res
+buf res, find, hak, ned, 33
+vga res
+char tmp, " fox jumps over t"
+mov ned, hex=tmp
+buf res, find, hak, ned, 0
+vga res
+buf res, find, hak, ned, 1
+vga res
+buf res, find, hak, ned, 17
+vga res
+buf res, find, hak, ned, 33
+vga res
+char tmp, "fox jumps over th"
+mov ned, hex=tmp
+buf res, find, hak, ned, 0
+vga res
+buf res, find, hak, ned, 1
+vga res
+buf res, find, hak, ned, 17
+vga res
+buf res, find, hak, ned, 33
+vga res
+char tmp, "the lazy dog: PAC"
+mov ned, hex=tmp
+buf res, find, hak, ned, 0
+vga res
+buf res, find, hak, ned, 1
+vga res
+buf res, find, hak, ned, 17
+vga res
+buf res, find, hak, ned, 33
+vga res
+char tmp, "he lazy dog: PACK"
+mov ned, hex=tmp
+buf res, find, hak, ned, 0
+vga res
+buf res, find, hak, ned, 1
+vga res
+buf res, find, hak, ned, 17
+vga res
+buf res, find, hak, ned, 33
+vga res
+char tmp, "K MY BOX WITH FIV"
+mov ned, hex=tmp
+buf res, find, hak, ned, 0
+vga res
+buf res, find, hak, ned, 1
+vga res
+buf res, find, hak, ned, 17
+vga res
+buf res, find, hak, ned, 33
+vga res
+char tmp, "The quick brown fox jumps over t"
+mov ned, hex=tmp
+buf res, find, hak, ned, 0
+vga res
+buf res, find, hak, ned, 1
+vga res
+buf res, find, hak, ned, 17
+vga res
+buf res, find, hak, ned, 33
+vga res
+char tmp, "n fox jumps over the lazy dog: P"
+mov ned, hex=tmp
+buf res, find, hak, ned, 0
+vga res
+buf res, find, hak, ned, 1
+vga res
+buf res, find, hak, ned, 17
+vga res
+buf res, find, hak, ned, 33
+vga res
+char tmp, " fox jumps over the lazy dog: PA"
+mov ned, hex=tmp
+buf res, find, hak, ned, 0
+vga res
+buf res, find, hak, ned, 1
+vga res
+buf res, find, hak, ned, 17
+vga res
+buf res, find, hak, ned, 33
+vga res
+char tmp, "fox jumps over the lazy dog: PAC"
+mov ned, hex=tmp
+buf res, find, hak, ned, 0
+vga res
+buf res, find, hak, ned, 1
+vga res
+buf res, find, hak, ned, 17
+vga res
+buf res, find, hak, ned, 33
+vga res
+char tmp, "the lazy dog: PACK MY BOX WITH F"
+mov ned, hex=tmp
+buf res, find, hak, ned, 0
+vga res
+buf res, find, hak, ned, 1
+vga res
+buf res, find, hak, ned, 17
+vga res
+buf res, find, hak, ned, 33
+vga res
+char tmp, "he lazy dog: PACK MY BOX WITH FI"
+mov ned, hex=tmp
+buf res, find, hak, ned, 0
+vga res
+buf res, find, hak, ned, 1
+vga res
+buf res, find, hak, ned, 17
+vga res
+buf res, find, hak, ned, 33
+vga res
+char tmp, "e lazy dog: PACK MY BOX WITH FIV"
+mov ned, hex=tmp
+buf res, find, hak, ned, 0
+vga res
+buf res, find, hak, ned, 1
+vga res
+buf res, find, hak, ned, 17
+vga res
+buf res, find, hak, ned, 33
+vga res
+char tmp, "The quick brown fox jumps over th"
+mov ned, hex=tmp
+buf res, find, hak, ned, 0
+vga res
+buf res, find, hak, ned, 1
+vga res
+buf res, find, hak, ned, 17
+vga res
+buf res, find, hak, ned, 33
+vga res
+char tmp, "n fox jumps over the lazy dog: PA"
+mov ned, hex=tmp
+buf res, find, hak, ned, 0
+vga res
+buf res, find, hak, ned, 1
+vga res
+buf res, find, hak, ned, 17
+vga res
+buf res, find, hak, ned, 33
+vga res
+char tmp, " fox jumps over the lazy dog: PAC"
+mov ned, hex=tmp
+buf res, find, hak, ned, 0
+vga res
+buf res, find, hak, ned, 1
+vga res
+buf res, find, hak, ned, 17
+vga res
+buf res, find, hak, ned, 33
+vga res
+char tmp, "fox jumps over the lazy dog: PACK"
+mov ned, hex=tmp
+buf res, find, hak, ned, 0
+vga res
+buf res, find, hak, ned, 1
+vga res
+buf res, find, hak, ned, 17
+vga res
+buf res, find, hak, ned, 33
+vga res
+char tmp, "the lazy dog: PACK MY BOX WITH FI"
+mov ned, hex=tmp
+buf res, find, hak, ned, 0
+vga res
+buf res, find, hak, ned, 1
+vga res
+buf res, find, hak, ned, 17
+vga res
+buf res, find, hak, ned, 33
+vga res
+char tmp, "he lazy dog: PACK MY BOX WITH FIV"
+mov ned, hex=tmp
+buf res, find, hak, ned, 0
+vga res
+buf res, find, hak, ned, 1
+vga res
+buf res, find, hak, ned, 17
+vga res
+buf res, find, hak, ned, 33
+vga res
+char tmp, "he lazy dog: PACK MY BOX WITH FIV"
+mov ned, hex=tmp
+buf res, find, hak, ned, 0
+vga res
+buf res, find, hak, ned, 1
+vga res
+buf res, find, hak, ned, 17
+vga res
+buf res, find, hak, ned, 33
+vga res
+char tmp, "zz"
+mov ned, hex=tmp
+buf res, find, hak, ned, 0
+vga res
+buf res, find, hak, ned, 1
+vga res
+buf res, find, hak, ned, 17
+vga res
+buf res, find, hak, ned, 33
+vga res
+char tmp, "!"
+mov ned, hex=tmp
+buf res, find, hak, ned, 0
+vga res
+buf res, find, hak, ned, 1
+vga res
+buf res, find, hak, ned, 17
+vga res
+buf res, find, hak, ned, 33
+vga res
+char tmp, "JUGS!"
+mov ned, hex=tmp
+buf res, find, hak, ned, 0
+vga res
+buf res, find, hak, ned, 1
+vga res
+buf res, find, hak, ned, 17
+vga res
+buf res, find, hak, ned, 33
+vga res
+char tmp, "fox jumps over the lazy dog: PACK MY BOX X"
+mov ned, hex=tmp
+buf res, find, hak, ned, 0
+vga res
+buf res, find, hak, ned, 1
+vga res
+buf res, find, hak, ned, 17
+vga res
+buf res, find, hak, ned, 33
+vga res
+buf res, find, hab, 84, 0
+vga res
+buf res, find, hab, 0, 0
+vga res
+buf res, find, hac, 110, 0
+vga res
+buf res, find, hac, 0, 0
+vga res
+buf res, find, had, 32, 0
+vga res
+buf res, find, had, 0, 0
+vga res
+buf res, find, hae, 102, 0
+vga res
+buf res, find, hae, 0, 0
+vga res
+buf res, find, haf, 32, 0
+vga res
+buf res, find, haf, 0, 0
+vga res
+buf res, find, hag, 116, 0
+vga res
+buf res, find, hag, 0, 0
+vga res
+buf res, find, hah, 104, 0
+vga res
+buf res, find, hah, 0, 0
+vga res
+buf res, find, hai, 70, 0
+vga res
+buf res, find, hai, 0, 0
+vga res
+buf res, find, haj, 73, 0
+vga res
+buf res, find, haj, 0, 0
+vga res
+buf res, find, hak, 86, 0
+vga res
+buf res, find, hak, 0, 0
+vga res
+; count: bits set
+buf res, count, hab
+vga res
+buf res, count, hob
+vga res
+buf res, count, hac
+vga res
+buf res, count, hoc
+vga res
+buf res, count, had
+vga res
+buf res, count, hod
+vga res
+buf res, count, hae
+vga res
+buf res, count, hoe
+vga res
+buf res, count, haf
+vga res
+buf res, count, hof
+vga res
+buf res, count, hag
+vga res
+buf res, count, hog
+vga res
+buf res, count, hah
+vga res
+buf res, count, hoh
+vga res
+buf res, count, hai
+vga res
+buf res, count, hoi
+vga res
+buf res, count, haj
+vga res
+buf res, count, hoj
+vga res
+buf res, count, hak
+vga res
+buf res, count, hok
+vga res
+; digests of the published test vectors
+char tmp, "123456789"
+buf res, crc, tmp
+vga res
+char tmp, "abc"
+buf res, xxh, tmp
+vga res
+buf res, sha, tmp
+vga res
+buf res, sha, hak
+vga res
+buf res, crc, hak
+vga res
@@ -0,0 +1,3 @@
+_start:
+    mov xxx, 1.5
+    vga xxx
@@ -0,0 +1,9 @@
+_start:
+    mov aaa, 3
+    addr xxx, aaa aaa
+    mul yyy, (aaa * 2
+    subr zzz, aaa - 1)
+    addr www, aaa +
+    mul vvv, 12abc * 2
+    addr uuu, (aaa + 2) * -aaa
+    vga uuu
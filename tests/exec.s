@@ -0,0 +1,7 @@
+_start:
+    req ftype="asm","lib/bump.s"
+    mov xxx, 4
+    mov xxx, 5
+    exec bump, 1
+    addr yyy, xxx + 1
+    vga yyy
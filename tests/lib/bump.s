@@ -0,0 +1,3 @@
+def bump, ARGUMENTS, exec:
+    mov xxx, 99
+end
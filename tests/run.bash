@@ -0,0 +1,84 @@
+#!/bin/bash
+# Run each tests/*.s script at every SIMD level and compare the output with
+# the scalar run and with the script's .expected file. With a compiler,
+# also build each script into an optimized module and check its output.
+# Scripts run from tests/, so a req path like "lib/bump.s" is relative to it.
+# Usage: tests/run.bash <interp> [compiler]
+
+TEST_DIR="$(cd "$(dirname "$0")" && pwd)"
+absolute() { echo "$(cd "$(dirname "$1")" && pwd)/$(basename "$1")"; }
+interp="$(absolute "$1")"
+[ -n "$2" ] && compiler="$(absolute "$2")"
+out="$(mktemp -d)"
+trap 'rm -rf "$out"' EXIT
+cd "$TEST_DIR" || exit 1
+failed=0
+
+for script in *.s; do
+    name="$(basename "$script" .s)"
+    before=$failed
+    for level in scalar sse2 avx2; do
+        "$interp" --simd "$level" "$script" > "$out/$name.$level" 2>&1
+        if [ "$level" != scalar ] && ! cmp -s "$out/$name.scalar" "$out/$name.$level"; then
+            echo "FAIL $name: --simd $level differs from --simd scalar"
+            diff "$out/$name.scalar" "$out/$name.$level" | head -5
+            failed=1
+        fi
+        if ! cmp -s "$name.expected" "$out/$name.$level"; then
+            echo "FAIL $name: --simd $level differs from $name.expected"
+            diff "$name.expected" "$out/$name.$level" | head -5
+            failed=1
+        fi
+    done
+    if [ -n "$compiler" ]; then
+        if ! "$compiler" build -f "$script" -rom "$out/$name.mod" > "$out/$name.build" 2>&1; then
+            echo "FAIL $name: does not compile"
+            head -5 "$out/$name.build"
+            failed=1
+        else
+            "$interp" "$out/$name.mod" > "$out/$name.module" 2>&1
+            if ! cmp -s "$name.expected" "$out/$name.module"; then
+                echo "FAIL $name: the compiled module differs from $name.expected"
+                diff "$name.expected" "$out/$name.module" | head -5
+                failed=1
+            fi
+        fi
+    fi
+    [ $failed = $before ] && echo "ok $name"
+done
+
+# Scripts in errors/ still run, after the verifier reports their source
+# errors, but the compiler must refuse to build them
+for script in errors/*.s; do
+    name="$(basename "$script" .s)"
+    "$interp" "$script" > "$out/$name.errors" 2>&1
+    if ! cmp -s "errors/$name.expected" "$out/$name.errors"; then
+        echo "FAIL errors/$name: differs from errors/$name.expected"
+        diff "errors/$name.expected" "$out/$name.errors" | head -5
+        failed=1
+    elif [ -n "$compiler" ] && "$compiler" build -f "$script" -rom "$out/$name.mod" > /dev/null 2>&1; then
+        echo "FAIL errors/$name: compiles"
+        failed=1
+    else
+        echo "ok errors/$name"
+    fi
+done
+
+# A damaged module must be refused before it runs. Point the register
+# reference of the float literal in damaged/float.s far past the register table;
+# the operand section's offset sits at byte 56 of the module header.
+if [ -n "$compiler" ]; then
+    "$compiler" build -f damaged/float.s -rom "$out/damaged.mod" > /dev/null 2>&1
+    operands=$(od -An -tu8 -j56 -N8 "$out/damaged.mod" | tr -d ' ')
+    printf '\xff\xff\xff\x00' | dd of="$out/damaged.mod" bs=1 seek=$((operands + 4)) conv=notrunc 2> /dev/null
+    "$interp" "$out/damaged.mod" > "$out/damaged.out" 2>&1
+    status=$?
+    if [ $status != 1 ] || ! grep -q "^Error: .*operand refers to nothing" "$out/damaged.out"; then
+        echo "FAIL damaged module: exit status $status"
+        head -5 "$out/damaged.out"
+        failed=1
+    else
+        echo "ok damaged module"
+    fi
+fi
+exit $failed
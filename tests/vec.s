@@ -0,0 +1,146 @@
+; vec at every SIMD level: tests/run.bash runs this with --simd scalar,
+; sse2 and avx2 and compares each run with vec.expected. Lengths sit
+; around the 2- and 4-element SSE2 and AVX2 widths and their unrolled
+; loops, so both the vector loops and their scalar tails are covered.
+; Float elements are multiples of 0.25, so their sums are exact in any
+; order.
+
+; nnn elements each: via and vib integers, vfa and vfb floats, big the
+; products of via that wrap around, and cut, which is vib one shorter
+def build, exec:
+    vec via, fill, 0, 0
+    vec vib, fill, 0, 0
+    vec vfa, fill, 0, 0
+    vec vfb, fill, 0, 0
+    for mov iii, 1, nnn, exec:
+        mul ttt, iii * 37
+        mod ttt, ttt % 101
+        subr ttt, ttt - 50
+        vec via, push, via, ttt
+        mul ttt, iii * 53
+        mod ttt, ttt % 97
+        subr ttt, ttt - 40
+        vec vib, push, vib, ttt
+        mul fff, iii * 0.25
+        subr fff, fff - 7.5
+        vec vfa, push, vfa, fff
+        mul ttt, iii * 37
+        mod ttt, ttt % 11
+        mul fff, ttt * 0.5
+        subr fff, fff - 2
+        vec vfb, push, vfb, fff
+    end
+    vec big, mul, via, 3037000501
+    vec cut, slice, vib, 1, nnn
+end
+
+; Every operation on them, integers, floats and the two mixed
+def check, exec:
+    vec res, add, via, vib
+    vga res
+    vec res, add, via, 9
+    vga res
+    vec res, mul, via, vib
+    vga res
+    vec res, mul, via, 3037000501
+    vga res
+    vec res, dot, via, vib
+    vga res
+    vec res, dot, big, big
+    vga res
+    vec res, sum, via
+    vga res
+    vec res, sum, big
+    vga res
+    vec res, min, via
+    vga res
+    vec res, max, via
+    vga res
+    vec res, min, vib
+    vga res
+    vec res, max, vib
+    vga res
+    vec res, add, vfa, vfb
+    vga res
+    vec res, add, vfa, 0.75
+    vga res
+    vec res, mul, vfa, vfb
+    vga res
+    vec res, mul, vfb, -2.5
+    vga res
+    vec res, dot, vfa, vfb
+    vga res
+    vec res, sum, vfa
+    vga res
+    vec res, sum, vfb
+    vga res
+    vec res, min, vfa
+    vga res
+    vec res, max, vfa
+    vga res
+    vec res, min, vfb
+    vga res
+    vec res, max, vfb
+    vga res
+    vec res, add, via, vfb
+    vga res
+    vec res, dot, via, vfa
+    vga res
+    vec res, add, via, cut
+    vga res
+    vec res, dot, cut, via
+    vga res
+end
+
+_start:
+mov nnn, 0
+exec build
+exec check
+mov nnn, 1
+exec build
+exec check
+mov nnn, 2
+exec build
+exec check
+mov nnn, 3
+exec build
+exec check
+mov nnn, 4
+exec build
+exec check
+mov nnn, 5
+exec build
+exec check
+mov nnn, 7
+exec build
+exec check
+mov nnn, 8
+exec build
+exec check
+mov nnn, 9
+exec build
+exec check
+mov nnn, 15
+exec build
+exec check
+mov nnn, 16
+exec build
+exec check
+mov nnn, 17
+exec build
+exec check
+mov nnn, 31
+exec build
+exec check
+mov nnn, 32
+exec build
+exec check
+mov nnn, 33
+exec build
+exec check
+mov nnn, 63
+exec build
+exec check
+mov nnn, 65
+exec build
+exec check